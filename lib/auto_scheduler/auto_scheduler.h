@@ -40,6 +40,17 @@ class AutoScheduler {
     return bs.Search(module, spec, program_name);
   }
 
+  /// Beam search for a loop schedule, then finish it for each of `isas`, see
+  /// SearchStrategy::Multiversion.
+  std::vector<KernelVariant> MultiversionBeamSearch(
+      IRModule module, ArchSpec spec, std::string program_name,
+      std::vector<TargetISA> isas = {TargetISA::SSE, TargetISA::AVX2,
+                                     TargetISA::AVX512}) {
+    BeamSearchStrategy bs(4, 4, 10);
+    auto schedule = bs.SearchSchedule(module, spec, program_name);
+    return bs.Multiversion(schedule, spec, program_name, isas);
+  }
+
   IRModule RandomSearch(IRModule module, int random_search_steps, ArchSpec spec,
                         std::string program_name) {
     RandomSearchStrategy rs(random_search_steps);
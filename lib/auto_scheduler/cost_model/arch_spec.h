@@ -11,6 +11,29 @@ class ArchSpec {
     NVIDIA_GPU,
   };
   ArchType type_;
-  ArchSpec(ArchType type = ArchType::CPU) : type_(type) {}
+  /// SIMD widths, in floats, the auto-scheduler may vectorize with.
+  std::vector<int> vector_lengths_;
+  /// Iterations ahead the auto-scheduler may prefetch strided accesses by.
+  std::vector<int> prefetch_distances_;
+  ArchSpec(ArchType type = ArchType::CPU) : type_(type) {
+    if (type == ArchType::CPU) {
+      vector_lengths_ = HostVectorLengths();
+      prefetch_distances_ = {4, 8, 16};
+    }
+  }
+
+  /// 4 (SSE), plus 8 with AVX2 and FMA and 16 with AVX-512 on the running
+  /// CPU, like the TargetISA checks of CodeGenC::genDispatch. The candidates
+  /// are built with -mfma, which AVX alone cannot run.
+  static std::vector<int> HostVectorLengths() {
+    std::vector<int> lengths = {4};
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+      lengths.push_back(8);
+      if (__builtin_cpu_supports("avx512f")) lengths.push_back(16);
+    }
+#endif
+    return lengths;
+  }
 };
-}  // namespace polly
\ No newline at end of file
+}  // namespace polly
@@ -8,9 +8,13 @@
  */
 #pragma once
 
+#include <chrono>
+
 #include "common.h"
 #include "ir/ir_module.h"
 #include "codegen/codegen.h"
+#include "jit/native_module.h"
+#include "runtime/c_runtime_api.h"
 #include "arch_spec.h"
 
 namespace polly {
@@ -21,88 +25,44 @@ class CostModel {
   CostModel() {}
 
   float Evaluate(IRModule space, ArchSpec spec, std::string program_name) {
-    std::string res;
+    float runtime;
 
     switch (spec.type_) {
       case ArchSpec::ArchType::CPU: {
-        std::string costModelFileName = ".polly_cost_model.cc";
-        std::ofstream f;
-        f.open(costModelFileName);
-        {
-          CodeGenC codegen;
-          f << codegen.genCode(space.GetRoot(), space.GetTensors(),
-                               program_name);
-        }
-        {
-          CodeGenC codegen;
-          f << codegen.genTensors(space.GetTensors());
-        }
-        f << "int main() {\n";
-        {
-          CodeGenC codegen;
-          f << "  " << program_name << "("
-            << codegen.genTensorParam(space.GetTensors()) << ");\n";
-        }
+        // The candidate is loaded in-process, so its parallel loops run on
+        // the warm runtime pool instead of threads spawned for every region.
+        try {
+          NativeModule native(space, program_name);
+          auto buffers = native.AllocateTensors();
+          // The first call brings the pool up.
+          native.execute(buffers);
 
-        f << "  struct timeval start, end;\n";
-        f << "  gettimeofday(&start, NULL);\n";
-        f << "  for (int step = 0; step < 3; step ++) {\n";
-
-        {
+          MultiThreading &pool = GetRuntimeThreadPool();
+          bool hot = pool.IsHot();
+          pool.SetHot(true);
+          auto start = std::chrono::steady_clock::now();
+          for (int step = 0; step < 3; step++) native.execute(buffers);
+          auto end = std::chrono::steady_clock::now();
+          pool.SetHot(hot);
+          // timing unit: ms
+          runtime =
+              std::chrono::duration<float, std::milli>(end - start).count() /
+              3.0;
+        } catch (const std::runtime_error &e) {
+          std::cout << e.what() << "\n";
           CodeGenC codegen;
-          f << "    " << program_name << "("
-            << codegen.genTensorParam(space.GetTensors()) << ");\n";
+          std::cout << codegen.genCode(space.GetRoot(), space.GetTensors(),
+                                       program_name);
+          return 1000000000.0;
         }
-        f << "  }\n";
-        // timing unit: ms
-        f << "  gettimeofday(&end, NULL);\n";
-        f << "  printf(\"%.6f\\n\", ((end.tv_sec - start.tv_sec) * 1000L + "
-             "(end.tv_usec - start.tv_usec) * 1.0 / 1000L) / 3.0);\n";
-
-        f << "}\n";
-        f.close();
-
-        // Compile
-
-        res = executeCommands(
-            "g++ --std=c++11 -O3 -mfma -fopenmp -o .main .polly_cost_model.cc");
-
-        // Execute & get running time
-        res = executeCommands("timeout 400 ./.main");
         break;
       }
       default:
         throw std::runtime_error("Not supported architecture.");
     }
-    std::cout << "time: " << res;
-    if (res == "") {
-      CodeGenC codegen;
-      std::cout << codegen.genCode(space.GetRoot(), space.GetTensors(),
-                                   program_name);
-      return 1000000000.0;
-    }
-
-    float runtime = atof(res.c_str());
+    std::cout << "time: " << runtime << "\n";
     return runtime;
   }
-
- private:
-  std::string executeCommands(std::string cmd) {
-    char buffer[128];
-    std::string result = "";
-    FILE* pipe = popen(cmd.c_str(), "r");
-    if (!pipe) throw std::runtime_error("popen() failed!");
-    try {
-      while (fgets(buffer, sizeof buffer, pipe) != NULL) {
-        result += buffer;
-      }
-    } catch (...) {
-      pclose(pipe);
-      throw std::runtime_error("cannot read command execution result");
-    }
-    pclose(pipe);
-    return result;
-  }
 };
 
 }  // namespace  polly
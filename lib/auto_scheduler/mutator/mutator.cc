@@ -1,5 +1,7 @@
 #include "mutator.h"
 
+#include <limits>
+
 namespace polly {
 bool Mutator::OfSameScope(IRHandle program, IRHandle first_loop,
                           IRHandle second_loop) {
@@ -69,6 +71,7 @@ bool Mutator::Parallelize(IRHandle program) {
   SyncParallel::runPass(SyncParallel::Arg::create(program));
 
   LoopParallel::runPass(LoopParallel::Arg::create(program));
+  LoopScheduling::runPass(LoopScheduling::Arg::create(program));
   return true;
 }
 
@@ -179,4 +182,166 @@ bool Mutator::Unroll(IRHandle program) {
   return true;
 }
 
-}  // namespace polly
\ No newline at end of file
+/// Collects the accesses of an inner-most loop body and everything that
+/// LoopVectorization cannot widen.
+class VectorizationLegalityHelper : public IRRecursiveVisitor {
+ public:
+  VectorizationLegalityHelper(IRHandle loop) {
+    var = loop.as<ForNode>()->looping_var_.as<VarNode>()->id;
+    for (auto &stmt : loop.as<ForNode>()->body) {
+      if (stmt.Type() != IRNodeType::ASSIGN) {
+        legal = false;
+        return;
+      }
+      // The lanes of a reduction accumulate apart, only its operand is
+      // widened.
+      auto operand = LoopVectorization::ReductionOperand(loop, stmt);
+      if (operand != NullIRHandle) {
+        operand.accept(this);
+        continue;
+      }
+      auto assign = stmt.as<AssignmentNode>();
+      if (assign->lhs.Type() != IRNodeType::ACCESS) {
+        legal = false;
+        return;
+      }
+      writes.push_back(assign->lhs);
+      assign->rhs.accept(this);
+    }
+  }
+
+  void enter(IRHandle node) override {
+    switch (node.Type()) {
+      case IRNodeType::ACCESS:
+        // Indices are copied as a whole into the vector load.
+        if (in_access++ == 0) reads.push_back(node);
+        break;
+      case IRNodeType::VAR:
+        // A looping variable used as a value would be the same in all lanes.
+        // The bounds of a variable are never evaluated in the body.
+        if (in_access == 0 && in_var == 0 && node.as<VarNode>()->id == var)
+          legal = false;
+        in_var++;
+        break;
+      case IRNodeType::MOD:
+      case IRNodeType::VALUE:
+        if (in_access == 0 && in_var == 0) legal = false;
+        break;
+      default:
+        break;
+    }
+  }
+  void exit(IRHandle node) override {
+    if (node.Type() == IRNodeType::ACCESS) in_access--;
+    if (node.Type() == IRNodeType::VAR) in_var--;
+  }
+
+  std::string var;
+  bool legal = true;
+  int in_access = 0, in_var = 0;
+  std::vector<IRHandle> writes, reads;
+};
+
+static bool SameLocation(IRHandle a, IRHandle b) {
+  auto x = a.as<AccessNode>(), y = b.as<AccessNode>();
+  if (x->tensor.as<TensorNode>()->id != y->tensor.as<TensorNode>()->id)
+    return false;
+  for (int i = 0; i < x->indices.size(); i++) {
+    auto ex = PolyhedralExtraction::IRHandleToQuasiAffine(x->indices[i]);
+    auto ey = PolyhedralExtraction::IRHandleToQuasiAffine(y->indices[i]);
+    if (ex.constant != ey.constant || ex.divisor != ey.divisor) return false;
+    for (auto &it : ex.coeffs) {
+      if (it.second != 0 && ey.coeffs[it.first] != it.second) return false;
+    }
+    for (auto &it : ey.coeffs) {
+      if (it.second != 0 && ex.coeffs[it.first] != it.second) return false;
+    }
+  }
+  return true;
+}
+
+/// Stride of a divided index, which is not a whole number of elements.
+static const int DividedStride = std::numeric_limits<int>::min();
+
+/// The coefficient of `var` in each index of `access`.
+static std::vector<int> Strides(IRHandle access, const std::string &var) {
+  std::vector<int> strides;
+  for (auto &index : access.as<AccessNode>()->indices) {
+    auto expr = PolyhedralExtraction::IRHandleToQuasiAffine(index);
+    auto it = expr.coeffs.find(var);
+    int stride = it == expr.coeffs.end() ? 0 : it->second;
+    // Divided indices are not contiguous.
+    if (stride != 0 && expr.divisor != 1) stride = DividedStride;
+    strides.push_back(stride);
+  }
+  return strides;
+}
+
+bool Mutator::IsVectorizable(IRHandle loop, int vecLen) {
+  if (loop == NullIRHandle || loop.Type() != IRNodeType::FOR) return false;
+  if (!LoopVectorization::IsSupportedVecLen(vecLen)) return false;
+
+  // The loop must be of the form: 0 -> a multiple of vecLen, (1).
+  auto looping_var = loop.as<ForNode>()->looping_var_.as<VarNode>();
+  if (!looping_var->min.equals(IntNode::make(0))) return false;
+  if (!looping_var->increment.equals(IntNode::make(1))) return false;
+  if (looping_var->max.Type() != IRNodeType::INT ||
+      looping_var->max.as<IntNode>()->value % vecLen != 0)
+    return false;
+
+  VectorizationLegalityHelper helper(loop);
+  if (!helper.legal) return false;
+
+  // Stores are contiguous, i.e. the looping variable only appears in their
+  // last index. Loads may be strided as well (see VecGatherNode), as long as
+  // no index is divided.
+  auto contiguous = [&](IRHandle access) {
+    auto strides = Strides(access, helper.var);
+    if (strides.empty()) return false;
+    for (int i = 0; i + 1 < strides.size(); i++) {
+      if (strides[i] != 0) return false;
+    }
+    return strides.back() == 1;
+  };
+  for (auto &write : helper.writes) {
+    if (!contiguous(write)) return false;
+  }
+  for (auto &read : helper.reads) {
+    auto strides = Strides(read, helper.var);
+    if (std::count(strides.begin(), strides.end(), DividedStride) > 0)
+      return false;
+    // Lanes must not see each other's stores.
+    for (auto &write : helper.writes) {
+      if (read.as<AccessNode>()->tensor.as<TensorNode>()->id !=
+          write.as<AccessNode>()->tensor.as<TensorNode>()->id)
+        continue;
+      if (!SameLocation(read, write)) return false;
+    }
+  }
+  return true;
+}
+
+bool Mutator::Vectorize(IRHandle program, IRHandle loop, int vecLen) {
+  if (!IsVectorizable(loop, vecLen)) return false;
+  LoopVectorization::runPass(
+      LoopVectorization::Arg::create(program, loop, vecLen));
+  FMAFusion::runPass(FMAFusion::Arg::create(loop));
+  AlignmentAnalysis::runPass(AlignmentAnalysis::Arg::create(loop));
+  StreamingStoreAnalysis::runPass(
+      StreamingStoreAnalysis::Arg::create(program));
+  return true;
+}
+
+bool Mutator::ScalarReplace(IRHandle program) {
+  auto ret =
+      ScalarReplacement::runPass(ScalarReplacement::Arg::create(program));
+  return PassRet::as<ScalarReplacement::Ret>(ret)->promoted > 0;
+}
+
+bool Mutator::Prefetch(IRHandle program, int distance) {
+  auto ret = SoftwarePrefetch::runPass(
+      SoftwarePrefetch::Arg::create(program, distance));
+  return PassRet::as<SoftwarePrefetch::Ret>(ret)->inserted > 0;
+}
+
+}  // namespace polly
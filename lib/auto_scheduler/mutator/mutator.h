@@ -23,13 +23,20 @@
 #include "pass/transform/vectorization.h"
 
 #include "pass/parallelization/loop_parallel.h"
+#include "pass/parallelization/loop_scheduling.h"
 #include "pass/parallelization/sync_parallel.h"
 
 #include "pass/analysis/transform_analysis_pass.h"
 #include "pass/analysis/parallelization_analysis_pass.h"
+#include "pass/analysis/polyhedral_extraction.h"
+#include "pass/analysis/alignment_analysis.h"
+#include "pass/analysis/streaming_store_analysis.h"
 
 #include "pass/optimization/constant_folding.h"
 #include "pass/optimization/dead_code_elimination.h"
+#include "pass/optimization/fma_fusion.h"
+#include "pass/optimization/scalar_replacement.h"
+#include "pass/optimization/software_prefetch.h"
 
 namespace polly {
 
@@ -37,7 +44,8 @@ namespace polly {
 // possible.
 class Mutator {
  public:
-  // Parallelize a program
+  // Parallelize a program, and pick how its parallel loops are shared by the
+  // workers, see LoopScheduling.
   static bool Parallelize(IRHandle program);
   static bool Split(IRHandle program, IRHandle loop, int splitFactor);
   static bool Reorder(IRHandle program, IRHandle outter_loop,
@@ -46,11 +54,25 @@ class Mutator {
                       IRHandle second_loop);
   static bool Fission(IRHandle program, IRHandle loop);
   static bool Unroll(IRHandle program);
+  /// Vectorizes an inner-most loop by `vecLen` lanes if that is legal. Like
+  /// LoopVectorization, this has to be the last transform of a schedule.
+  /// Multiply-adds of the vectorized body are fused, see FMAFusion, and its
+  /// aligned accesses are marked, see AlignmentAnalysis. The stores of large
+  /// write-once outputs are then streamed, see StreamingStoreAnalysis.
+  static bool Vectorize(IRHandle program, IRHandle loop, int vecLen);
+  /// Keeps the accesses that are invariant in a loop, e.g. reduction
+  /// accumulators, in registers across it, see ScalarReplacement. Like
+  /// Vectorize, this finishes a schedule.
+  static bool ScalarReplace(IRHandle program);
+  /// Prefetches the strided accesses of every loop `distance` iterations
+  /// ahead, see SoftwarePrefetch. This goes after ScalarReplace.
+  static bool Prefetch(IRHandle program, int distance);
 
  private:
   static bool OfSameScope(IRHandle program, IRHandle first_loop,
                           IRHandle second_loop);
   static bool IsFullyNested(IRHandle outter_loop, IRHandle inner_loop);
+  static bool IsVectorizable(IRHandle loop, int vecLen);
 };
 
 }  // namespace polly
@@ -59,6 +59,13 @@ void BeamSearchStrategy::RandomSearch(IRModule &module) {
 
 IRModule BeamSearchStrategy::Search(IRModule module, ArchSpec spec,
                                     std::string program_name) {
+  return Prefetch(Vectorize(SearchSchedule(module, spec, program_name), spec,
+                            program_name),
+                  spec, program_name);
+}
+
+IRModule BeamSearchStrategy::SearchSchedule(IRModule module, ArchSpec spec,
+                                            std::string program_name) {
   if (module.GetRoot() != NullIRHandle) {
     best_module_ = module;
     candidates.clear();
@@ -50,6 +50,9 @@ class BeamSearchStrategy : public SearchStrategy {
   void RandomSearch(IRModule &module);
   IRModule Search(IRModule module, ArchSpec spec,
                   std::string program_name) override;
+  /// The parallelized loop schedule Search vectorizes.
+  IRModule SearchSchedule(IRModule module, ArchSpec spec,
+                          std::string program_name);
 
  private:
   IRHandle GetRandomLoop(std::unordered_set<IRHandle, IRHandleHash> &node_set) {
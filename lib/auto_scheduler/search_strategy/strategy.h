@@ -11,6 +11,7 @@
 
 #include "common.h"
 #include "auto_scheduler/cost_model/cost_model.h"
+#include "auto_scheduler/mutator/mutator.h"
 #include "ir/ir_module.h"
 
 namespace polly {
@@ -18,5 +19,92 @@ class SearchStrategy {
  public:
   virtual IRModule Search(IRModule module, ArchSpec spec,
                           std::string program_name) = 0;
+
+  /// Vectorizes and prefetches a final loop schedule separately for every
+  /// instruction set in `isas`, for CodeGenC::genDispatch. Variants the host
+  /// can run are tuned like Search does, restricted to the vector lengths of
+  /// their ISA; the others cannot be timed here and take its widest vectors.
+  std::vector<KernelVariant> Multiversion(IRModule schedule, ArchSpec spec,
+                                          std::string program_name,
+                                          std::vector<TargetISA> isas) {
+    std::vector<KernelVariant> variants;
+    for (auto isa : isas) {
+      IRModule variant;
+      if (CodeGenC::HostSupports(isa)) {
+        ArchSpec isa_spec = spec;
+        isa_spec.vector_lengths_.clear();
+        for (int vecLen : spec.vector_lengths_) {
+          if (vecLen <= MaxVectorLength(isa)) {
+            isa_spec.vector_lengths_.push_back(vecLen);
+          }
+        }
+        variant = Prefetch(Vectorize(schedule, isa_spec, program_name),
+                           isa_spec, program_name);
+      } else {
+        variant = schedule.CreateSubSpace();
+        VectorizeInnerLoops(variant, MaxVectorLength(isa));
+        Mutator::ScalarReplace(variant.GetRoot());
+      }
+      variants.push_back({isa, variant.GetRoot()});
+    }
+    return variants;
+  }
+
+ protected:
+  /// Vectorizes every inner-most loop of `module` by `vecLen` lanes where
+  /// legal, returns whether any was.
+  static bool VectorizeInnerLoops(IRModule &module, int vecLen) {
+    bool vectorized = false;
+    for (auto &node : module.GetIRNodes()) {
+      if (node.Type() != IRNodeType::FOR) continue;
+      bool inner_most = true;
+      for (auto &stmt : node.as<ForNode>()->body) {
+        if (stmt.Type() == IRNodeType::FOR) inner_most = false;
+      }
+      if (!inner_most) continue;
+      vectorized |= Mutator::Vectorize(module.GetRoot(), node, vecLen);
+    }
+    return vectorized;
+  }
+
+  /// Vectorizes the inner-most loops of a final schedule with each vector
+  /// length the target supports, and keeps the fastest variant (which may be
+  /// the scalar one). Every variant keeps its accumulators in registers.
+  IRModule Vectorize(IRModule module, ArchSpec spec, std::string program_name) {
+    CostModel model;
+    IRModule best = module.CreateSubSpace();
+    Mutator::ScalarReplace(best.GetRoot());
+    float best_performance = model.Evaluate(best, spec, program_name);
+    for (int vecLen : spec.vector_lengths_) {
+      auto cloned_module = module.CreateSubSpace();
+      if (!VectorizeInnerLoops(cloned_module, vecLen)) continue;
+      Mutator::ScalarReplace(cloned_module.GetRoot());
+      float performance = model.Evaluate(cloned_module, spec, program_name);
+      if (performance < best_performance) {
+        best = cloned_module;
+        best_performance = performance;
+      }
+    }
+    return best;
+  }
+
+  /// Prefetches the strided accesses of a final schedule with each distance
+  /// the target allows, and keeps the fastest variant (which may be the one
+  /// without prefetches).
+  IRModule Prefetch(IRModule module, ArchSpec spec, std::string program_name) {
+    CostModel model;
+    IRModule best = module;
+    float best_performance = model.Evaluate(module, spec, program_name);
+    for (int distance : spec.prefetch_distances_) {
+      auto cloned_module = module.CreateSubSpace();
+      if (!Mutator::Prefetch(cloned_module.GetRoot(), distance)) break;
+      float performance = model.Evaluate(cloned_module, spec, program_name);
+      if (performance < best_performance) {
+        best = cloned_module;
+        best_performance = performance;
+      }
+    }
+    return best;
+  }
 };
 }  // namespace polly
\ No newline at end of file
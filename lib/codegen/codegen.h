@@ -11,6 +11,7 @@
 #include "common.h"
 #include "ir/ir.h"
 #include "ir/ir_visitor.h"
+#include "pass/analysis/memory_planner.h"
 
 namespace polly {
 
@@ -19,31 +20,80 @@ class CodeGen : public IRVisitor {
 };
 
 const std::string C_Heaader = R"(
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <mmintrin.h>   // mmx
 #include <xmmintrin.h>  // sse
 #include <emmintrin.h>  // sse2
 #include <pmmintrin.h>  // sse3
 #include <immintrin.h>
-#include <omp.h>
 #include <sys/time.h>
 )";
 
+/// Mirrors BufferAllocator for standalone harnesses: 64-byte aligned tensors,
+/// huge-page aligned and advised once they span a huge page.
+const std::string C_Tensor_Allocator = R"(
+#include <string.h>
+#include <sys/mman.h>
+static void *polly_alloc_tensor(size_t bytes) {
+  size_t alignment = bytes >= (2 << 20) ? (2 << 20) : 64;
+  bytes = (bytes + alignment - 1) / alignment * alignment;
+  void *ptr = NULL;
+  if (posix_memalign(&ptr, alignment, bytes) != 0) abort();
+#ifdef MADV_HUGEPAGE
+  if (alignment > 64) madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+  memset(ptr, 0, bytes);
+  return ptr;
+}
+)";
+
+/// The instruction sets a kernel can be multiversioned for, see
+/// CodeGenC::genDispatch. Each one includes the ones before it.
+enum class TargetISA { SSE, AVX2, AVX512 };
+
+/// The widest vectors of `isa`, in floats.
+inline int MaxVectorLength(TargetISA isa) {
+  switch (isa) {
+    case TargetISA::SSE:
+      return 4;
+    case TargetISA::AVX2:
+      return 8;
+    default:
+      return 16;
+  }
+}
+
+/// A kernel scheduled for the CPUs supporting `isa`, vectorized by at most
+/// MaxVectorLength(isa) lanes.
+struct KernelVariant {
+  TargetISA isa;
+  IRHandle program;
+};
+
 /*!
- * \brief The code generator for C code.
+ * \brief The code generator for C code. Tensors are passed as flat float
+ * pointers, `__restrict__` unless the MemoryPlan lets them share memory.
+ * Accesses are flattened to row-major offsets, and the offset of all but the
+ * last index is hoisted into a row pointer in the inner-most loop it depends
+ * on, e.g. `float *A_row0 = A + (i) * 1024;` ahead of `A_row0[k]`.
  */
 class CodeGenC : public IRVisitor {
  public:
-  static std::string C_Runtime_Deps;
+  /// Prepended to kernels with parallel loops, see runtime/c_runtime_api.h.
+  static const std::string C_Runtime_Deps;
 
   /// Used by the parallelization.
   std::vector<std::string> tensor_name;
   std::vector<std::vector<int64_t>> tensor_shape;
+  /// Constants referenced by the program, passed as `int` parameters after
+  /// the tensors, in the order of their names.
+  std::vector<std::string> constant_name;
 
   int parallel_loop_count;
-  int worker_size = 16;
   bool parallelized = false;
 
   struct method_arguments {
@@ -66,16 +116,43 @@ class CodeGenC : public IRVisitor {
   std::vector<std::string> method_decls_;
 
   IRHandle program_;
+  std::string program_name_;
+  /// Worker functions of the parallel loops, emitted ahead of the kernel.
+  std::string method_defs_;
+  /// Intermediate tensors sharing one slab, if any.
+  const MemoryPlan *plan_ = nullptr;
+  /// Constants bound to a value are emitted as literals, which specializes
+  /// the kernel for them; they are still taken as parameters.
+  std::map<std::string, int64_t> constant_values_;
+  /// The function the parallel loops are launched through, with the type of
+  /// `polly_parallel_launch`.
+  std::string launcher_ = "polly_parallel_launch";
 
  public:
   CodeGenC() {
     parallel_loop_count = 0;
     parallelized = false;
   }
+  /// With a `plan`, the tensors it packs are zeroed before their first stage.
   std::string genCode(IRHandle program, std::vector<IRHandle> &tensors,
-                      std::string program_name);
+                      std::string program_name,
+                      const MemoryPlan *plan = nullptr);
+
+  /// A kernel `program_name` forwarding to the variant for the best ISA the
+  /// running CPU supports, picked through CPUID once the code is loaded. Each
+  /// variant is built for its own ISA whatever the compile flags, which
+  /// should target the baseline, see NativeModule::PortableCompileFlags.
+  std::string genDispatch(std::vector<KernelVariant> &variants,
+                          std::vector<IRHandle> &tensors,
+                          std::string program_name,
+                          const MemoryPlan *plan = nullptr);
+  /// Whether the running CPU supports `isa`.
+  static bool HostSupports(TargetISA isa);
 
-  std::string genTensors(std::vector<IRHandle> &tensors);
+  /// Heap-allocate the tensors of a standalone harness; the tensors packed by
+  /// `plan` are carved out of one shared slab.
+  std::string genTensors(std::vector<IRHandle> &tensors,
+                         const MemoryPlan *plan = nullptr);
   std::string genTensorParam(std::vector<IRHandle> &tensors);
 
   void visitInt(IntHandle int_expr) override;
@@ -95,26 +172,44 @@ class CodeGenC : public IRVisitor {
   void visitConst(ConstHandle con) override;
   void visitPrint(PrintHandle print) override;
   void visitFunc(FuncHandle func) override;
+  void visitPrefetch(PrefetchHandle prefetch) override;
 
   void visitMin(MinHandle min) override;
   void visitMax(MaxHandle max) override;
+  void visitSelect(SelectHandle select) override;
 
   void visitVec(VecHandle vec) override;
   void visitVecScalar(VecScalarHandle vecScalar) override;
   void visitVecLoad(VecLoadHandle vecLoad) override;
   void visitVecBroadCastLoad(VecBroadCastLoadHandle vecBroadCastLoad) override;
+  void visitVecGather(VecGatherHandle gather) override;
   void visitVecStore(VecStoreHandle vecStore) override;
   void visitVecAdd(VecAddHandle add) override;
   void visitVecSub(VecSubHandle sub) override;
   void visitVecMul(VecMulHandle mul) override;
   void visitVecDiv(VecDivHandle div) override;
+  void visitVecFMA(VecFMAHandle fma) override;
+  void visitVecMin(VecMinHandle min) override;
+  void visitVecMax(VecMaxHandle max) override;
+  void visitVecCompare(VecCompareHandle compare) override;
+  void visitVecBlend(VecBlendHandle blend) override;
+  void visitVecReduce(VecReduceHandle reduce) override;
 
   void create_method(std::string method_name,
                      std::vector<std::string> tensor_name,
-                     std::vector<std::string> outter_loop_vars, int level,
+                     std::vector<std::string> outter_loop_vars,
+                     std::vector<std::string> outter_vals, int level,
                      IRHandle loop);
   std::string tensor_shape_str(std::vector<int64_t> shape);
-  void vec_case(int vecLen, std::string str1, std::string str2);
+  /// The declaration of the i-th tensor as a kernel parameter.
+  std::string tensor_param(int i);
+  /// Prints the 128, 256 or 512-bit variant for a vector length of 4, 8 or 16.
+  void vec_case(int vecLen, std::string str1, std::string str2,
+                std::string str3);
+  /// Prints the register a vector statement assigns, declared by its first
+  /// assignment; ScalarReplacement reassigns promoted registers. Masks are
+  /// `__mmask16` registers with AVX-512.
+  void vec_def(IRHandle vec, int vecLen, bool mask = false);
   std::string getIndent() {
     std::string ret = "";
     for (int i = 0; i < indent; i++) {
@@ -124,6 +219,42 @@ class CodeGenC : public IRVisitor {
   }
   std::ostringstream oss;
   int indent = 1;
+  /// Whether 512-bit intrinsics have been emitted.
+  bool avx512_ = false;
+  /// Alignment in bytes the emitted aligned loads and stores expect of the
+  /// tensor buffers, 0 if there are none.
+  int alignment_ = 0;
+  /// Whether the function being emitted streams stores, which it then fences
+  /// before returning, see StreamingStoreAnalysis.
+  bool streamed_ = false;
+  /// The `#pragma GCC target` of the kernel and its workers, if any.
+  std::string target_;
+  /// Wider vectors are rejected, the target does not have them.
+  int max_vector_length_ = 16;
+  /// Whether VecFMA is emitted as a fused multiply-add, SSE has none.
+  bool fma_ = true;
+
+ private:
+  /// The kernel and its workers, without the includes.
+  std::string genKernel(IRHandle program, std::vector<IRHandle> &tensors,
+                        std::string program_name, const MemoryPlan *plan);
+  std::string print(IRHandle expr);
+  /// Row-major offset of the first `dims` indices of `access`.
+  std::string flat_offset(AccessHandle access, int dims);
+  std::string row_key(AccessHandle access);
+  /// Declare a row pointer for every access under `stmts` whose indices but
+  /// the last only depend on the enclosing looping variables.
+  void declare_rows(const std::vector<IRHandle> &stmts);
+  void open_row_scope() { row_scopes_.push_back({}); }
+  void close_row_scope();
+
+  /// Row pointers in scope, keyed by tensor and row offset.
+  std::map<std::string, std::string> rows_;
+  std::vector<std::vector<std::string>> row_scopes_;
+  std::vector<IRNodeKey> loop_vars_;
+  int row_count_ = 0;
+  /// Vector registers declared so far.
+  std::set<IRNodeKey> vec_defs_;
 };
 
 /*!
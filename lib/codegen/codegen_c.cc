@@ -1,16 +1,53 @@
 #include "codegen.h"
+#include "pass/parallelization/loop_scheduling.h"
 
 namespace polly {
 
-std::string CodeGenC::genTensors(std::vector<IRHandle> &tensors) {
+const std::string CodeGenC::C_Runtime_Deps = R"(
+#include <thread>
+#include <vector>
+typedef void (*PollyParallelLambda)(int wid, int worker_size, void *cdata);
+typedef void (*PollyParallelLaunchFunc)(PollyParallelLambda lambda,
+                                        void *cdata);
+// Used until a loader installs the runtime pool, e.g. in standalone harnesses.
+static void polly_thread_parallel_launch(PollyParallelLambda lambda,
+                                         void *cdata) {
+  int worker_size = std::thread::hardware_concurrency();
+  const char *env = getenv("POLLY_NUM_THREADS");
+  if (env != NULL && atoi(env) > 0) worker_size = atoi(env);
+  if (worker_size < 1) worker_size = 1;
+  std::vector<std::thread> threads;
+  for (int wid = 1; wid < worker_size; wid++)
+    threads.push_back(std::thread(lambda, wid, worker_size, cdata));
+  lambda(0, worker_size, cdata);
+  for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+}
+extern "C" {
+PollyParallelLaunchFunc polly_parallel_launch = polly_thread_parallel_launch;
+}
+)";
+
+std::string CodeGenC::genTensors(std::vector<IRHandle> &tensors,
+                                 const MemoryPlan *plan) {
   oss.clear();
+  oss << C_Tensor_Allocator;
+  if (plan != nullptr && plan->slab_size > 0) {
+    oss << "float *polly_slab = (float *)polly_alloc_tensor("
+        << plan->slab_size << " * sizeof(float));\n";
+  }
   for (int i = 0; i < tensors.size(); i++) {
-    tensor_name.push_back(tensors[i].as<TensorNode>()->id);
-    tensor_shape.push_back(tensors[i].as<TensorNode>()->shape);
-    oss << "float " << tensors[i].as<TensorNode>()->id;
-    for (int j = 0; j < tensors[i].as<TensorNode>()->shape.size(); j++)
-      oss << "[" << tensors[i].as<TensorNode>()->shape[j] << "]";
-    oss << ";\n";
+    auto tensor = tensors[i].as<TensorNode>();
+    tensor_name.push_back(tensor->id);
+    tensor_shape.push_back(tensor->shape);
+    int64_t size = 1;
+    for (auto dim : tensor->shape) size *= dim;
+    oss << "float *" << tensor->id << " = (float *)";
+    auto allocation = plan == nullptr ? nullptr : plan->Find(tensor->id);
+    if (allocation != nullptr) {
+      oss << "(polly_slab + " << allocation->offset << ");\n";
+    } else {
+      oss << "polly_alloc_tensor(" << size << " * sizeof(float));\n";
+    }
   }
   return oss.str();
 }
@@ -24,11 +61,35 @@ std::string CodeGenC::genTensorParam(std::vector<IRHandle> &tensors) {
   return oss.str();
 }
 
-std::string CodeGenC::genCode(IRHandle program, std::vector<IRHandle> &tensors,
-                              std::string program_name) {
-  program_ = program;
+class ConstantCollectionHelper : public IRRecursiveVisitor {
+ public:
+  std::set<std::string> names;
+  ConstantCollectionHelper(IRHandle program) { program.accept(this); }
+  void enter(IRHandle node) override {
+    if (node.Type() == IRNodeType::CONST) {
+      names.insert(node.as<ConstNode>()->name);
+    }
+  }
+};
 
+std::string CodeGenC::genCode(IRHandle program, std::vector<IRHandle> &tensors,
+                              std::string program_name,
+                              const MemoryPlan *plan) {
+  std::string kernel = genKernel(program, tensors, program_name, plan);
+  oss.str("");
   oss << C_Heaader;
+  if (!method_defs_.empty()) oss << C_Runtime_Deps;
+  oss << kernel;
+  return oss.str();
+}
+
+std::string CodeGenC::genKernel(IRHandle program,
+                                std::vector<IRHandle> &tensors,
+                                std::string program_name,
+                                const MemoryPlan *plan) {
+  program_ = program;
+  program_name_ = program_name;
+  plan_ = plan;
 
   oss << "void " << program_name << "(";
 
@@ -36,15 +97,157 @@ std::string CodeGenC::genCode(IRHandle program, std::vector<IRHandle> &tensors,
     if (i > 0) oss << ", ";
     tensor_name.push_back(tensors[i].as<TensorNode>()->id);
     tensor_shape.push_back(tensors[i].as<TensorNode>()->shape);
-    oss << "float " << tensors[i].as<TensorNode>()->id;
-    for (int j = 0; j < tensors[i].as<TensorNode>()->shape.size(); j++)
-      oss << "[" << tensors[i].as<TensorNode>()->shape[j] << "]";
+    oss << tensor_param(i);
+  }
+  ConstantCollectionHelper constants(program);
+  for (auto &name : constants.names) {
+    if (!constant_name.empty() || !tensors.empty()) oss << ", ";
+    constant_name.push_back(name);
+    oss << "int64_t " << name;
   }
 
   oss << ") {\n";
   visit(program);
+  if (streamed_) oss << "\t_mm_sfence();\n";
   oss << "}\n";
 
+  // The worker functions are collected while visiting the kernel body.
+  std::string kernel = oss.str();
+  // Only the kernel is built for AVX-512, whatever the flags of the harness.
+  std::string target = target_.empty() && avx512_ ? "avx512f" : target_;
+  std::ostringstream out;
+  if (!target.empty()) {
+    out << "#pragma GCC push_options\n";
+    out << "#pragma GCC target(\"" << target << "\")\n";
+  }
+  out << method_defs_ << kernel;
+  if (!target.empty()) out << "#pragma GCC pop_options\n";
+  return out.str();
+}
+
+static std::string ISAName(TargetISA isa) {
+  switch (isa) {
+    case TargetISA::SSE:
+      return "sse";
+    case TargetISA::AVX2:
+      return "avx2";
+    default:
+      return "avx512";
+  }
+}
+
+// The `#pragma GCC target` of a variant; SSE is the x86-64 baseline.
+static std::string ISATarget(TargetISA isa) {
+  switch (isa) {
+    case TargetISA::SSE:
+      return "";
+    case TargetISA::AVX2:
+      return "avx2,fma";
+    default:
+      return "avx512f,avx2,fma";
+  }
+}
+
+// The condition of the dispatcher for a variant.
+static std::string ISACheck(TargetISA isa) {
+  switch (isa) {
+    case TargetISA::SSE:
+      return "1";
+    case TargetISA::AVX2:
+      return "__builtin_cpu_supports(\"avx2\") && "
+             "__builtin_cpu_supports(\"fma\")";
+    default:
+      return "__builtin_cpu_supports(\"avx512f\")";
+  }
+}
+
+bool CodeGenC::HostSupports(TargetISA isa) {
+#if defined(__x86_64__) || defined(__i386__)
+  switch (isa) {
+    case TargetISA::SSE:
+      return true;
+    case TargetISA::AVX2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    default:
+      return __builtin_cpu_supports("avx512f");
+  }
+#endif
+  return false;
+}
+
+std::string CodeGenC::genDispatch(std::vector<KernelVariant> &variants,
+                                  std::vector<IRHandle> &tensors,
+                                  std::string program_name,
+                                  const MemoryPlan *plan) {
+  plan_ = plan;
+  if (variants.empty()) {
+    throw std::runtime_error("CodeGenC: no variant of " + program_name);
+  }
+  // The dispatcher tries the widest ISA first.
+  std::vector<KernelVariant> sorted = variants;
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const KernelVariant &a, const KernelVariant &b) {
+                     return a.isa > b.isa;
+                   });
+  std::string defs;
+  bool parallel = false;
+  for (int i = 0; i < sorted.size(); i++) {
+    if (i > 0 && sorted[i].isa == sorted[i - 1].isa) {
+      throw std::runtime_error("CodeGenC: two " + ISAName(sorted[i].isa) +
+                               " variants of " + program_name);
+    }
+    CodeGenC codegen;
+    codegen.constant_values_ = constant_values_;
+    codegen.launcher_ = launcher_;
+    codegen.target_ = ISATarget(sorted[i].isa);
+    codegen.max_vector_length_ = MaxVectorLength(sorted[i].isa);
+    codegen.fma_ = sorted[i].isa != TargetISA::SSE;
+    defs += codegen.genKernel(sorted[i].program, tensors,
+                              program_name + "_" + ISAName(sorted[i].isa),
+                              plan);
+    parallel |= !codegen.method_defs_.empty();
+    alignment_ = std::max(alignment_, codegen.alignment_);
+    tensor_name = codegen.tensor_name;
+    tensor_shape = codegen.tensor_shape;
+    constant_name = codegen.constant_name;
+  }
+
+  std::string params, args;
+  for (int i = 0; i < tensor_name.size(); i++) {
+    params += (i > 0 ? ", " : "") + tensor_param(i);
+    args += (i > 0 ? ", " : "") + tensor_name[i];
+  }
+  for (int i = 0; i < constant_name.size(); i++) {
+    std::string sep = params.empty() ? "" : ", ";
+    params += sep + "int64_t " + constant_name[i];
+    args += sep + constant_name[i];
+  }
+
+  std::string variant = program_name + "_variant";
+  oss.str("");
+  oss << C_Heaader;
+  if (parallel) oss << C_Runtime_Deps;
+  oss << defs;
+  oss << "static void (*" << variant << ")(" << params << ") = 0;\n";
+  oss << "__attribute__((constructor)) static void " << program_name
+      << "_select() {\n";
+  oss << "  __builtin_cpu_init();\n";
+  for (auto &it : sorted) {
+    oss << "  if (" << ISACheck(it.isa) << ") {\n";
+    oss << "    " << variant << " = " << program_name << "_" << ISAName(it.isa)
+        << ";\n";
+    oss << "    return;\n";
+    oss << "  }\n";
+  }
+  oss << "}\n";
+  oss << "void " << program_name << "(" << params << ") {\n";
+  oss << "  if (" << variant << " == 0) {\n";
+  oss << "    fprintf(stderr, \"" << program_name
+      << ": no variant for this CPU\\n\");\n";
+  oss << "    abort();\n";
+  oss << "  }\n";
+  oss << "  " << variant << "(" << args << ");\n";
+  oss << "}\n";
   return oss.str();
 }
 
@@ -56,40 +259,297 @@ std::string CodeGenC::tensor_shape_str(std::vector<int64_t> shape) {
   return ret;
 }
 
+/// 0-d tensors are passed by pointer too, so that the kernel can write them.
+std::string CodeGenC::tensor_param(int i) {
+  // Tensors packed by the plan may share memory with each other.
+  bool shared = plan_ != nullptr && plan_->Find(tensor_name[i]) != nullptr;
+  return std::string(shared ? "float *" : "float *__restrict__ ") +
+         tensor_name[i];
+}
+
+std::string CodeGenC::print(IRHandle expr) {
+  std::ostringstream out;
+  std::swap(oss, out);
+  expr.accept(this);
+  std::swap(oss, out);
+  return out.str();
+}
+
+std::string CodeGenC::flat_offset(AccessHandle access, int dims) {
+  auto &shape = access->tensor.as<TensorNode>()->shape;
+  std::string ret = "";
+  for (int i = 0; i < dims; i++) {
+    int64_t stride = 1;
+    for (int j = i + 1; j < shape.size(); j++) stride *= shape[j];
+    if (i > 0) ret += " + ";
+    ret += "(" + print(access->indices[i]) + ")";
+    if (stride != 1) ret += " * " + std::to_string(stride);
+  }
+  return ret;
+}
+
+std::string CodeGenC::row_key(AccessHandle access) {
+  return access->tensor.as<TensorNode>()->id + ":" +
+         flat_offset(access, access->indices.size() - 1);
+}
+
+/// Whether `expr` only depends on the variables in `bound`.
+static bool IsBoundBy(IRHandle expr, const std::set<IRNodeKey> &bound) {
+  switch (expr.Type()) {
+    case IRNodeType::INT:
+    case IRNodeType::CONST:
+      return true;
+    case IRNodeType::VAR:
+      return bound.count(expr.as<VarNode>()->id) > 0;
+    case IRNodeType::ADD:
+    case IRNodeType::SUB:
+    case IRNodeType::MUL:
+    case IRNodeType::DIV:
+    case IRNodeType::MOD:
+    case IRNodeType::MIN:
+    case IRNodeType::MAX:
+      return IsBoundBy(expr.as<BinaryNode>()->lhs, bound) &&
+             IsBoundBy(expr.as<BinaryNode>()->rhs, bound);
+    default:
+      return false;
+  }
+}
+
+class RowCollectionHelper : public IRRecursiveVisitor {
+ public:
+  std::vector<AccessHandle> accesses;
+  std::set<IRNodeKey> bound;
+  /// Parallel loops are outlined into worker functions with their own rows.
+  bool skip_parallel;
+  RowCollectionHelper(const std::vector<IRHandle> &stmts,
+                      const std::vector<IRNodeKey> &loop_vars,
+                      bool skip_parallel)
+      : bound(loop_vars.begin(), loop_vars.end()),
+        skip_parallel(skip_parallel) {
+    for (auto stmt : stmts) stmt.accept(this);
+  }
+
+  void visitFor(ForHandle loop) override {
+    if (skip_parallel && loop->annotation.parallelization) return;
+    IRRecursiveVisitor::visitFor(loop);
+  }
+
+  void enter(IRHandle node) override {
+    if (node.Type() != IRNodeType::ACCESS) return;
+    auto access = node.as<AccessNode>();
+    if (access->indices.size() < 2) return;
+    for (int i = 0; i < access->indices.size() - 1; i++) {
+      if (!IsBoundBy(access->indices[i], bound)) return;
+    }
+    accesses.push_back(access);
+  }
+};
+
+void CodeGenC::declare_rows(const std::vector<IRHandle> &stmts) {
+  RowCollectionHelper helper(stmts, loop_vars_, !parallelized);
+  for (auto &access : helper.accesses) {
+    std::string key = row_key(access);
+    if (rows_.count(key)) continue;
+    auto tensor = access->tensor.as<TensorNode>()->id;
+    std::string row = tensor + "_row" + std::to_string(row_count_++);
+    rows_[key] = row;
+    row_scopes_.back().push_back(key);
+    oss << getIndent() << "float *" << row << " = " << tensor << " + "
+        << flat_offset(access, access->indices.size() - 1) << ";\n";
+  }
+}
+
+void CodeGenC::close_row_scope() {
+  for (auto &key : row_scopes_.back()) rows_.erase(key);
+  row_scopes_.pop_back();
+}
+
 void CodeGenC::create_method(std::string method_name,
                              std::vector<std::string> tensor_name,
                              std::vector<std::string> outter_loop_vars,
-                             int level, IRHandle loop) {
+                             std::vector<std::string> outter_vals, int level,
+                             IRHandle loop) {
   std::ostringstream dec;
   dec << "inline void " << method_name << "(";
   for (int i = 0; i < tensor_name.size(); i++) {
-    dec << "float " << tensor_name[i] << tensor_shape_str(tensor_shape[i])
-        << ", ";
+    dec << tensor_param(i) << ", ";
+  }
+  for (int i = 0; i < constant_name.size(); i++) {
+    dec << "int64_t " << constant_name[i] << ", ";
   }
   for (int i = 0; i < outter_loop_vars.size(); i++) {
     dec << "int " << outter_loop_vars[i] << ", ";
   }
+  for (int i = 0; i < outter_vals.size(); i++) {
+    dec << "float " << outter_vals[i] << ", ";
+  }
+  // Workers scheduled on demand take their chunks from a shared counter.
+  auto &annotation = loop.as<ForNode>()->annotation;
+  bool on_demand = annotation.schedule != LoopAnnotation::Schedule::STATIC;
+  if (on_demand) dec << "long long *polly_next, ";
 
   dec << "int worker_size, int wid)";
 
   oss << dec.str();
   method_decls_.push_back(dec.str() + ";");
+  bool site_streamed = false;
+  std::swap(streamed_, site_streamed);
 
   oss << " {\n";
-  // TODO: method content here.
-  auto loop_var = loop.as<ForNode>()->looping_var_.as<VarNode>();
-  oss << getIndent();
-  oss << "for (int " << loop_var->id << " = wid; " << loop_var->id << " < ";
-  loop_var->max.accept(this);
-  oss << "; " << loop_var->id << " += worker_size) {\n";
-  indent += 1;
-  for (int i = 0; i < loop.as<ForNode>()->body.size(); i++) {
-    loop.as<ForNode>()->body[i].accept(this);
+  // The row pointers of the enclosing kernel are not visible in the worker.
+  std::map<std::string, std::string> site_rows;
+  std::swap(rows_, site_rows);
+  open_row_scope();
+  declare_rows({loop});
+  // The loops collapsed into the parallel one share a flat iteration space,
+  // each worker decodes the iterators of the flat iterations it takes.
+  std::vector<ForHandle> nest = {loop.as<ForNode>()};
+  int collapse = std::min(annotation.collapse,
+                          LoopScheduling::CollapsibleDepth(loop));
+  while (nest.size() < collapse) {
+    nest.push_back(nest.back()->body[0].as<ForNode>());
+  }
+  std::string trips = "";
+  for (int k = 0; k < nest.size(); k++) {
+    auto var = nest[k]->looping_var_.as<VarNode>();
+    std::string n = std::to_string(k);
+    oss << getIndent() << "long long polly_min" << n << " = "
+        << print(var->min) << ", polly_inc" << n << " = "
+        << print(var->increment) << ";\n";
+    oss << getIndent() << "long long polly_trip" << n << " = ("
+        << print(var->max) << " - polly_min" << n << " + polly_inc" << n
+        << " - 1) / polly_inc" << n << ";\n";
+    oss << getIndent() << "if (polly_trip" << n << " <= 0) return;\n";
+    trips += (k > 0 ? " * polly_trip" : "polly_trip") + n;
+  }
+  oss << getIndent() << "long long polly_trip = " << trips << ";\n";
+
+  std::string chunk = std::to_string(std::max(annotation.chunk, 1));
+  int blocks = 0;
+  auto open_block = [&](std::string head) {
+    oss << getIndent() << head << " {\n";
+    indent += 1;
+    blocks += 1;
+  };
+  auto take_chunk = [&]() {
+    oss << getIndent() << "long long polly_end = polly_base + " << chunk
+        << " < polly_trip ? polly_base + " << chunk << " : polly_trip;\n";
+    open_block("for (long long polly_it = polly_base; polly_it < polly_end; "
+               "polly_it++)");
+  };
+  switch (annotation.schedule) {
+    case LoopAnnotation::Schedule::STATIC:
+      if (annotation.chunk <= 0) {
+        // Every worker takes one contiguous block of iterations, the same
+        // split as FirstTouch, so that it computes on the pages it has placed.
+        oss << getIndent() << "long long polly_first = polly_trip * wid / "
+            << "worker_size;\n";
+        oss << getIndent() << "long long polly_last = polly_trip * (wid + 1) "
+            << "/ worker_size;\n";
+        open_block("for (long long polly_it = polly_first; polly_it < "
+                   "polly_last; polly_it++)");
+      } else {
+        open_block("for (long long polly_base = (long long)wid * " + chunk +
+                   "; polly_base < polly_trip; polly_base += (long long)"
+                   "worker_size * " + chunk + ")");
+        take_chunk();
+      }
+      break;
+    case LoopAnnotation::Schedule::DYNAMIC:
+      open_block("for (;;)");
+      oss << getIndent() << "long long polly_base = __atomic_fetch_add("
+          << "polly_next, " << chunk << ", __ATOMIC_RELAXED);\n";
+      oss << getIndent() << "if (polly_base >= polly_trip) return;\n";
+      take_chunk();
+      break;
+    case LoopAnnotation::Schedule::GUIDED:
+      // Chunks shrink with the remaining iterations, down to `chunk`.
+      open_block("for (;;)");
+      oss << getIndent() << "long long polly_base = __atomic_load_n("
+          << "polly_next, __ATOMIC_RELAXED), polly_end;\n";
+      oss << getIndent() << "do {\n";
+      oss << getIndent() << "\tif (polly_base >= polly_trip) return;\n";
+      oss << getIndent() << "\tpolly_end = polly_base + (polly_trip - "
+          << "polly_base) / (2 * worker_size);\n";
+      oss << getIndent() << "\tif (polly_end < polly_base + " << chunk
+          << ") polly_end = polly_base + " << chunk << ";\n";
+      oss << getIndent() << "\tif (polly_end > polly_trip) polly_end = "
+          << "polly_trip;\n";
+      oss << getIndent() << "} while (!__atomic_compare_exchange_n("
+          << "polly_next, &polly_base, polly_end, true, __ATOMIC_RELAXED, "
+          << "__ATOMIC_RELAXED));\n";
+      open_block("for (long long polly_it = polly_base; polly_it < "
+                 "polly_end; polly_it++)");
+      break;
+  }
+  std::string stride = "";
+  for (int k = nest.size() - 1; k >= 0; k--) {
+    auto var = nest[k]->looping_var_.as<VarNode>();
+    std::string n = std::to_string(k);
+    std::string index = "polly_it";
+    if (!stride.empty()) index += " / (" + stride + ")";
+    if (k > 0) index = "(" + index + ") % polly_trip" + n;
+    oss << getIndent() << "int " << var->id << " = polly_min" << n << " + ("
+        << index << ") * polly_inc" << n << ";\n";
+    stride = stride.empty() ? "polly_trip" + n
+                            : "polly_trip" + n + " * " + stride;
+    loop_vars_.push_back(var->id);
+  }
+  open_row_scope();
+  declare_rows(nest.back()->body);
+  for (int i = 0; i < nest.back()->body.size(); i++) {
+    nest.back()->body[i].accept(this);
+  }
+  close_row_scope();
+  loop_vars_.resize(loop_vars_.size() - nest.size());
+  for (; blocks > 0; blocks--) {
+    indent -= 1;
+    oss << getIndent() << "}\n";
   }
-  indent -= 1;
-  oss << getIndent();
   oss << "}\n";
+  close_row_scope();
+  std::swap(rows_, site_rows);
+
+  // The closure packs the arguments of the worker function for the launch.
+  oss << "struct " << method_name << "_closure {\n";
+  for (int i = 0; i < tensor_name.size(); i++) {
+    oss << "  float *" << tensor_name[i] << ";\n";
+  }
+  for (int i = 0; i < constant_name.size(); i++) {
+    oss << "  int64_t " << constant_name[i] << ";\n";
+  }
+  for (int i = 0; i < outter_loop_vars.size(); i++) {
+    oss << "  int " << outter_loop_vars[i] << ";\n";
+  }
+  for (int i = 0; i < outter_vals.size(); i++) {
+    oss << "  float " << outter_vals[i] << ";\n";
+  }
+  if (on_demand) oss << "  long long *polly_next;\n";
+  oss << "};\n";
+  oss << "static void " << method_name
+      << "_lambda(int wid, int worker_size, void *cdata) {\n";
+  oss << "  " << method_name << "_closure *c = (" << method_name
+      << "_closure *)cdata;\n";
+  oss << "  " << method_name << "(";
+  for (int i = 0; i < tensor_name.size(); i++) {
+    oss << "c->" << tensor_name[i] << ", ";
+  }
+  for (int i = 0; i < constant_name.size(); i++) {
+    oss << "c->" << constant_name[i] << ", ";
+  }
+  for (int i = 0; i < outter_loop_vars.size(); i++) {
+    oss << "c->" << outter_loop_vars[i] << ", ";
+  }
+  for (int i = 0; i < outter_vals.size(); i++) {
+    oss << "c->" << outter_vals[i] << ", ";
+  }
+  if (on_demand) oss << "c->polly_next, ";
+  oss << "worker_size, wid);\n";
+  // The worker may return early, its streamed stores are fenced here, before
+  // the pool reports it done.
+  if (streamed_) oss << "  _mm_sfence();\n";
   oss << "}\n";
+  std::swap(streamed_, site_streamed);
 }
 
 void CodeGenC::visitInt(IntHandle int_expr) { oss << int_expr->value; }
@@ -145,13 +605,22 @@ void CodeGenC::visitMod(ModHandle mod) {
 void CodeGenC::visitVar(VarHandle var) { oss << var->id; }
 
 void CodeGenC::visitAccess(AccessHandle access) {
-  access->tensor.accept(this);
-  oss << "[";
-  for (int i = 0; i < access->indices.size(); i++) {
-    access->indices[i].accept(this);
-    oss << "]";
-    if (i != access->indices.size() - 1) oss << "[";
+  if (access->indices.empty()) {
+    access->tensor.accept(this);
+    oss << "[0]";
+    return;
   }
+  if (access->indices.size() > 1) {
+    auto row = rows_.find(row_key(access));
+    if (row != rows_.end()) {
+      oss << row->second << "[";
+      access->indices.back().accept(this);
+      oss << "]";
+      return;
+    }
+  }
+  access->tensor.accept(this);
+  oss << "[" << flat_offset(access, access->indices.size()) << "]";
 }
 
 void CodeGenC::visitAssign(AssignmentHandle assign) {
@@ -176,6 +645,8 @@ class OutterLoopCollectionHelper : public IRRecursiveVisitor {
  public:
   IRHandle loop;
   std::vector<std::string> outter_loops;
+  /// Values declared in the enclosing scopes ahead of the loop.
+  std::vector<std::string> outter_vals;
   bool stop;
   OutterLoopCollectionHelper(IRHandle program, IRHandle loop) : loop(loop) {
     stop = false;
@@ -191,26 +662,70 @@ class OutterLoopCollectionHelper : public IRRecursiveVisitor {
     if (node.Type() == IRNodeType::FOR) {
       outter_loops.push_back(
           node.as<ForNode>()->looping_var_.as<VarNode>()->id);
+      scopes_.push_back(outter_vals.size());
+    }
+    if (node.Type() == IRNodeType::DECLARATION) {
+      outter_vals.push_back(
+          node.as<DeclNode>()->decl.as<ValNode>()->id);
     }
   }
   void exit(IRHandle node) override {
     if (stop) return;
-    if (node.Type() == IRNodeType::FOR) outter_loops.pop_back();
+    if (node.Type() == IRNodeType::FOR) {
+      outter_loops.pop_back();
+      outter_vals.resize(scopes_.back());
+      scopes_.pop_back();
+    }
   }
+
+ private:
+  std::vector<size_t> scopes_;
 };
 
+/// The outer-most parallel loop of a nest becomes a worker function, launched
+/// on the runtime pool through `polly_parallel_launch`; the loops nested in it
+/// run sequentially within each worker.
 void CodeGenC::visitFor(ForHandle loop) {
   VarHandle loop_var = loop->looping_var_.as<VarNode>();
 
-  bool do_parallelization = loop->annotation.parallelization && !parallelized;
+  if (loop->annotation.parallelization && !parallelized) {
+    std::string method_name =
+        program_name_ + "_parallel_" + std::to_string(parallel_loop_count++);
+    OutterLoopCollectionHelper helper(program_, IRHandle(loop));
 
-  if (do_parallelization) {
-    oss << getIndent();
-    oss << "{\n";
-    indent += 1;
-    oss << getIndent();
-    oss << "#pragma omp parallel for\n";
+    std::ostringstream site;
+    std::swap(oss, site);
+    int site_indent = indent;
+    indent = 1;
     parallelized = true;
+    create_method(method_name, tensor_name, helper.outter_loops,
+                  helper.outter_vals, 0, IRHandle(loop));
+    parallelized = false;
+    indent = site_indent;
+    std::swap(oss, site);
+    method_defs_ += site.str();
+
+    oss << getIndent() << "{\n";
+    bool on_demand =
+        loop->annotation.schedule != LoopAnnotation::Schedule::STATIC;
+    if (on_demand) oss << getIndent() << "\tlong long polly_next = 0;\n";
+    oss << getIndent() << "\t" << method_name << "_closure polly_closure = {";
+    std::vector<std::string> fields = tensor_name;
+    fields.insert(fields.end(), constant_name.begin(), constant_name.end());
+    fields.insert(fields.end(), helper.outter_loops.begin(),
+                  helper.outter_loops.end());
+    fields.insert(fields.end(), helper.outter_vals.begin(),
+                  helper.outter_vals.end());
+    if (on_demand) fields.push_back("&polly_next");
+    for (int i = 0; i < fields.size(); i++) {
+      if (i > 0) oss << ", ";
+      oss << fields[i];
+    }
+    oss << "};\n";
+    oss << getIndent() << "\t" << launcher_ << "(" << method_name
+        << "_lambda, &polly_closure);\n";
+    oss << getIndent() << "}\n";
+    return;
   }
 
   oss << getIndent();
@@ -228,23 +743,28 @@ void CodeGenC::visitFor(ForHandle loop) {
   loop_var->increment.accept(this);
   oss << ") {\n";
   indent += 1;
+  loop_vars_.push_back(loop_var->id);
+  open_row_scope();
+  declare_rows(loop->body);
   for (int i = 0; i < loop->body.size(); i++) {
     loop->body[i].accept(this);
   }
+  close_row_scope();
+  loop_vars_.pop_back();
   indent -= 1;
   oss << getIndent();
   oss << "}\n";
+}
 
-  if (do_parallelization) {
-    indent -= 1;
-    oss << getIndent();
-    oss << "}\n";
+void CodeGenC::visitConst(ConstHandle con) {
+  auto it = constant_values_.find(con->name);
+  if (it != constant_values_.end()) {
+    oss << it->second;
+  } else {
+    oss << con->name;
   }
-  parallelized = false;
 }
 
-void CodeGenC::visitConst(ConstHandle con) { oss << con->name; }
-
 void CodeGenC::visitPrint(PrintHandle print) {
   oss << getIndent();
   oss << "std::cout << ";
@@ -252,45 +772,83 @@ void CodeGenC::visitPrint(PrintHandle print) {
   oss << " << \"\\n\";\n";
 }
 
+void CodeGenC::visitPrefetch(PrefetchHandle prefetch) {
+  oss << getIndent();
+  oss << "_mm_prefetch((const char *)&";
+  prefetch->data.accept(this);
+  oss << ", _MM_HINT_T0);\n";
+}
+
 void CodeGenC::visitFunc(FuncHandle func) {
+  open_row_scope();
+  declare_rows(func->body);
   for (int i = 0; i < func->body.size(); i++) {
+    if (plan_ != nullptr) {
+      for (auto &allocation : plan_->allocations) {
+        if (allocation.first_stage != i) continue;
+        oss << getIndent() << "memset(" << allocation.tensor << ", 0, "
+            << allocation.size << " * sizeof(float));\n";
+      }
+    }
     func->body[i].accept(this);
   }
+  close_row_scope();
 }
 
+// Min and max are conditionals, as _mm_min_ps and _mm_max_ps are, so that
+// the lanes of vectorized loops match their scalar remainders.
 void CodeGenC::visitMin(MinHandle min) {
-  oss << "min(";
-  min->lhs.accept(this);
-  oss << ", ";
-  min->rhs.accept(this);
-  oss << ")";
+  std::string lhs = print(min->lhs), rhs = print(min->rhs);
+  oss << "((" << lhs << ") < (" << rhs << ") ? (" << lhs << ") : (" << rhs
+      << "))";
 }
 
 void CodeGenC::visitMax(MaxHandle max) {
-  oss << "max(";
-  max->lhs.accept(this);
-  oss << ", ";
-  max->rhs.accept(this);
-  oss << ")";
+  std::string lhs = print(max->lhs), rhs = print(max->rhs);
+  oss << "((" << lhs << ") > (" << rhs << ") ? (" << lhs << ") : (" << rhs
+      << "))";
+}
+
+void CodeGenC::visitSelect(SelectHandle select) {
+  oss << "((";
+  select->lhs.accept(this);
+  oss << ") " << CompareOpStr(select->op) << " (";
+  select->rhs.accept(this);
+  oss << ") ? (";
+  select->true_value.accept(this);
+  oss << ") : (";
+  select->false_value.accept(this);
+  oss << "))";
 }
 
 void CodeGenC::visitVec(VecHandle vec) { oss << vec->id; }
+void CodeGenC::vec_def(IRHandle vec, int vecLen, bool mask) {
+  if (vec_defs_.insert(vec.as<VecNode>()->id).second) {
+    vec_case(vecLen, "__m128 ", "__m256 ", mask ? "__mmask16 " : "__m512 ");
+  }
+  vec.accept(this);
+}
 void CodeGenC::visitVecScalar(VecScalarHandle vecScalar) {
-  vec_case(vecScalar->length, "__m128 ", "__m256 ");
-  vecScalar->vec.accept(this);
+  vec_def(vecScalar->vec, vecScalar->length);
   oss << " = ";
-  vec_case(vecScalar->length, "_mm_set1_ps(", "_mm256_set1_ps(");
+  vec_case(vecScalar->length, "_mm_set1_ps(", "_mm256_set1_ps(",
+           "_mm512_set1_ps(");
 
   vecScalar->scalar.accept(this);
   oss << ")";
   oss << ";\n";
 }
 void CodeGenC::visitVecLoad(VecLoadHandle vecLoad) {
-  vec_case(vecLoad->length, "__m128 ", "__m256 ");
-
-  vecLoad->vec.accept(this);
+  vec_def(vecLoad->vec, vecLoad->length);
   oss << " = ";
-  vec_case(vecLoad->length, "_mm_loadu_ps(", "_mm256_broadcast_ss(");
+  if (vecLoad->aligned) {
+    vec_case(vecLoad->length, "_mm_load_ps(", "_mm256_load_ps(",
+             "_mm512_load_ps(");
+    alignment_ = std::max(alignment_, vecLoad->length * 4);
+  } else {
+    vec_case(vecLoad->length, "_mm_loadu_ps(", "_mm256_loadu_ps(",
+             "_mm512_loadu_ps(");
+  }
 
   oss << "&";
   vecLoad->data.accept(this);
@@ -298,19 +856,44 @@ void CodeGenC::visitVecLoad(VecLoadHandle vecLoad) {
   oss << ";\n";
 }
 void CodeGenC::visitVecBroadCastLoad(VecBroadCastLoadHandle vecBroadCastLoad) {
-  vec_case(vecBroadCastLoad->length, "__m128 ", "__m256 ");
-
-  vecBroadCastLoad->vec.accept(this);
+  vec_def(vecBroadCastLoad->vec, vecBroadCastLoad->length);
   oss << " = ";
-  vec_case(vecBroadCastLoad->length, "_mm_load_ps1(", "_mm256_broadcast_ss(");
+  vec_case(vecBroadCastLoad->length, "_mm_load_ps1(",
+           "_mm256_broadcast_ss(", "_mm512_set1_ps(*");
 
   oss << "&";
   vecBroadCastLoad->data.accept(this);
   oss << ")";
   oss << ";\n";
 }
+// The lanes are loaded one by one, so no gather instruction is required.
+void CodeGenC::visitVecGather(VecGatherHandle gather) {
+  std::string data = print(gather->data);
+  vec_def(gather->vec, gather->length);
+  oss << " = ";
+  vec_case(gather->length, "_mm_set_ps(", "_mm256_set_ps(", "_mm512_set_ps(");
+  // The highest lane comes first.
+  for (int lane = gather->length - 1; lane >= 0; lane--) {
+    oss << "(&" << data << ")[" << lane * gather->stride << "]";
+    if (lane > 0) oss << ", ";
+  }
+  oss << ")";
+  oss << ";\n";
+}
 void CodeGenC::visitVecStore(VecStoreHandle vecStore) {
-  vec_case(vecStore->length, "_mm_storeu_ps(", "_mm256_storeu_ps(");
+  if (vecStore->aligned && vecStore->nontemporal) {
+    vec_case(vecStore->length, "_mm_stream_ps(", "_mm256_stream_ps(",
+             "_mm512_stream_ps(");
+    alignment_ = std::max(alignment_, vecStore->length * 4);
+    streamed_ = true;
+  } else if (vecStore->aligned) {
+    vec_case(vecStore->length, "_mm_store_ps(", "_mm256_store_ps(",
+             "_mm512_store_ps(");
+    alignment_ = std::max(alignment_, vecStore->length * 4);
+  } else {
+    vec_case(vecStore->length, "_mm_storeu_ps(", "_mm256_storeu_ps(",
+             "_mm512_storeu_ps(");
+  }
   oss << "&";
   vecStore->data.accept(this);
   oss << ", ";
@@ -319,11 +902,10 @@ void CodeGenC::visitVecStore(VecStoreHandle vecStore) {
   oss << ";\n";
 }
 void CodeGenC::visitVecAdd(VecAddHandle add) {
-  vec_case(add->length, "__m128 ", "__m256 ");
-
-  add->vec.accept(this);
+  vec_def(add->vec, add->length);
   oss << " = ";
-  vec_case(add->length, "_mm_add_ps(", "_mm256_add_ps(");
+  vec_case(add->length, "_mm_add_ps(", "_mm256_add_ps(",
+           "_mm512_add_ps(");
 
   add->lhs.accept(this);
   oss << ", ";
@@ -332,11 +914,10 @@ void CodeGenC::visitVecAdd(VecAddHandle add) {
   oss << ";\n";
 }
 void CodeGenC::visitVecSub(VecSubHandle sub) {
-  vec_case(sub->length, "__m128 ", "__m256 ");
-
-  sub->vec.accept(this);
+  vec_def(sub->vec, sub->length);
   oss << " = ";
-  vec_case(sub->length, "_mm_sub_ps(", "_mm256_sub_ps(");
+  vec_case(sub->length, "_mm_sub_ps(", "_mm256_sub_ps(",
+           "_mm512_sub_ps(");
 
   sub->lhs.accept(this);
   oss << ", ";
@@ -345,11 +926,10 @@ void CodeGenC::visitVecSub(VecSubHandle sub) {
   oss << ";\n";
 }
 void CodeGenC::visitVecMul(VecMulHandle mul) {
-  vec_case(mul->length, "__m128 ", "__m256 ");
-
-  mul->vec.accept(this);
+  vec_def(mul->vec, mul->length);
   oss << " = ";
-  vec_case(mul->length, "_mm_mul_ps(", "_mm256_mul_ps(");
+  vec_case(mul->length, "_mm_mul_ps(", "_mm256_mul_ps(",
+           "_mm512_mul_ps(");
 
   mul->lhs.accept(this);
   oss << ", ";
@@ -358,11 +938,10 @@ void CodeGenC::visitVecMul(VecMulHandle mul) {
   oss << ";\n";
 }
 void CodeGenC::visitVecDiv(VecDivHandle div) {
-  vec_case(div->length, "__m128 ", "__m256 ");
-
-  div->vec.accept(this);
+  vec_def(div->vec, div->length);
   oss << " = ";
-  vec_case(div->length, "_mm_div_ps(", "_mm256_div_ps(");
+  vec_case(div->length, "_mm_div_ps(", "_mm256_div_ps(",
+           "_mm512_div_ps(");
 
   div->lhs.accept(this);
   oss << ", ";
@@ -370,13 +949,182 @@ void CodeGenC::visitVecDiv(VecDivHandle div) {
   oss << ")";
   oss << ";\n";
 }
+void CodeGenC::visitVecFMA(VecFMAHandle fma) {
+  vec_def(fma->vec, fma->length);
+  oss << " = ";
+  if (!fma_) {
+    vec_case(fma->length, "_mm_add_ps(", "_mm256_add_ps(", "_mm512_add_ps(");
+    vec_case(fma->length, "_mm_mul_ps(", "_mm256_mul_ps(", "_mm512_mul_ps(");
+    fma->a.accept(this);
+    oss << ", ";
+    fma->b.accept(this);
+    oss << "), ";
+    fma->c.accept(this);
+    oss << ")";
+    oss << ";\n";
+    return;
+  }
+  vec_case(fma->length, "_mm_fmadd_ps(", "_mm256_fmadd_ps(",
+           "_mm512_fmadd_ps(");
 
-void CodeGenC::vec_case(int vecLen, std::string str1, std::string str2) {
+  fma->a.accept(this);
+  oss << ", ";
+  fma->b.accept(this);
+  oss << ", ";
+  fma->c.accept(this);
+  oss << ")";
+  oss << ";\n";
+}
+
+void CodeGenC::visitVecMin(VecMinHandle min) {
+  vec_def(min->vec, min->length);
+  oss << " = ";
+  vec_case(min->length, "_mm_min_ps(", "_mm256_min_ps(", "_mm512_min_ps(");
+
+  min->lhs.accept(this);
+  oss << ", ";
+  min->rhs.accept(this);
+  oss << ")";
+  oss << ";\n";
+}
+void CodeGenC::visitVecMax(VecMaxHandle max) {
+  vec_def(max->vec, max->length);
+  oss << " = ";
+  vec_case(max->length, "_mm_max_ps(", "_mm256_max_ps(", "_mm512_max_ps(");
+
+  max->lhs.accept(this);
+  oss << ", ";
+  max->rhs.accept(this);
+  oss << ")";
+  oss << ";\n";
+}
+// Ordered predicates but !=, which holds for NaN as it does in C.
+static std::string CmpPredicate(CompareOp op) {
+  switch (op) {
+    case CompareOp::GE:
+      return "_CMP_GE_OQ";
+    case CompareOp::LE:
+      return "_CMP_LE_OQ";
+    case CompareOp::GT:
+      return "_CMP_GT_OQ";
+    case CompareOp::LT:
+      return "_CMP_LT_OQ";
+    case CompareOp::EQ:
+      return "_CMP_EQ_OQ";
+    default:
+      return "_CMP_NEQ_UQ";
+  }
+}
+// The SSE compares, _mm_cmp_ps needs AVX.
+static std::string SSECompare(CompareOp op) {
+  switch (op) {
+    case CompareOp::GE:
+      return "_mm_cmpge_ps(";
+    case CompareOp::LE:
+      return "_mm_cmple_ps(";
+    case CompareOp::GT:
+      return "_mm_cmpgt_ps(";
+    case CompareOp::LT:
+      return "_mm_cmplt_ps(";
+    case CompareOp::EQ:
+      return "_mm_cmpeq_ps(";
+    default:
+      return "_mm_cmpneq_ps(";
+  }
+}
+void CodeGenC::visitVecCompare(VecCompareHandle compare) {
+  // AVX-512 compares into a mask register.
+  vec_def(compare->vec, compare->length, true);
+  oss << " = ";
+  vec_case(compare->length, SSECompare(compare->op), "_mm256_cmp_ps(",
+           "_mm512_cmp_ps_mask(");
+
+  compare->lhs.accept(this);
+  oss << ", ";
+  compare->rhs.accept(this);
+  if (compare->length > 4) oss << ", " << CmpPredicate(compare->op);
+  oss << ")";
+  oss << ";\n";
+}
+void CodeGenC::visitVecBlend(VecBlendHandle blend) {
+  std::string mask = print(blend->mask);
+  std::string true_value = print(blend->true_value);
+  std::string false_value = print(blend->false_value);
+  vec_def(blend->vec, blend->length);
+  oss << " = ";
+  if (blend->length == 4) {
+    // _mm_blendv_ps needs SSE4.1.
+    oss << "_mm_or_ps(_mm_and_ps(" << mask << ", " << true_value
+        << "), _mm_andnot_ps(" << mask << ", " << false_value << "))";
+  } else {
+    vec_case(blend->length, "", "_mm256_blendv_ps(", "_mm512_mask_blend_ps(");
+    if (blend->length == 8) {
+      oss << false_value << ", " << true_value << ", " << mask << ")";
+    } else {
+      oss << mask << ", " << false_value << ", " << true_value << ")";
+    }
+  }
+  oss << ";\n";
+}
+
+// The name of a reduction in the SSE/AVX intrinsics, e.g. `_mm_add_ps`.
+static std::string ReduceIntrinsic(ReduceOp op) {
+  switch (op) {
+    case ReduceOp::ADD:
+      return "add";
+    case ReduceOp::MUL:
+      return "mul";
+    case ReduceOp::MIN:
+      return "min";
+    default:
+      return "max";
+  }
+}
+void CodeGenC::visitVecReduce(VecReduceHandle reduce) {
+  std::string op = ReduceIntrinsic(reduce->op);
+  std::string vec = print(reduce->vec);
+  std::string data = print(reduce->data);
+  auto halve256 = [&](std::string v) {
+    return "_mm_" + op + "_ps(_mm256_castps256_ps128(" + v +
+           "), _mm256_extractf128_ps(" + v + ", 1))";
+  };
+  std::string halve512 = "_mm256_" + op + "_ps(_mm512_castps512_ps256(" +
+                         vec + "), _mm256_castpd_ps(_mm512_extractf64x4_pd(" +
+                         "_mm512_castps_pd(" + vec + "), 1)))";
+  // Halve the vector down to 128 bits, then fold the upper pair of lanes
+  // onto the lower one, and the second lane onto the first.
+  oss << getIndent() << "{\n";
+  indent += 1;
+  oss << getIndent();
+  vec_case(reduce->length, "__m128 h128 = " + vec,
+           "__m128 h128 = " + halve256(vec),
+           "__m256 h256 = " + halve512 + ";\n" + getIndent() +
+               "__m128 h128 = " + halve256("h256"));
+  oss << ";\n";
+  oss << getIndent() << "h128 = _mm_" << op
+      << "_ps(h128, _mm_movehl_ps(h128, h128));\n";
+  oss << getIndent() << "h128 = _mm_" << op
+      << "_ps(h128, _mm_shuffle_ps(h128, h128, 1));\n";
+  oss << getIndent() << data << " = _mm_cvtss_f32(_mm_" << op
+      << "_ss(_mm_set_ss(" << data << "), h128));\n";
+  indent -= 1;
+  oss << getIndent() << "}\n";
+}
+
+void CodeGenC::vec_case(int vecLen, std::string str1, std::string str2,
+                        std::string str3) {
+  if (vecLen > max_vector_length_) {
+    throw std::runtime_error("CodeGenC: " + std::to_string(vecLen) +
+                             "-wide vectors are not supported by the target");
+  }
   if (vecLen == 4)
     oss << str1;
   else if (vecLen == 8)
     oss << str2;
-  else
+  else if (vecLen == 16) {
+    oss << str3;
+    avx512_ = true;
+  } else
     throw std::runtime_error("Unsupported VecLen");
 }
 
@@ -158,6 +158,154 @@ IRHandle IRHandle::clone(std::map<IRNodeKey, IRHandle> &irHandleDict) {
       break;
     }
 
+    case IRNodeType::SELECT: {
+      ret = SelectNode::make(as<SelectNode>()->op,
+                             as<SelectNode>()->lhs.clone(irHandleDict),
+                             as<SelectNode>()->rhs.clone(irHandleDict),
+                             as<SelectNode>()->true_value.clone(irHandleDict),
+                             as<SelectNode>()->false_value.clone(irHandleDict));
+      break;
+    }
+
+    case IRNodeType::VEC: {
+      if (irHandleDict.find(as<VecNode>()->id) != irHandleDict.end()) {
+        ret = irHandleDict[as<VecNode>()->id];
+      } else {
+        ret = VecNode::make(as<VecNode>()->id, as<VecNode>()->length);
+        irHandleDict[as<VecNode>()->id] = ret;
+      }
+      break;
+    }
+
+    case IRNodeType::VEC_SCALAR: {
+      ret = VecScalarNode::make(as<VecScalarNode>()->vec.clone(irHandleDict),
+                                as<VecScalarNode>()->scalar.clone(irHandleDict),
+                                as<VecScalarNode>()->length);
+      break;
+    }
+
+    case IRNodeType::VEC_LOAD: {
+      ret = VecLoadNode::make(as<VecLoadNode>()->vec.clone(irHandleDict),
+                              as<VecLoadNode>()->data.clone(irHandleDict),
+                              as<VecLoadNode>()->length,
+                              as<VecLoadNode>()->aligned);
+      break;
+    }
+
+    case IRNodeType::VEC_BROADCAST_LOAD: {
+      ret = VecBroadCastLoadNode::make(
+          as<VecBroadCastLoadNode>()->vec.clone(irHandleDict),
+          as<VecBroadCastLoadNode>()->data.clone(irHandleDict),
+          as<VecBroadCastLoadNode>()->length);
+      break;
+    }
+
+    case IRNodeType::VEC_GATHER: {
+      auto gather = as<VecGatherNode>();
+      ret = VecGatherNode::make(gather->vec.clone(irHandleDict),
+                                gather->data.clone(irHandleDict),
+                                gather->stride, gather->length);
+      break;
+    }
+
+    case IRNodeType::VEC_STORE: {
+      ret = VecStoreNode::make(as<VecStoreNode>()->vec.clone(irHandleDict),
+                               as<VecStoreNode>()->data.clone(irHandleDict),
+                               as<VecStoreNode>()->length,
+                               as<VecStoreNode>()->aligned,
+                               as<VecStoreNode>()->nontemporal);
+      break;
+    }
+
+    case IRNodeType::VEC_ADD: {
+      ret = VecAddNode::make(as<VecAddNode>()->vec.clone(irHandleDict),
+                             as<VecAddNode>()->lhs.clone(irHandleDict),
+                             as<VecAddNode>()->rhs.clone(irHandleDict),
+                             as<VecAddNode>()->length);
+      break;
+    }
+
+    case IRNodeType::VEC_SUB: {
+      ret = VecSubNode::make(as<VecSubNode>()->vec.clone(irHandleDict),
+                             as<VecSubNode>()->lhs.clone(irHandleDict),
+                             as<VecSubNode>()->rhs.clone(irHandleDict),
+                             as<VecSubNode>()->length);
+      break;
+    }
+
+    case IRNodeType::VEC_MUL: {
+      ret = VecMulNode::make(as<VecMulNode>()->vec.clone(irHandleDict),
+                             as<VecMulNode>()->lhs.clone(irHandleDict),
+                             as<VecMulNode>()->rhs.clone(irHandleDict),
+                             as<VecMulNode>()->length);
+      break;
+    }
+
+    case IRNodeType::VEC_DIV: {
+      ret = VecDivNode::make(as<VecDivNode>()->vec.clone(irHandleDict),
+                             as<VecDivNode>()->lhs.clone(irHandleDict),
+                             as<VecDivNode>()->rhs.clone(irHandleDict),
+                             as<VecDivNode>()->length);
+      break;
+    }
+
+    case IRNodeType::VEC_FMA: {
+      ret = VecFMANode::make(as<VecFMANode>()->vec.clone(irHandleDict),
+                             as<VecFMANode>()->a.clone(irHandleDict),
+                             as<VecFMANode>()->b.clone(irHandleDict),
+                             as<VecFMANode>()->c.clone(irHandleDict),
+                             as<VecFMANode>()->length);
+      break;
+    }
+
+    case IRNodeType::VEC_MIN: {
+      ret = VecMinNode::make(as<VecMinNode>()->vec.clone(irHandleDict),
+                             as<VecMinNode>()->lhs.clone(irHandleDict),
+                             as<VecMinNode>()->rhs.clone(irHandleDict),
+                             as<VecMinNode>()->length);
+      break;
+    }
+
+    case IRNodeType::VEC_MAX: {
+      ret = VecMaxNode::make(as<VecMaxNode>()->vec.clone(irHandleDict),
+                             as<VecMaxNode>()->lhs.clone(irHandleDict),
+                             as<VecMaxNode>()->rhs.clone(irHandleDict),
+                             as<VecMaxNode>()->length);
+      break;
+    }
+
+    case IRNodeType::VEC_COMPARE: {
+      ret = VecCompareNode::make(as<VecCompareNode>()->vec.clone(irHandleDict),
+                                 as<VecCompareNode>()->lhs.clone(irHandleDict),
+                                 as<VecCompareNode>()->rhs.clone(irHandleDict),
+                                 as<VecCompareNode>()->op,
+                                 as<VecCompareNode>()->length);
+      break;
+    }
+
+    case IRNodeType::VEC_BLEND: {
+      auto blend = as<VecBlendNode>();
+      ret = VecBlendNode::make(blend->vec.clone(irHandleDict),
+                               blend->mask.clone(irHandleDict),
+                               blend->true_value.clone(irHandleDict),
+                               blend->false_value.clone(irHandleDict),
+                               blend->length);
+      break;
+    }
+
+    case IRNodeType::VEC_REDUCE: {
+      auto reduce = as<VecReduceNode>();
+      ret = VecReduceNode::make(reduce->vec.clone(irHandleDict),
+                                reduce->data.clone(irHandleDict), reduce->op,
+                                reduce->length);
+      break;
+    }
+
+    case IRNodeType::PREFETCH: {
+      ret = PrefetchNode::make(as<PrefetchNode>()->data.clone(irHandleDict));
+      break;
+    }
+
     default:
       throw std::runtime_error("Unknown IRHandle Type, cannot clone");
   }
@@ -263,10 +411,9 @@ IRHandle ForNode::make(IRHandle looping_var) {
 }
 
 IRHandle ConstNode::make(std::string name) {
-  // ConstNode *node = new ConstNode();
-  // node->name = name;
-  // return IRHandle(node);
-  throw std::runtime_error("Not Implemented Error: ConstNode");
+  ConstNode *node = new ConstNode();
+  node->name = name;
+  return IRHandle(node);
 }
 
 IRHandle PrintNode::make(IRNodeKey id, IRHandle print) {
@@ -298,6 +445,34 @@ IRHandle MaxNode::make(IRHandle lhs, IRHandle rhs) {
   return IRHandle(max);
 }
 
+std::string CompareOpStr(CompareOp op) {
+  switch (op) {
+    case CompareOp::GE:
+      return ">=";
+    case CompareOp::LE:
+      return "<=";
+    case CompareOp::GT:
+      return ">";
+    case CompareOp::LT:
+      return "<";
+    case CompareOp::EQ:
+      return "==";
+    default:
+      return "!=";
+  }
+}
+
+IRHandle SelectNode::make(CompareOp op, IRHandle lhs, IRHandle rhs,
+                          IRHandle true_value, IRHandle false_value) {
+  SelectNode *select = new SelectNode();
+  select->op = op;
+  select->lhs = lhs;
+  select->rhs = rhs;
+  select->true_value = true_value;
+  select->false_value = false_value;
+  return IRHandle(select);
+}
+
 IRHandle VecNode::make(IRNodeKey id, int length) {
   VecNode *node = new VecNode();
   node->id = id;
@@ -313,11 +488,13 @@ IRHandle VecScalarNode::make(IRHandle vec, IRHandle scalar, int length) {
   return IRHandle(node);
 }
 
-IRHandle VecLoadNode::make(IRHandle vec, IRHandle data, int length) {
+IRHandle VecLoadNode::make(IRHandle vec, IRHandle data, int length,
+                          bool aligned) {
   VecLoadNode *node = new VecLoadNode();
   node->vec = vec;
   node->data = data;
   node->length = length;
+  node->aligned = aligned;
   return IRHandle(node);
 }
 
@@ -329,11 +506,24 @@ IRHandle VecBroadCastLoadNode::make(IRHandle vec, IRHandle data, int length) {
   return IRHandle(node);
 }
 
-IRHandle VecStoreNode::make(IRHandle vec, IRHandle data, int length) {
+IRHandle VecGatherNode::make(IRHandle vec, IRHandle data, int64_t stride,
+                             int length) {
+  VecGatherNode *node = new VecGatherNode();
+  node->vec = vec;
+  node->data = data;
+  node->stride = stride;
+  node->length = length;
+  return IRHandle(node);
+}
+
+IRHandle VecStoreNode::make(IRHandle vec, IRHandle data, int length,
+                           bool aligned, bool nontemporal) {
   VecStoreNode *node = new VecStoreNode();
   node->vec = vec;
   node->data = data;
   node->length = length;
+  node->aligned = aligned;
+  node->nontemporal = nontemporal;
   return IRHandle(node);
 }
 
@@ -376,4 +566,86 @@ IRHandle VecDivNode::make(IRHandle vec, IRHandle lhs, IRHandle rhs,
   return IRHandle(node);
 }
 
+IRHandle VecFMANode::make(IRHandle vec, IRHandle a, IRHandle b, IRHandle c,
+                          int length) {
+  VecFMANode *node = new VecFMANode();
+  node->vec = vec;
+  node->a = a;
+  node->b = b;
+  node->c = c;
+  node->length = length;
+  return IRHandle(node);
+}
+
+IRHandle VecMinNode::make(IRHandle vec, IRHandle lhs, IRHandle rhs,
+                          int length) {
+  VecMinNode *node = new VecMinNode();
+  node->vec = vec;
+  node->lhs = lhs;
+  node->rhs = rhs;
+  node->length = length;
+  return IRHandle(node);
+}
+
+IRHandle VecMaxNode::make(IRHandle vec, IRHandle lhs, IRHandle rhs,
+                          int length) {
+  VecMaxNode *node = new VecMaxNode();
+  node->vec = vec;
+  node->lhs = lhs;
+  node->rhs = rhs;
+  node->length = length;
+  return IRHandle(node);
+}
+
+IRHandle VecCompareNode::make(IRHandle vec, IRHandle lhs, IRHandle rhs,
+                              CompareOp op, int length) {
+  VecCompareNode *node = new VecCompareNode();
+  node->vec = vec;
+  node->lhs = lhs;
+  node->rhs = rhs;
+  node->op = op;
+  node->length = length;
+  return IRHandle(node);
+}
+
+IRHandle VecBlendNode::make(IRHandle vec, IRHandle mask, IRHandle true_value,
+                            IRHandle false_value, int length) {
+  VecBlendNode *node = new VecBlendNode();
+  node->vec = vec;
+  node->mask = mask;
+  node->true_value = true_value;
+  node->false_value = false_value;
+  node->length = length;
+  return IRHandle(node);
+}
+
+std::string ReduceOpStr(ReduceOp op) {
+  switch (op) {
+    case ReduceOp::ADD:
+      return "+";
+    case ReduceOp::MUL:
+      return "*";
+    case ReduceOp::MIN:
+      return "min";
+    default:
+      return "max";
+  }
+}
+
+IRHandle VecReduceNode::make(IRHandle vec, IRHandle data, ReduceOp op,
+                             int length) {
+  VecReduceNode *node = new VecReduceNode();
+  node->vec = vec;
+  node->data = data;
+  node->op = op;
+  node->length = length;
+  return IRHandle(node);
+}
+
+IRHandle PrefetchNode::make(IRHandle data) {
+  PrefetchNode *node = new PrefetchNode();
+  node->data = data;
+  return IRHandle(node);
+}
+
 }  // namespace polly
\ No newline at end of file
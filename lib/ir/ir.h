@@ -36,6 +36,7 @@ enum IRNodeType {
 
   MIN,
   MAX,
+  SELECT,
 
   VEC,
   VEC_ADD,
@@ -46,6 +47,15 @@ enum IRNodeType {
   VEC_STORE,
   VEC_BROADCAST_LOAD,
   VEC_SCALAR,
+  VEC_FMA,
+  VEC_MIN,
+  VEC_MAX,
+  VEC_COMPARE,
+  VEC_BLEND,
+  VEC_REDUCE,
+  VEC_GATHER,
+
+  PREFETCH,
 };
 
 class IntNode;
@@ -67,9 +77,11 @@ class DeclNode;
 class ForNode;
 class PrintNode;
 class FuncNode;
+class PrefetchNode;
 
 class MinNode;
 class MaxNode;
+class SelectNode;
 
 // SIMD related nodes
 class VecNode;
@@ -81,6 +93,13 @@ class VecAddNode;
 class VecSubNode;
 class VecMulNode;
 class VecDivNode;
+class VecFMANode;
+class VecMinNode;
+class VecMaxNode;
+class VecCompareNode;
+class VecBlendNode;
+class VecReduceNode;
+class VecGatherNode;
 
 class IRVisitor;
 
@@ -99,12 +118,14 @@ typedef std::shared_ptr<ForNode> ForHandle;
 typedef std::shared_ptr<ConstNode> ConstHandle;
 typedef std::shared_ptr<PrintNode> PrintHandle;
 typedef std::shared_ptr<FuncNode> FuncHandle;
+typedef std::shared_ptr<PrefetchNode> PrefetchHandle;
 
 typedef std::shared_ptr<ValNode> ValHandle;
 typedef std::shared_ptr<DeclNode> DeclHandle;
 
 typedef std::shared_ptr<MinNode> MinHandle;
 typedef std::shared_ptr<MaxNode> MaxHandle;
+typedef std::shared_ptr<SelectNode> SelectHandle;
 
 typedef std::shared_ptr<VecNode> VecHandle;
 typedef std::shared_ptr<VecScalarNode> VecScalarHandle;
@@ -115,6 +136,13 @@ typedef std::shared_ptr<VecAddNode> VecAddHandle;
 typedef std::shared_ptr<VecSubNode> VecSubHandle;
 typedef std::shared_ptr<VecMulNode> VecMulHandle;
 typedef std::shared_ptr<VecDivNode> VecDivHandle;
+typedef std::shared_ptr<VecFMANode> VecFMAHandle;
+typedef std::shared_ptr<VecMinNode> VecMinHandle;
+typedef std::shared_ptr<VecMaxNode> VecMaxHandle;
+typedef std::shared_ptr<VecCompareNode> VecCompareHandle;
+typedef std::shared_ptr<VecBlendNode> VecBlendHandle;
+typedef std::shared_ptr<VecReduceNode> VecReduceHandle;
+typedef std::shared_ptr<VecGatherNode> VecGatherHandle;
 
 /// IRNodeKey is used to identify a certain IR-Node.
 typedef std::string IRNodeKey;
@@ -459,10 +487,18 @@ class AssignmentNode : public IRNode {
 
 class LoopAnnotation {
  public:
+  /// How the iterations of a parallel loop are handed to the workers: one
+  /// block each (or `chunk` sized blocks round-robin), chunks taken on demand,
+  /// or on-demand chunks shrinking with the remaining work.
+  enum class Schedule { STATIC, DYNAMIC, GUIDED };
+
   LoopAnnotation() {
     parallelization = false;
     max_parallelization_degree = -1;
     parallelization_degree = -1;
+    collapse = 1;
+    schedule = Schedule::STATIC;
+    chunk = 0;
     vectorization = false;
     max_vectorization_length = -1;
     vectorization_length = -1;
@@ -471,6 +507,12 @@ class LoopAnnotation {
   bool parallelization;
   int max_parallelization_degree;
   int parallelization_degree;
+  // Number of perfectly nested loops, this one included, whose iterations are
+  // shared by the workers of a parallel loop as one flat space.
+  int collapse;
+  Schedule schedule;
+  // Iterations per chunk, 0 for the default of the schedule.
+  int chunk;
   bool vectorization;
   int max_vectorization_length;
   int vectorization_length;
@@ -562,6 +604,25 @@ class FuncNode : public IRNode {
   }
 };
 
+/// Fetch the cache line of an access ahead of its use, see SoftwarePrefetch.
+/// It has no effect on the values of the program.
+class PrefetchNode : public IRNode {
+ private:
+  PrefetchNode() {}
+
+ public:
+  IRHandle data;
+
+  static IRHandle make(IRHandle data);
+
+  IRNodeType Type() const override { return IRNodeType::PREFETCH; }
+  bool equals(const IRNode *other) override {
+    if (other == nullptr) return false;
+    if (Type() != other->Type()) return false;
+    return data.equals(static_cast<const PrefetchNode *>(other)->data);
+  }
+};
+
 // TODO: Complete the unary node.
 class UnaryNode : public IRNode {
  public:
@@ -616,18 +677,41 @@ class MaxNode : public BinaryNode {
 
   IRNodeType Type() const override { return IRNodeType::MAX; }
 };
-// >=
-class GeNode : public BinaryNode {};
-// <=
-class LeNode : public BinaryNode {};
-// >
-class GtNode : public BinaryNode {};
-// <
-class LtNode : public BinaryNode {};
-// ==
-class EqNode : public BinaryNode {};
-// !=
-class NeqNode : public BinaryNode {};
+
+enum class CompareOp {
+  GE,  // >=
+  LE,  // <=
+  GT,  // >
+  LT,  // <
+  EQ,  // ==
+  NE,  // !=
+};
+
+/// C spelling of a comparison, e.g. ">=".
+std::string CompareOpStr(CompareOp op);
+
+// (lhs op rhs) ? true_value : false_value
+class SelectNode : public IRNode {
+ private:
+  SelectNode() {}
+
+ public:
+  CompareOp op;
+  IRHandle lhs, rhs, true_value, false_value;
+  static IRHandle make(CompareOp op, IRHandle lhs, IRHandle rhs,
+                       IRHandle true_value, IRHandle false_value);
+
+  bool equals(const IRNode *other) override {
+    if (other == nullptr) return false;
+    if (Type() != other->Type()) return false;
+    auto o_ptr = static_cast<const SelectNode *>(other);
+    return (op == o_ptr->op) && (lhs.equals(o_ptr->lhs)) &&
+           (rhs.equals(o_ptr->rhs)) && (true_value.equals(o_ptr->true_value)) &&
+           (false_value.equals(o_ptr->false_value));
+  }
+
+  IRNodeType Type() const override { return IRNodeType::SELECT; }
+};
 
 class VecNode : public IRNode {
  public:
@@ -664,14 +748,17 @@ class VecLoadNode : public IRNode {
  public:
   IRHandle vec, data;
   int length;
-  static IRHandle make(IRHandle vec, IRHandle data, int length);
+  /// Every address is a multiple of the vector size, see AlignmentAnalysis.
+  bool aligned;
+  static IRHandle make(IRHandle vec, IRHandle data, int length,
+                       bool aligned = false);
 
   bool equals(const IRNode *other) override {
     if (other == nullptr) return false;
     if (Type() != other->Type()) return false;
     auto o_ptr = static_cast<const VecLoadNode *>(other);
     return (vec.equals(o_ptr->vec)) && (data.equals(o_ptr->data)) &&
-           (length == o_ptr->length);
+           (length == o_ptr->length) && (aligned == o_ptr->aligned);
   }
   IRNodeType Type() const override { return IRNodeType::VEC_LOAD; }
 };
@@ -690,18 +777,45 @@ class VecBroadCastLoadNode : public IRNode {
   }
   IRNodeType Type() const override { return IRNodeType::VEC_BROADCAST_LOAD; }
 };
+/// vec[l] = (&data)[l * stride] for every lane l, the load of an access that
+/// is strided along the vectorized loop. `stride` is in elements of the
+/// flattened tensor.
+class VecGatherNode : public IRNode {
+ public:
+  IRHandle vec, data;
+  int64_t stride;
+  int length;
+  static IRHandle make(IRHandle vec, IRHandle data, int64_t stride,
+                       int length);
+
+  bool equals(const IRNode *other) override {
+    if (other == nullptr) return false;
+    if (Type() != other->Type()) return false;
+    auto o_ptr = static_cast<const VecGatherNode *>(other);
+    return (vec.equals(o_ptr->vec)) && (data.equals(o_ptr->data)) &&
+           (stride == o_ptr->stride) && (length == o_ptr->length);
+  }
+  IRNodeType Type() const override { return IRNodeType::VEC_GATHER; }
+};
 class VecStoreNode : public IRNode {
  public:
   IRHandle vec, data;
   int length;
-  static IRHandle make(IRHandle vec, IRHandle data, int length);
+  /// Every address is a multiple of the vector size, see AlignmentAnalysis.
+  bool aligned;
+  /// Bypass the caches, see StreamingStoreAnalysis. Only aligned stores are
+  /// streamed.
+  bool nontemporal;
+  static IRHandle make(IRHandle vec, IRHandle data, int length,
+                       bool aligned = false, bool nontemporal = false);
 
   bool equals(const IRNode *other) override {
     if (other == nullptr) return false;
     if (Type() != other->Type()) return false;
     auto o_ptr = static_cast<const VecStoreNode *>(other);
     return (vec.equals(o_ptr->vec)) && (data.equals(o_ptr->data)) &&
-           (length == o_ptr->length);
+           (length == o_ptr->length) && (aligned == o_ptr->aligned) &&
+           (nontemporal == o_ptr->nontemporal);
   }
   IRNodeType Type() const override { return IRNodeType::VEC_STORE; }
 };
@@ -769,5 +883,121 @@ class VecDivNode : public IRNode {
   }
   IRNodeType Type() const override { return IRNodeType::VEC_DIV; }
 };
+/// vec = a * b + c, rounded once.
+class VecFMANode : public IRNode {
+ public:
+  IRHandle vec, a, b, c;
+  int length;
+  static IRHandle make(IRHandle vec, IRHandle a, IRHandle b, IRHandle c,
+                       int length);
+
+  bool equals(const IRNode *other) override {
+    if (other == nullptr) return false;
+    if (Type() != other->Type()) return false;
+    auto o_ptr = static_cast<const VecFMANode *>(other);
+    return (vec.equals(o_ptr->vec)) && (a.equals(o_ptr->a)) &&
+           (b.equals(o_ptr->b)) && (c.equals(o_ptr->c)) &&
+           (length == o_ptr->length);
+  }
+  IRNodeType Type() const override { return IRNodeType::VEC_FMA; }
+};
+class VecMinNode : public IRNode {
+ public:
+  IRHandle vec, lhs, rhs;
+  int length;
+  static IRHandle make(IRHandle vec, IRHandle lhs, IRHandle rhs, int length);
+
+  bool equals(const IRNode *other) override {
+    if (other == nullptr) return false;
+    if (Type() != other->Type()) return false;
+    auto o_ptr = static_cast<const VecMinNode *>(other);
+    return (vec.equals(o_ptr->vec)) && (lhs.equals(o_ptr->lhs)) &&
+           (rhs.equals(o_ptr->rhs)) && (length == o_ptr->length);
+  }
+  IRNodeType Type() const override { return IRNodeType::VEC_MIN; }
+};
+class VecMaxNode : public IRNode {
+ public:
+  IRHandle vec, lhs, rhs;
+  int length;
+  static IRHandle make(IRHandle vec, IRHandle lhs, IRHandle rhs, int length);
+
+  bool equals(const IRNode *other) override {
+    if (other == nullptr) return false;
+    if (Type() != other->Type()) return false;
+    auto o_ptr = static_cast<const VecMaxNode *>(other);
+    return (vec.equals(o_ptr->vec)) && (lhs.equals(o_ptr->lhs)) &&
+           (rhs.equals(o_ptr->rhs)) && (length == o_ptr->length);
+  }
+  IRNodeType Type() const override { return IRNodeType::VEC_MAX; }
+};
+/// vec = lhs op rhs, every bit of a lane set where it holds, clear otherwise.
+class VecCompareNode : public IRNode {
+ public:
+  IRHandle vec, lhs, rhs;
+  CompareOp op;
+  int length;
+  static IRHandle make(IRHandle vec, IRHandle lhs, IRHandle rhs, CompareOp op,
+                       int length);
+
+  bool equals(const IRNode *other) override {
+    if (other == nullptr) return false;
+    if (Type() != other->Type()) return false;
+    auto o_ptr = static_cast<const VecCompareNode *>(other);
+    return (vec.equals(o_ptr->vec)) && (lhs.equals(o_ptr->lhs)) &&
+           (rhs.equals(o_ptr->rhs)) && (op == o_ptr->op) &&
+           (length == o_ptr->length);
+  }
+  IRNodeType Type() const override { return IRNodeType::VEC_COMPARE; }
+};
+/// vec = mask ? true_value : false_value per lane, `mask` is a VecCompare.
+class VecBlendNode : public IRNode {
+ public:
+  IRHandle vec, mask, true_value, false_value;
+  int length;
+  static IRHandle make(IRHandle vec, IRHandle mask, IRHandle true_value,
+                       IRHandle false_value, int length);
+
+  bool equals(const IRNode *other) override {
+    if (other == nullptr) return false;
+    if (Type() != other->Type()) return false;
+    auto o_ptr = static_cast<const VecBlendNode *>(other);
+    return (vec.equals(o_ptr->vec)) && (mask.equals(o_ptr->mask)) &&
+           (true_value.equals(o_ptr->true_value)) &&
+           (false_value.equals(o_ptr->false_value)) &&
+           (length == o_ptr->length);
+  }
+  IRNodeType Type() const override { return IRNodeType::VEC_BLEND; }
+};
+
+enum class ReduceOp {
+  ADD,
+  MUL,
+  MIN,
+  MAX,
+};
+
+/// C spelling of a reduction, e.g. "+" or "min".
+std::string ReduceOpStr(ReduceOp op);
+
+/// data = data op (vec[0] op vec[1] op ... op vec[length - 1]), the
+/// horizontal epilogue of a vectorized reduction. `data` is an access or a
+/// value, the lanes are combined in any order.
+class VecReduceNode : public IRNode {
+ public:
+  IRHandle vec, data;
+  ReduceOp op;
+  int length;
+  static IRHandle make(IRHandle vec, IRHandle data, ReduceOp op, int length);
+
+  bool equals(const IRNode *other) override {
+    if (other == nullptr) return false;
+    if (Type() != other->Type()) return false;
+    auto o_ptr = static_cast<const VecReduceNode *>(other);
+    return (vec.equals(o_ptr->vec)) && (data.equals(o_ptr->data)) &&
+           (op == o_ptr->op) && (length == o_ptr->length);
+  }
+  IRNodeType Type() const override { return IRNodeType::VEC_REDUCE; }
+};
 
 }  // namespace polly
\ No newline at end of file
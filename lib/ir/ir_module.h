@@ -82,6 +82,7 @@ class IRModule {
 
   IRHandle& GetRoot() { return root_; }
   std::vector<IRHandle>& GetTensors() { return tensors_; }
+  std::vector<IRHandle>& GetConstants() { return constants_; }
 
   /// Extract all IRNodes from a program.
   std::unordered_set<IRHandle, IRHandleHash> GetIRNodes();
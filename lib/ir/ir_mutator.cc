@@ -126,5 +126,12 @@ void IRMutatorVisitor::visitMax(MaxHandle max) {
   max->lhs = _replace_subnode_helper(max->lhs);
   max->rhs = _replace_subnode_helper(max->rhs);
 }
+void IRMutatorVisitor::visitSelect(SelectHandle select) {
+  assert(select != nullptr);
+  select->lhs = _replace_subnode_helper(select->lhs);
+  select->rhs = _replace_subnode_helper(select->rhs);
+  select->true_value = _replace_subnode_helper(select->true_value);
+  select->false_value = _replace_subnode_helper(select->false_value);
+}
 
 }  // namespace polly
@@ -57,6 +57,9 @@ void IRVisitor::visit(IRHandle expr) {
     case IRNodeType::FUNC:
       this->visitFunc(expr.as<FuncNode>());
       break;
+    case IRNodeType::PREFETCH:
+      this->visitPrefetch(expr.as<PrefetchNode>());
+      break;
 
     case IRNodeType::MIN:
       this->visitMin(expr.as<MinNode>());
@@ -64,6 +67,9 @@ void IRVisitor::visit(IRHandle expr) {
     case IRNodeType::MAX:
       this->visitMax(expr.as<MaxNode>());
       break;
+    case IRNodeType::SELECT:
+      this->visitSelect(expr.as<SelectNode>());
+      break;
 
     case IRNodeType::VEC:
       this->visitVec(expr.as<VecNode>());
@@ -77,6 +83,9 @@ void IRVisitor::visit(IRHandle expr) {
     case IRNodeType::VEC_BROADCAST_LOAD:
       this->visitVecBroadCastLoad(expr.as<VecBroadCastLoadNode>());
       break;
+    case IRNodeType::VEC_GATHER:
+      this->visitVecGather(expr.as<VecGatherNode>());
+      break;
     case IRNodeType::VEC_STORE:
       this->visitVecStore(expr.as<VecStoreNode>());
       break;
@@ -92,6 +101,24 @@ void IRVisitor::visit(IRHandle expr) {
     case IRNodeType::VEC_DIV:
       this->visitVecDiv(expr.as<VecDivNode>());
       break;
+    case IRNodeType::VEC_FMA:
+      this->visitVecFMA(expr.as<VecFMANode>());
+      break;
+    case IRNodeType::VEC_MIN:
+      this->visitVecMin(expr.as<VecMinNode>());
+      break;
+    case IRNodeType::VEC_MAX:
+      this->visitVecMax(expr.as<VecMaxNode>());
+      break;
+    case IRNodeType::VEC_COMPARE:
+      this->visitVecCompare(expr.as<VecCompareNode>());
+      break;
+    case IRNodeType::VEC_BLEND:
+      this->visitVecBlend(expr.as<VecBlendNode>());
+      break;
+    case IRNodeType::VEC_REDUCE:
+      this->visitVecReduce(expr.as<VecReduceNode>());
+      break;
 
     default:
       std::cout << expr.Type() << '\n';
@@ -174,6 +201,12 @@ void IRPrinterVisitor::visitFunc(FuncHandle func) {
   }
 }
 
+void IRPrinterVisitor::visitPrefetch(PrefetchHandle prefetch) {
+  std::cout << "prefetch ";
+  prefetch->data.accept(this);
+  std::cout << ";\n";
+}
+
 void IRPrinterVisitor::visitMin(MinHandle min) {
   std::cout << "min(";
   min->lhs.accept(this);
@@ -189,6 +222,18 @@ void IRPrinterVisitor::visitMax(MaxHandle max) {
   std::cout << ")";
 }
 
+void IRPrinterVisitor::visitSelect(SelectHandle select) {
+  std::cout << "(";
+  select->lhs.accept(this);
+  std::cout << " " << CompareOpStr(select->op) << " ";
+  select->rhs.accept(this);
+  std::cout << " ? ";
+  select->true_value.accept(this);
+  std::cout << " : ";
+  select->false_value.accept(this);
+  std::cout << ")";
+}
+
 void IRPrinterVisitor::visitVec(VecHandle vec) { std::cout << vec->id; }
 void IRPrinterVisitor::visitVecScalar(VecScalarHandle vecScalar) {
   vec_case(vecScalar->length);
@@ -225,6 +270,15 @@ void IRPrinterVisitor::visitVecBroadCastLoad(
   std::cout << ")";
   std::cout << ";\n";
 }
+void IRPrinterVisitor::visitVecGather(VecGatherHandle gather) {
+  vec_case(gather->length);
+
+  gather->vec.accept(this);
+  std::cout << " = gather(&";
+  gather->data.accept(this);
+  std::cout << ", " << gather->stride << ")";
+  std::cout << ";\n";
+}
 void IRPrinterVisitor::visitVecStore(VecStoreHandle vecStore) {
   vec_case(vecStore->length);
   std::cout << "&";
@@ -286,6 +340,76 @@ void IRPrinterVisitor::visitVecDiv(VecDivHandle div) {
   std::cout << ")";
   std::cout << ";\n";
 }
+void IRPrinterVisitor::visitVecFMA(VecFMAHandle fma) {
+  vec_case(fma->length);
+
+  fma->vec.accept(this);
+  std::cout << " = fma(";
+  fma->a.accept(this);
+  std::cout << ", ";
+  fma->b.accept(this);
+  std::cout << ", ";
+  fma->c.accept(this);
+  std::cout << ")";
+  std::cout << ";\n";
+}
+
+void IRPrinterVisitor::visitVecMin(VecMinHandle min) {
+  vec_case(min->length);
+
+  min->vec.accept(this);
+  std::cout << " = min(";
+  min->lhs.accept(this);
+  std::cout << ", ";
+  min->rhs.accept(this);
+  std::cout << ")";
+  std::cout << ";\n";
+}
+void IRPrinterVisitor::visitVecMax(VecMaxHandle max) {
+  vec_case(max->length);
+
+  max->vec.accept(this);
+  std::cout << " = max(";
+  max->lhs.accept(this);
+  std::cout << ", ";
+  max->rhs.accept(this);
+  std::cout << ")";
+  std::cout << ";\n";
+}
+void IRPrinterVisitor::visitVecCompare(VecCompareHandle compare) {
+  vec_case(compare->length);
+
+  compare->vec.accept(this);
+  std::cout << " = ";
+  compare->lhs.accept(this);
+  std::cout << " " << CompareOpStr(compare->op) << " ";
+  compare->rhs.accept(this);
+  std::cout << ";\n";
+}
+void IRPrinterVisitor::visitVecBlend(VecBlendHandle blend) {
+  vec_case(blend->length);
+
+  blend->vec.accept(this);
+  std::cout << " = blend(";
+  blend->mask.accept(this);
+  std::cout << ", ";
+  blend->true_value.accept(this);
+  std::cout << ", ";
+  blend->false_value.accept(this);
+  std::cout << ")";
+  std::cout << ";\n";
+}
+void IRPrinterVisitor::visitVecReduce(VecReduceHandle reduce) {
+  vec_case(reduce->length);
+
+  reduce->data.accept(this);
+  std::cout << " = reduce_" << ReduceOpStr(reduce->op) << "(";
+  reduce->data.accept(this);
+  std::cout << ", ";
+  reduce->vec.accept(this);
+  std::cout << ")";
+  std::cout << ";\n";
+}
 
 void IRPrinterVisitor::vec_case(int vecLen) {
   std::cout << "simd" << vecLen << " ";
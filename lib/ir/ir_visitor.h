@@ -34,20 +34,29 @@ class IRVisitor {
   virtual void visitConst(ConstHandle con) = 0;
   virtual void visitPrint(PrintHandle print) = 0;
   virtual void visitFunc(FuncHandle func) = 0;
+  virtual void visitPrefetch(PrefetchHandle prefetch) = 0;
 
   virtual void visitMin(MinHandle min) = 0;
   virtual void visitMax(MaxHandle max) = 0;
+  virtual void visitSelect(SelectHandle select) = 0;
 
   virtual void visitVec(VecHandle vec) = 0;
   virtual void visitVecScalar(VecScalarHandle vecScalar) = 0;
   virtual void visitVecLoad(VecLoadHandle vecLoad) = 0;
   virtual void visitVecBroadCastLoad(
       VecBroadCastLoadHandle VecBroadCastLoad) = 0;
+  virtual void visitVecGather(VecGatherHandle gather) = 0;
   virtual void visitVecStore(VecStoreHandle VecStore) = 0;
   virtual void visitVecAdd(VecAddHandle add) = 0;
   virtual void visitVecSub(VecSubHandle sub) = 0;
   virtual void visitVecMul(VecMulHandle mul) = 0;
   virtual void visitVecDiv(VecDivHandle div) = 0;
+  virtual void visitVecFMA(VecFMAHandle fma) = 0;
+  virtual void visitVecMin(VecMinHandle min) = 0;
+  virtual void visitVecMax(VecMaxHandle max) = 0;
+  virtual void visitVecCompare(VecCompareHandle compare) = 0;
+  virtual void visitVecBlend(VecBlendHandle blend) = 0;
+  virtual void visitVecReduce(VecReduceHandle reduce) = 0;
 };
 
 class IRSimpleVisitor : public IRVisitor {
@@ -73,9 +82,13 @@ class IRSimpleVisitor : public IRVisitor {
   void visitConst(ConstHandle con) override { helper(IRHandle(con)); }
   void visitPrint(PrintHandle print) override { helper(IRHandle(print)); }
   void visitFunc(FuncHandle func) override { helper(IRHandle(func)); }
+  void visitPrefetch(PrefetchHandle prefetch) override {
+    helper(IRHandle(prefetch));
+  }
 
   void visitMin(MinHandle min) override { helper(IRHandle(min)); }
   void visitMax(MaxHandle max) override { helper(IRHandle(max)); }
+  void visitSelect(SelectHandle select) override { helper(IRHandle(select)); }
 
   void visitVec(VecHandle vec) override { helper(IRHandle(vec)); }
   void visitVecScalar(VecScalarHandle vecScalar) override {
@@ -87,6 +100,9 @@ class IRSimpleVisitor : public IRVisitor {
   void visitVecBroadCastLoad(VecBroadCastLoadHandle VecBroadCastLoad) override {
     helper(IRHandle(VecBroadCastLoad));
   }
+  void visitVecGather(VecGatherHandle gather) override {
+    helper(IRHandle(gather));
+  }
   void visitVecStore(VecStoreHandle VecStore) override {
     helper(IRHandle(VecStore));
   }
@@ -94,6 +110,18 @@ class IRSimpleVisitor : public IRVisitor {
   void visitVecSub(VecSubHandle sub) override { helper(IRHandle(sub)); }
   void visitVecMul(VecMulHandle mul) override { helper(IRHandle(mul)); }
   void visitVecDiv(VecDivHandle div) override { helper(IRHandle(div)); }
+  void visitVecFMA(VecFMAHandle fma) override { helper(IRHandle(fma)); }
+  void visitVecMin(VecMinHandle min) override { helper(IRHandle(min)); }
+  void visitVecMax(VecMaxHandle max) override { helper(IRHandle(max)); }
+  void visitVecCompare(VecCompareHandle compare) override {
+    helper(IRHandle(compare));
+  }
+  void visitVecBlend(VecBlendHandle blend) override {
+    helper(IRHandle(blend));
+  }
+  void visitVecReduce(VecReduceHandle reduce) override {
+    helper(IRHandle(reduce));
+  }
 
   virtual void helper(IRHandle node) { return; }
 };
@@ -132,6 +160,49 @@ class IRRecursiveVisitor : public IRVisitor {
     div->rhs.accept(this);
     exit(IRHandle(div));
   }
+  void visitVecFMA(VecFMAHandle fma) override {
+    enter(IRHandle(fma));
+    fma->vec.accept(this);
+    fma->a.accept(this);
+    fma->b.accept(this);
+    fma->c.accept(this);
+    exit(IRHandle(fma));
+  }
+  void visitVecMin(VecMinHandle min) override {
+    enter(IRHandle(min));
+    min->vec.accept(this);
+    min->lhs.accept(this);
+    min->rhs.accept(this);
+    exit(IRHandle(min));
+  }
+  void visitVecMax(VecMaxHandle max) override {
+    enter(IRHandle(max));
+    max->vec.accept(this);
+    max->lhs.accept(this);
+    max->rhs.accept(this);
+    exit(IRHandle(max));
+  }
+  void visitVecCompare(VecCompareHandle compare) override {
+    enter(IRHandle(compare));
+    compare->vec.accept(this);
+    compare->lhs.accept(this);
+    compare->rhs.accept(this);
+    exit(IRHandle(compare));
+  }
+  void visitVecBlend(VecBlendHandle blend) override {
+    enter(IRHandle(blend));
+    blend->vec.accept(this);
+    blend->mask.accept(this);
+    blend->true_value.accept(this);
+    blend->false_value.accept(this);
+    exit(IRHandle(blend));
+  }
+  void visitVecReduce(VecReduceHandle reduce) override {
+    enter(IRHandle(reduce));
+    reduce->vec.accept(this);
+    reduce->data.accept(this);
+    exit(IRHandle(reduce));
+  }
   void visitMod(ModHandle mod) override {
     enter(IRHandle(mod));
     mod->lhs.accept(this);
@@ -193,6 +264,11 @@ class IRRecursiveVisitor : public IRVisitor {
     for (int i = 0; i < func->body.size(); i++) func->body[i].accept(this);
     exit(IRHandle(func));
   }
+  void visitPrefetch(PrefetchHandle prefetch) override {
+    enter(IRHandle(prefetch));
+    prefetch->data.accept(this);
+    exit(IRHandle(prefetch));
+  }
 
   void visitMin(MinHandle min) override {
     enter(IRHandle(min));
@@ -208,6 +284,15 @@ class IRRecursiveVisitor : public IRVisitor {
     exit(IRHandle(max));
   }
 
+  void visitSelect(SelectHandle select) override {
+    enter(IRHandle(select));
+    select->lhs.accept(this);
+    select->rhs.accept(this);
+    select->true_value.accept(this);
+    select->false_value.accept(this);
+    exit(IRHandle(select));
+  }
+
   void visitVec(VecHandle vec) override {
     enter(IRHandle(vec));
     exit(IRHandle(vec));
@@ -230,6 +315,12 @@ class IRRecursiveVisitor : public IRVisitor {
     VecBroadCastLoad->data.accept(this);
     exit(IRHandle(VecBroadCastLoad));
   }
+  void visitVecGather(VecGatherHandle gather) override {
+    enter(IRHandle(gather));
+    gather->vec.accept(this);
+    gather->data.accept(this);
+    exit(IRHandle(gather));
+  }
   void visitVecStore(VecStoreHandle VecStore) override {
     enter(IRHandle(VecStore));
     VecStore->vec.accept(this);
@@ -292,9 +383,13 @@ class IRNotImplementedVisitor : public IRVisitor {
   void visitConst(ConstHandle con) override { throw_exception("Constant"); }
   void visitPrint(PrintHandle print) override { throw_exception("Print"); }
   void visitFunc(FuncHandle func) override { throw_exception("Func"); }
+  void visitPrefetch(PrefetchHandle prefetch) override {
+    throw_exception("Prefetch");
+  }
 
   void visitMin(MinHandle min) override { throw_exception("Min"); }
   void visitMax(MaxHandle max) override { throw_exception("Max"); }
+  void visitSelect(SelectHandle select) override { throw_exception("Select"); }
 
   void visitVec(VecHandle vec) override { throw_exception("Vec"); }
   void visitVecScalar(VecScalarHandle vecScalar) override {
@@ -306,6 +401,9 @@ class IRNotImplementedVisitor : public IRVisitor {
   void visitVecBroadCastLoad(VecBroadCastLoadHandle VecBroadCastLoad) override {
     throw_exception("VecBroadCastLoad");
   }
+  void visitVecGather(VecGatherHandle gather) override {
+    throw_exception("VecGather");
+  }
   void visitVecStore(VecStoreHandle VecStore) override {
     throw_exception("VecStore");
   }
@@ -313,6 +411,18 @@ class IRNotImplementedVisitor : public IRVisitor {
   void visitVecSub(VecSubHandle sub) override { throw_exception("VecSub"); }
   void visitVecMul(VecMulHandle mul) override { throw_exception("VecMul"); }
   void visitVecDiv(VecDivHandle div) override { throw_exception("VecDiv"); }
+  void visitVecFMA(VecFMAHandle fma) override { throw_exception("VecFMA"); }
+  void visitVecMin(VecMinHandle min) override { throw_exception("VecMin"); }
+  void visitVecMax(VecMaxHandle max) override { throw_exception("VecMax"); }
+  void visitVecCompare(VecCompareHandle compare) override {
+    throw_exception("VecCompare");
+  }
+  void visitVecBlend(VecBlendHandle blend) override {
+    throw_exception("VecBlend");
+  }
+  void visitVecReduce(VecReduceHandle reduce) override {
+    throw_exception("VecReduce");
+  }
 
  private:
   std::string errorMsg;
@@ -340,19 +450,28 @@ class IRPrinterVisitor : public IRNotImplementedVisitor {
   void visitConst(ConstHandle con) override;
   void visitPrint(PrintHandle print) override;
   void visitFunc(FuncHandle func) override;
+  void visitPrefetch(PrefetchHandle prefetch) override;
 
   void visitMin(MinHandle min) override;
   void visitMax(MaxHandle max) override;
+  void visitSelect(SelectHandle select) override;
 
   void visitVec(VecHandle vec) override;
   void visitVecScalar(VecScalarHandle vecScalar) override;
   void visitVecLoad(VecLoadHandle vecLoad) override;
   void visitVecBroadCastLoad(VecBroadCastLoadHandle VecBroadCastLoad) override;
+  void visitVecGather(VecGatherHandle gather) override;
   void visitVecStore(VecStoreHandle VecStore) override;
   void visitVecAdd(VecAddHandle add) override;
   void visitVecSub(VecSubHandle sub) override;
   void visitVecMul(VecMulHandle mul) override;
   void visitVecDiv(VecDivHandle div) override;
+  void visitVecFMA(VecFMAHandle fma) override;
+  void visitVecMin(VecMinHandle min) override;
+  void visitVecMax(VecMaxHandle max) override;
+  void visitVecCompare(VecCompareHandle compare) override;
+  void visitVecBlend(VecBlendHandle blend) override;
+  void visitVecReduce(VecReduceHandle reduce) override;
 
   void vec_case(int vecLen);
 };
@@ -391,6 +510,7 @@ class IRMutatorVisitor : public IRNotImplementedVisitor {
 
   void visitMin(MinHandle min) override;
   void visitMax(MaxHandle max) override;
+  void visitSelect(SelectHandle select) override;
 };
 
 }  // namespace polly
\ No newline at end of file
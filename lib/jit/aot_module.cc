@@ -0,0 +1,270 @@
+#include "aot_module.h"
+
+#include <unistd.h>
+
+namespace polly {
+
+const std::string AotModule::DefaultCompileFlags =
+    "--std=c++11 -O3 -mfma -pthread";
+const std::string AotModule::PortableCompileFlags =
+    "--std=c++11 -O3 -pthread";
+
+// The workspace holds the tensors of the MemoryPlan, which start on a cache
+// line of it.
+static const int WorkspaceAlignment = MemoryPlan::Alignment * sizeof(float);
+
+AotModule::AotModule(IRModule &module, std::string program_name,
+                     std::string compile_flags)
+    : module_(module),
+      program_name_(program_name),
+      compile_flags_(compile_flags) {
+  genKernel(program_name_ + "_kernel", "polly_parallel_launch");
+}
+
+AotModule::AotModule(IRModule &module, std::vector<KernelVariant> variants,
+                     std::string program_name, std::string compile_flags)
+    : module_(module),
+      program_name_(program_name),
+      compile_flags_(compile_flags),
+      variants_(variants) {
+  genKernel(program_name_ + "_kernel", "polly_parallel_launch");
+}
+
+void AotModule::PlanMemory(std::vector<IRNodeKey> external) {
+  external_ = std::set<IRNodeKey>(external.begin(), external.end());
+  auto ret = MemoryPlanner::runPass(MemoryPlanner::Arg::create(
+      module_.GetRoot(), module_.GetTensors(), external_));
+  memory_plan_ = PassRet::as<MemoryPlanner::Ret>(ret)->plan;
+  planned_ = true;
+}
+
+std::vector<IRNodeKey> AotModule::GetTensorOrder() const {
+  std::vector<IRNodeKey> order;
+  for (auto &tensor : const_cast<IRModule &>(module_).GetTensors()) {
+    auto id = tensor.as<TensorNode>()->id;
+    if (!planned_ || external_.count(id)) order.push_back(id);
+  }
+  return order;
+}
+
+std::vector<std::string> AotModule::GetConstantOrder() const {
+  return constant_order_;
+}
+
+std::string AotModule::genKernel(std::string kernel_name,
+                                 std::string launcher) {
+  CodeGenC codegen;
+  codegen.launcher_ = launcher;
+  const MemoryPlan *plan = planned_ ? &memory_plan_ : nullptr;
+  std::string code;
+  if (variants_.empty()) {
+    code = codegen.genCode(module_.GetRoot(), module_.GetTensors(),
+                           kernel_name, plan);
+  } else {
+    code = codegen.genDispatch(variants_, module_.GetTensors(), kernel_name,
+                               plan);
+  }
+  alignment_ = codegen.alignment_;
+  constant_order_ = codegen.constant_name;
+  return code;
+}
+
+static std::string ToUpper(std::string name) {
+  for (auto &c : name) c = toupper(c);
+  return name;
+}
+
+std::string AotModule::GenerateHeader() {
+  std::string guard = "POLLY_" + ToUpper(program_name_) + "_H_";
+  std::string macro = ToUpper(program_name_);
+  std::ostringstream oss;
+  oss << "/* Generated by Polly, do not edit. */\n";
+  oss << "#ifndef " << guard << "\n";
+  oss << "#define " << guard << "\n\n";
+  oss << "#include <stdint.h>\n\n";
+  oss << "#ifdef __cplusplus\n";
+  oss << "extern \"C\" {\n";
+  oss << "#endif\n\n";
+  oss << "#ifndef POLLY_THREAD_POOL_DEFINED\n";
+  oss << "#define POLLY_THREAD_POOL_DEFINED\n";
+  oss << "typedef void (*PollyParallelLambda)(int wid, int worker_size, "
+         "void *cdata);\n";
+  oss << "/* `launch` runs lambda(wid, worker_size, cdata) for every wid in\n"
+         "   [0, worker_size), and returns once all of them are done. */\n";
+  oss << "typedef struct PollyThreadPool {\n";
+  oss << "  void *context;\n";
+  oss << "  void (*launch)(void *context, PollyParallelLambda lambda, "
+         "void *cdata);\n";
+  oss << "} PollyThreadPool;\n";
+  oss << "#endif\n\n";
+  oss << "#ifndef POLLY_EXPORT\n";
+  oss << "#define POLLY_EXPORT\n";
+  oss << "#endif\n\n";
+  oss << "/* Alignment in bytes of every tensor buffer, 0 if none. */\n";
+  oss << "#define " << macro << "_ALIGNMENT " << alignment_ << "\n";
+  oss << "/* Size in bytes of the workspace, which is " << WorkspaceAlignment
+      << "-byte aligned. */\n";
+  oss << "#define " << macro << "_WORKSPACE_BYTES "
+      << memory_plan_.slab_size * sizeof(float) << "\n\n";
+
+  oss << "/*\n";
+  for (auto &tensor : module_.GetTensors()) {
+    auto node = tensor.as<TensorNode>();
+    if (planned_ && !external_.count(node->id)) continue;
+    oss << " * " << node->id << ": float";
+    for (auto dim : node->shape) oss << "[" << dim << "]";
+    oss << "\n";
+  }
+  oss << " * Returns 0, 1 if a buffer is misaligned, 2 if the workspace "
+         "cannot be\n * allocated.\n";
+  oss << " */\n";
+  oss << "POLLY_EXPORT int " << program_name_ << "(";
+  for (auto &id : GetTensorOrder()) oss << "float *" << id << ", ";
+  for (auto &name : constant_order_) oss << "int64_t " << name << ", ";
+  oss << "void *workspace, const PollyThreadPool *pool);\n\n";
+
+  oss << "#ifdef __cplusplus\n";
+  oss << "}\n";
+  oss << "#endif\n\n";
+  oss << "#endif  // " << guard << "\n";
+  return oss.str();
+}
+
+std::string AotModule::GenerateSource() {
+  std::string kernel_name = program_name_ + "_kernel";
+  std::string pool = program_name_ + "_pool";
+  std::string launcher = program_name_ + "_launch";
+  std::string kernel = genKernel(kernel_name, launcher);
+  std::string macro = ToUpper(program_name_);
+
+  std::ostringstream oss;
+  oss << "#define POLLY_EXPORT __attribute__((visibility(\"default\")))\n";
+  oss << GenerateHeader();
+  // Keep the symbols of several kernels linked into one binary apart.
+  oss << "#define polly_parallel_launch " << program_name_
+      << "_default_launch\n";
+  // Parallel loops are only launched by the calling thread.
+  oss << "static thread_local const PollyThreadPool *" << pool << ";\n";
+  oss << "static void " << launcher
+      << "(PollyParallelLambda lambda, void *cdata);\n";
+  oss << kernel;
+  if (kernel.find(CodeGenC::C_Runtime_Deps) != std::string::npos) {
+    oss << "static void " << launcher
+        << "(PollyParallelLambda lambda, void *cdata) {\n";
+    oss << "  if (" << pool << " != NULL) {\n";
+    oss << "    " << pool << "->launch(" << pool
+        << "->context, lambda, cdata);\n";
+    oss << "  } else {\n";
+    oss << "    polly_parallel_launch(lambda, cdata);\n";
+    oss << "  }\n";
+    oss << "}\n";
+  }
+
+  oss << "extern \"C\" int " << program_name_ << "(";
+  for (auto &id : GetTensorOrder()) oss << "float *" << id << ", ";
+  for (auto &name : constant_order_) oss << "int64_t " << name << ", ";
+  oss << "void *workspace, const PollyThreadPool *pool) {\n";
+  for (auto &id : GetTensorOrder()) {
+    oss << "  if (" << macro << "_ALIGNMENT > 0 && (uintptr_t)" << id << " % "
+        << macro << "_ALIGNMENT != 0) return 1;\n";
+  }
+  oss << "  float *slab = (float *)workspace;\n";
+  oss << "  void *owned = NULL;\n";
+  oss << "  if (slab == NULL && " << macro << "_WORKSPACE_BYTES > 0) {\n";
+  oss << "    if (posix_memalign(&owned, " << WorkspaceAlignment << ", "
+      << macro << "_WORKSPACE_BYTES) != 0) return 2;\n";
+  oss << "    slab = (float *)owned;\n";
+  oss << "  }\n";
+  oss << "  if ((uintptr_t)slab % " << WorkspaceAlignment
+      << " != 0) return 1;\n";
+  // Calls may nest, e.g. from a pool worker of an enclosing call.
+  oss << "  const PollyThreadPool *site = " << pool << ";\n";
+  oss << "  " << pool << " = pool;\n";
+  oss << "  " << kernel_name << "(";
+  bool first = true;
+  for (auto &tensor : module_.GetTensors()) {
+    auto node = tensor.as<TensorNode>();
+    std::string arg;
+    if (!planned_ || external_.count(node->id)) {
+      arg = node->id;
+    } else if (auto allocation = memory_plan_.Find(node->id)) {
+      arg = "(slab + " + std::to_string(allocation->offset) + ")";
+    }
+    if (!first) oss << ", ";
+    // Tensors neither passed nor planned are not accessed.
+    oss << (arg.empty() ? "NULL" : arg);
+    first = false;
+  }
+  for (auto &name : constant_order_) {
+    if (!first) oss << ", ";
+    oss << name;
+    first = false;
+  }
+  oss << ");\n";
+  oss << "  " << pool << " = site;\n";
+  oss << "  free(owned);\n";
+  oss << "  return 0;\n";
+  oss << "}\n";
+  return oss.str();
+}
+
+void AotModule::compile(std::string directory, std::string flags,
+                        std::string output) {
+  std::string source = directory + "/" + program_name_ + ".cc";
+  std::ofstream f;
+  f.open(source);
+  f << GenerateSource();
+  f.close();
+
+  int status;
+  std::string log = executeCommands("g++ " + compile_flags_ + " " + flags +
+                                        " -fPIC -fvisibility=hidden -o " +
+                                        output + " " + source + " 2>&1",
+                                    status);
+  unlink(source.c_str());
+  if (status != 0) {
+    throw std::runtime_error("AotModule: failed to compile " + program_name_ +
+                             ":\n" + log);
+  }
+
+  std::ofstream header;
+  header.open(directory + "/" + program_name_ + ".h");
+  header << GenerateHeader();
+  header.close();
+}
+
+std::string AotModule::ExportSharedLibrary(std::string directory) {
+  std::string library = directory + "/lib" + program_name_ + ".so";
+  compile(directory, "-shared", library);
+  return library;
+}
+
+std::string AotModule::ExportStaticLibrary(std::string directory) {
+  std::string object = directory + "/" + program_name_ + ".o";
+  std::string library = directory + "/lib" + program_name_ + ".a";
+  compile(directory, "-c", object);
+  int status;
+  unlink(library.c_str());
+  std::string log =
+      executeCommands("ar rcs " + library + " " + object + " 2>&1", status);
+  unlink(object.c_str());
+  if (status != 0) {
+    throw std::runtime_error("AotModule: failed to archive " + library +
+                             ":\n" + log);
+  }
+  return library;
+}
+
+std::string AotModule::executeCommands(std::string cmd, int &status) {
+  char buffer[128];
+  std::string result = "";
+  FILE *pipe = popen(cmd.c_str(), "r");
+  if (!pipe) throw std::runtime_error("popen() failed!");
+  while (fgets(buffer, sizeof buffer, pipe) != NULL) {
+    result += buffer;
+  }
+  status = pclose(pipe);
+  return result;
+}
+
+}  // namespace polly
@@ -0,0 +1,98 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-03-02 15:20:41
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-03-02 15:20:41
+ * @CopyRight: Qiming Zheng
+ */
+#pragma once
+
+#include "common.h"
+#include "ir/ir.h"
+#include "ir/ir_module.h"
+#include "codegen/codegen.h"
+#include "pass/analysis/memory_planner.h"
+
+namespace polly {
+
+/*!
+ * \brief AotModule exports the CodeGenC output of a (tuned) program as a
+ * shared or static library together with a C header, so that services link
+ * the kernel instead of compiling it when they start.
+ *
+ * The library exports a single function, with a C ABI that does not depend on
+ * Polly:
+ *
+ *   int name(float *t0, ..., int64_t c0, ..., void *workspace,
+ *            const PollyThreadPool *pool);
+ *
+ * taking one flat row-major buffer per parameter tensor (see
+ * `GetTensorOrder()`), then the constants (see `GetConstantOrder()`), then
+ * - `workspace`: NAME_WORKSPACE_BYTES of scratch memory holding the tensors
+ *   packed by `PlanMemory`, reused across calls. NULL allocates it per call.
+ * - `pool`: the thread pool running the parallel loops. NULL spawns threads
+ *   for each call.
+ * Buffers and workspace must be NAME_ALIGNMENT-byte aligned. It returns 0, 1
+ * if a buffer is misaligned, or 2 if the workspace cannot be allocated.
+ *
+ * \param module The program to be exported.
+ * \param program_name Name of the exported function, library and header.
+ * \param compile_flags Flags passed to the host compiler.
+ */
+class AotModule : public Uncopyable {
+ public:
+  /// The flags of NativeModule, for the host the program was tuned on.
+  static const std::string DefaultCompileFlags;
+  /// For multiversioned libraries, which run on any x86-64 CPU.
+  static const std::string PortableCompileFlags;
+
+  AotModule(IRModule &module, std::string program_name = "kernel",
+            std::string compile_flags = DefaultCompileFlags);
+  /// The `variants` are scheduled from `module`, which gives the tensors, see
+  /// CodeGenC::genDispatch.
+  AotModule(IRModule &module, std::vector<KernelVariant> variants,
+            std::string program_name = "kernel",
+            std::string compile_flags = PortableCompileFlags);
+
+  /// Keep every tensor but the ones in `external` in the workspace (see
+  /// MemoryPlanner), they are no parameters of the exported function then.
+  /// The stages of the variants must be the ones of the module.
+  void PlanMemory(std::vector<IRNodeKey> external);
+  const MemoryPlan &GetMemoryPlan() const { return memory_plan_; }
+
+  /// Tensor ids, in the order of their parameters.
+  std::vector<IRNodeKey> GetTensorOrder() const;
+  /// Constant names, in the order of their parameters.
+  std::vector<std::string> GetConstantOrder() const;
+
+  std::string GenerateHeader();
+  /// The header, the kernel and the exported function.
+  std::string GenerateSource();
+
+  /// Write `name.h` and `libname.so` into `directory`, returns the path of
+  /// the library.
+  std::string ExportSharedLibrary(std::string directory);
+  /// Write `name.h` and `libname.a` into `directory`, returns the path of the
+  /// library. Executables linking it need `-lstdc++ -pthread`.
+  std::string ExportStaticLibrary(std::string directory);
+
+ private:
+  /// The C code of the kernel, which sets the alignment and the constants.
+  std::string genKernel(std::string kernel_name, std::string launcher);
+  /// Compile the source with `flags` into `output` in `directory`.
+  void compile(std::string directory, std::string flags, std::string output);
+  std::string executeCommands(std::string cmd, int &status);
+
+  IRModule module_;
+  std::string program_name_;
+  std::string compile_flags_;
+  std::vector<KernelVariant> variants_;
+  bool planned_ = false;
+  std::set<IRNodeKey> external_;
+  MemoryPlan memory_plan_;
+  std::vector<std::string> constant_order_;
+  int alignment_ = 0;
+};
+
+}  // namespace polly
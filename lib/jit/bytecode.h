@@ -0,0 +1,210 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-07 14:10:21
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-07 14:10:21
+ * @CopyRight: Qiming Zheng
+ */
+#pragma once
+
+#include "common.h"
+#include "ir/ir.h"
+
+namespace polly {
+
+/// Register slot index inside a BytecodeFrame.
+typedef int32_t RegSlot;
+
+/*!
+ * \brief Opcodes of the JIT register machine. Registers are statically typed:
+ * `I*` opcodes read/write the integer register file, `F*` opcodes the float
+ * register file. The operand layout of every opcode is documented inline as
+ * (dst, src0, src1, src2).
+ */
+enum class Opcode : uint8_t {
+  // Integer arithmetic: i[dst] = i[src0] op i[src1]
+  IADD,
+  ISUB,
+  IMUL,
+  IDIV,
+  IMOD,
+  IMIN,
+  IMAX,
+  // i[dst] = i[src0] * i[src1] + i[src2], used for row-major offsets.
+  IMAD,
+  IMOV,
+
+  // Float arithmetic: f[dst] = f[src0] op f[src1]
+  FADD,
+  FSUB,
+  FMUL,
+  FDIV,
+  FMIN,
+  FMAX,
+  FMOV,
+  // f[dst] = (float)i[src0]
+  I2F,
+
+  // i[dst] = i[src0] op i[src1] / f[src0] op f[src1], with the CompareOp `op`
+  // stored in src2.
+  ICMP,
+  FCMP,
+  // i[dst] = i[src0] ? i[src1] : i[src2]
+  ISELECT,
+  // f[dst] = i[src0] ? f[src1] : f[src2]
+  FSELECT,
+
+  // f[dst] = tensor[src0][i[src1]]
+  FLOAD,
+  // tensor[src0][i[src1]] = f[src2]
+  FSTORE,
+  // tensor[src0][0 .. size) = 0
+  TZERO,
+  // Fetch the cache line of tensor[src0][i[src1]], which may be out of range.
+  PREFETCH,
+
+  // pc = dst
+  JUMP,
+  // if (i[src0] >= i[src1]) pc = dst
+  JGE,
+  // if (i[src0] < i[src1]) pc = dst
+  JLT,
+
+  // SIMD opcodes operate on the vector register file; the suffix is the
+  // vector length. Vector registers hold 16 lanes, narrower opcodes only use
+  // the lower lanes.
+  // v[dst] = broadcast(f[src0])
+  VSPLAT4,
+  VSPLAT8,
+  VSPLAT16,
+  // v[dst] = tensor[src0][i[src1] .. i[src1] + len)
+  VLOAD4,
+  VLOAD8,
+  VLOAD16,
+  // v[dst] = broadcast(tensor[src0][i[src1]])
+  VBCAST4,
+  VBCAST8,
+  VBCAST16,
+  // v[dst][l] = tensor[src0][i[src1] + l * i[src2]]
+  VGATHER4,
+  VGATHER8,
+  VGATHER16,
+  // tensor[src0][i[src1] .. i[src1] + len) = v[src2]
+  VSTORE4,
+  VSTORE8,
+  VSTORE16,
+  // v[dst] = v[src0] op v[src1]
+  VADD4,
+  VADD8,
+  VADD16,
+  VSUB4,
+  VSUB8,
+  VSUB16,
+  VMUL4,
+  VMUL8,
+  VMUL16,
+  VDIV4,
+  VDIV8,
+  VDIV16,
+  // v[dst] = v[src0] * v[src1] + v[src2]
+  VFMA4,
+  VFMA8,
+  VFMA16,
+  // v[dst] = min/max(v[src0], v[src1])
+  VMIN4,
+  VMIN8,
+  VMIN16,
+  VMAX4,
+  VMAX8,
+  VMAX16,
+  // v[dst] = v[src0] op v[src1], every bit of a lane set where it holds; the
+  // CompareOp `op` is stored in src2.
+  VCMP4,
+  VCMP8,
+  VCMP16,
+  // v[dst] = v[src0] ? v[src1] : v[src2] per lane, v[src0] is a VCMP mask.
+  VBLEND4,
+  VBLEND8,
+  VBLEND16,
+  // f[dst] = f[src0] op v[src1][0] op ... op v[src1][len - 1], with the
+  // ReduceOp `op` stored in src2.
+  VREDUCE4,
+  VREDUCE8,
+  VREDUCE16,
+
+  // Run the parallel region `dst` (see ParallelRegion), then continue after
+  // its body.
+  PFOR,
+
+  // print i[src0] / f[src0]
+  PRINTI,
+  PRINTF,
+
+  HALT,
+};
+
+/// Number of float lanes of one vector register.
+constexpr int VecRegLanes = 16;
+
+struct Instruction {
+  Opcode op;
+  RegSlot dst, src0, src1, src2;
+};
+
+/*!
+ * \brief Tensor metadata resolved at lowering time. The storage itself is
+ * owned by the JitModule and handed to the VM as a flat pointer table indexed
+ * by `slot`.
+ */
+struct TensorSlot {
+  IRNodeKey id;
+  std::vector<int64_t> shape;
+  size_t size;
+};
+
+/*!
+ * \brief A loop whose iterations may run concurrently. The body occupies the
+ * instructions [body_begin, body_end); each worker runs it upon a private
+ * copy of the frame, with `var` set to the iteration being executed. The
+ * iterations are shared as the `schedule` and `chunk` of the loop annotation
+ * say; collapsed loops are only honoured by the C backend.
+ */
+struct ParallelRegion {
+  RegSlot var, min, max, increment;
+  size_t body_begin, body_end;
+  LoopAnnotation::Schedule schedule;
+  int chunk;
+};
+
+/*!
+ * \brief A lowered program: a flat instruction stream plus the initial image
+ * of both register files (constants are pre-loaded into their own slots so
+ * the dispatch loop never decodes immediates).
+ */
+struct BytecodeProgram {
+  std::vector<Instruction> code;
+  std::vector<int64_t> int_regs;
+  std::vector<float> float_regs;
+  int vec_regs = 0;
+  std::vector<TensorSlot> tensors;
+  std::vector<ParallelRegion> parallel_regions;
+  std::map<IRNodeKey, int> tensor_slots;
+  /// Int registers holding the program constants, to be set before a run.
+  std::map<std::string, RegSlot> constant_slots;
+};
+
+/// The mutable state of one executing VM context.
+struct BytecodeFrame {
+  BytecodeFrame() {}
+  explicit BytecodeFrame(const BytecodeProgram &program)
+      : int_regs(program.int_regs),
+        float_regs(program.float_regs),
+        vec_regs(program.vec_regs * VecRegLanes) {}
+
+  std::vector<int64_t> int_regs;
+  std::vector<float> float_regs;
+  std::vector<float> vec_regs;
+};
+
+}  // namespace polly
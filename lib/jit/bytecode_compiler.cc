@@ -0,0 +1,510 @@
+#include "bytecode_compiler.h"
+
+#include <cstring>
+
+namespace polly {
+
+BytecodeProgram BytecodeCompiler::Compile(IRModule &module,
+                                          const MemoryPlan *plan) {
+  BytecodeCompiler compiler;
+  compiler.plan_ = plan;
+  // Tensors declared by the program get their slots first, in declaration
+  // order, even if they are never referenced by a statement.
+  for (auto &tensor : module.GetTensors()) {
+    compiler.tensorSlot(tensor.as<TensorNode>());
+  }
+  for (auto &constant : module.GetConstants()) {
+    compiler.constantSlot(constant.as<ConstNode>()->name);
+  }
+  if (module.GetRoot() != NullIRHandle) {
+    compiler.visit(module.GetRoot());
+  }
+  compiler.emit(Opcode::HALT, -1);
+  return std::move(compiler.program_);
+}
+
+RegSlot BytecodeCompiler::newIntReg(int64_t init) {
+  program_.int_regs.push_back(init);
+  return program_.int_regs.size() - 1;
+}
+
+RegSlot BytecodeCompiler::newFloatReg(float init) {
+  program_.float_regs.push_back(init);
+  return program_.float_regs.size() - 1;
+}
+
+RegSlot BytecodeCompiler::intConst(int64_t x) {
+  auto it = int_consts_.find(x);
+  if (it != int_consts_.end()) return it->second;
+  return int_consts_[x] = newIntReg(x);
+}
+
+RegSlot BytecodeCompiler::floatConst(float x) {
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  auto it = float_consts_.find(bits);
+  if (it != float_consts_.end()) return it->second;
+  return float_consts_[bits] = newFloatReg(x);
+}
+
+int BytecodeCompiler::tensorSlot(TensorHandle tensor) {
+  auto it = program_.tensor_slots.find(tensor->id);
+  if (it != program_.tensor_slots.end()) return it->second;
+  TensorSlot slot;
+  slot.id = tensor->id;
+  slot.shape = tensor->shape;
+  slot.size = 1;
+  for (auto dim : tensor->shape) slot.size *= dim;
+  program_.tensors.push_back(slot);
+  return program_.tensor_slots[tensor->id] = program_.tensors.size() - 1;
+}
+
+RegSlot BytecodeCompiler::constantSlot(const std::string &name) {
+  auto it = program_.constant_slots.find(name);
+  if (it != program_.constant_slots.end()) return it->second;
+  return program_.constant_slots[name] = newIntReg();
+}
+
+size_t BytecodeCompiler::emit(Opcode op, RegSlot dst, RegSlot src0,
+                              RegSlot src1, RegSlot src2) {
+  program_.code.push_back(Instruction{op, dst, src0, src1, src2});
+  return program_.code.size() - 1;
+}
+
+RegSlot BytecodeCompiler::evalFloat(IRHandle expr) {
+  expr.accept(this);
+  if (type_ == value_type::FLOAT) return reg_;
+  RegSlot ret = newFloatReg();
+  emit(Opcode::I2F, ret, reg_);
+  return ret;
+}
+
+RegSlot BytecodeCompiler::evalInt(IRHandle expr) {
+  expr.accept(this);
+  if (type_ != value_type::INT) {
+    throw std::runtime_error(
+        "Jitter compile error: expect an integer expression");
+  }
+  return reg_;
+}
+
+RegSlot BytecodeCompiler::evalOffset(AccessHandle access) {
+  auto tensor = access->tensor.as<TensorNode>();
+  if (access->indices.size() != tensor->shape.size()) {
+    throw std::runtime_error(
+        "Jitter compile error: access rank mismatches the tensor rank");
+  }
+  RegSlot offset = -1;
+  for (int i = 0; i < access->indices.size(); i++) {
+    access->indices[i].accept(this);
+    if (type_ != value_type::INT) {
+      throw std::runtime_error("cannot access a tensor with float indices");
+    }
+    if (offset == -1) {
+      offset = reg_;
+    } else {
+      RegSlot next = newIntReg();
+      emit(Opcode::IMAD, next, offset, intConst(tensor->shape[i]), reg_);
+      offset = next;
+    }
+  }
+  if (offset == -1) offset = intConst(0);
+  return offset;
+}
+
+void BytecodeCompiler::binary(IRHandle lhs, IRHandle rhs, Opcode int_op,
+                              Opcode float_op) {
+  lhs.accept(this);
+  RegSlot lhs_reg = reg_;
+  value_type lhs_type = type_;
+  rhs.accept(this);
+  RegSlot rhs_reg = reg_;
+  value_type rhs_type = type_;
+  if (lhs_type == value_type::INT && rhs_type == value_type::INT) {
+    reg_ = newIntReg();
+    emit(int_op, reg_, lhs_reg, rhs_reg);
+    type_ = value_type::INT;
+    return;
+  }
+  // Mixed int/float operands are promoted to float, as C does.
+  lhs_reg = asFloat(lhs_reg, lhs_type);
+  rhs_reg = asFloat(rhs_reg, rhs_type);
+  reg_ = newFloatReg();
+  emit(float_op, reg_, lhs_reg, rhs_reg);
+  type_ = value_type::FLOAT;
+}
+
+RegSlot BytecodeCompiler::asFloat(RegSlot reg, value_type type) {
+  if (type == value_type::FLOAT) return reg;
+  RegSlot ret = newFloatReg();
+  emit(Opcode::I2F, ret, reg);
+  return ret;
+}
+
+void BytecodeCompiler::visitInt(IntHandle int_expr) {
+  reg_ = intConst(int_expr->value);
+  type_ = value_type::INT;
+}
+
+void BytecodeCompiler::visitFloat(FloatHandle float_expr) {
+  reg_ = floatConst(float_expr->value);
+  type_ = value_type::FLOAT;
+}
+
+void BytecodeCompiler::visitAdd(AddHandle add) {
+  binary(add->lhs, add->rhs, Opcode::IADD, Opcode::FADD);
+}
+
+void BytecodeCompiler::visitSub(SubHandle sub) {
+  binary(sub->lhs, sub->rhs, Opcode::ISUB, Opcode::FSUB);
+}
+
+void BytecodeCompiler::visitMul(MulHandle mul) {
+  binary(mul->lhs, mul->rhs, Opcode::IMUL, Opcode::FMUL);
+}
+
+void BytecodeCompiler::visitDiv(DivHandle div) {
+  binary(div->lhs, div->rhs, Opcode::IDIV, Opcode::FDIV);
+}
+
+void BytecodeCompiler::visitMod(ModHandle mod) {
+  RegSlot lhs = evalInt(mod->lhs);
+  RegSlot rhs = evalInt(mod->rhs);
+  reg_ = newIntReg();
+  emit(Opcode::IMOD, reg_, lhs, rhs);
+  type_ = value_type::INT;
+}
+
+void BytecodeCompiler::visitVar(VarHandle var) {
+  auto it = vars_.find(var->id);
+  if (it == vars_.end()) {
+    throw std::runtime_error("Jitter compile error: looping var " + var->id +
+                             " is used outside of its loop");
+  }
+  reg_ = it->second;
+  type_ = value_type::INT;
+}
+
+void BytecodeCompiler::visitAccess(AccessHandle access) {
+  int slot = tensorSlot(access->tensor.as<TensorNode>());
+  RegSlot offset = evalOffset(access);
+  reg_ = newFloatReg();
+  emit(Opcode::FLOAD, reg_, slot, offset);
+  type_ = value_type::FLOAT;
+}
+
+void BytecodeCompiler::visitAssign(AssignmentHandle assign) {
+  store(assign->lhs, evalFloat(assign->rhs));
+}
+
+void BytecodeCompiler::store(IRHandle lhs, RegSlot value) {
+  switch (lhs.Type()) {
+    case IRNodeType::ACCESS: {
+      auto access = lhs.as<AccessNode>();
+      int slot = tensorSlot(access->tensor.as<TensorNode>());
+      RegSlot offset = evalOffset(access);
+      emit(Opcode::FSTORE, -1, slot, offset, value);
+      break;
+    }
+    case IRNodeType::VALUE: {
+      lhs.accept(this);
+      emit(Opcode::FMOV, reg_, value);
+      break;
+    }
+    default:
+      throw std::runtime_error(
+          "Jitter compile error: can only assign to a tensor or a value");
+  }
+}
+
+void BytecodeCompiler::visitTensor(TensorHandle tensor) {
+  throw std::runtime_error(
+      "Jitter compile error: a tensor can only be used through an access");
+}
+
+void BytecodeCompiler::visitVal(ValHandle val) {
+  auto it = vals_.find(val->id);
+  if (it == vals_.end()) {
+    vals_[val->id] = newFloatReg();
+    it = vals_.find(val->id);
+  }
+  reg_ = it->second;
+  type_ = value_type::FLOAT;
+}
+
+void BytecodeCompiler::visitDecl(DeclHandle decl) { decl->decl.accept(this); }
+
+void BytecodeCompiler::visitFor(ForHandle loop) {
+  VarHandle looping_var = loop->looping_var_.as<VarNode>();
+
+  // The bounds are evaluated in the enclosing scope.
+  RegSlot min = evalInt(looping_var->min);
+  RegSlot max = evalInt(looping_var->max);
+  RegSlot increment = evalInt(looping_var->increment);
+
+  RegSlot var = newIntReg();
+  vars_[looping_var->id] = var;
+
+  if (loop->annotation.parallelization && !in_parallel_region_) {
+    ParallelRegion region;
+    region.var = var;
+    region.min = min;
+    region.max = max;
+    region.increment = increment;
+    region.schedule = loop->annotation.schedule;
+    region.chunk = loop->annotation.chunk;
+    emit(Opcode::PFOR, program_.parallel_regions.size());
+    region.body_begin = program_.code.size();
+    in_parallel_region_ = true;
+    for (int i = 0; i < loop->body.size(); i++) {
+      loop->body[i].accept(this);
+    }
+    in_parallel_region_ = false;
+    region.body_end = program_.code.size();
+    program_.parallel_regions.push_back(region);
+    vars_.erase(looping_var->id);
+    return;
+  }
+
+  emit(Opcode::IMOV, var, min);
+  size_t skip = emit(Opcode::JGE, -1, var, max);
+
+  size_t body_begin = program_.code.size();
+  for (int i = 0; i < loop->body.size(); i++) {
+    loop->body[i].accept(this);
+  }
+  emit(Opcode::IADD, var, var, increment);
+  emit(Opcode::JLT, body_begin, var, max);
+  program_.code[skip].dst = program_.code.size();
+
+  // when leave the for-loop scope, erase its var;
+  vars_.erase(looping_var->id);
+}
+
+void BytecodeCompiler::visitConst(ConstHandle con) {
+  reg_ = constantSlot(con->name);
+  type_ = value_type::INT;
+}
+
+void BytecodeCompiler::visitPrint(PrintHandle print) {
+  print->print.accept(this);
+  emit(type_ == value_type::INT ? Opcode::PRINTI : Opcode::PRINTF, -1, reg_);
+}
+
+void BytecodeCompiler::visitPrefetch(PrefetchHandle prefetch) {
+  auto access = prefetch->data.as<AccessNode>();
+  int slot = tensorSlot(access->tensor.as<TensorNode>());
+  emit(Opcode::PREFETCH, -1, slot, evalOffset(access));
+}
+
+void BytecodeCompiler::visitFunc(FuncHandle func) {
+  for (int i = 0; i < func->body.size(); i++) {
+    if (plan_ != nullptr) {
+      for (auto &allocation : plan_->allocations) {
+        if (allocation.first_stage != i) continue;
+        emit(Opcode::TZERO, -1, program_.tensor_slots.at(allocation.tensor));
+      }
+    }
+    func->body[i].accept(this);
+  }
+}
+
+void BytecodeCompiler::visitMin(MinHandle min) {
+  binary(min->lhs, min->rhs, Opcode::IMIN, Opcode::FMIN);
+}
+
+void BytecodeCompiler::visitMax(MaxHandle max) {
+  binary(max->lhs, max->rhs, Opcode::IMAX, Opcode::FMAX);
+}
+
+void BytecodeCompiler::visitSelect(SelectHandle select) {
+  select->lhs.accept(this);
+  RegSlot lhs_reg = reg_;
+  value_type lhs_type = type_;
+  select->rhs.accept(this);
+  RegSlot rhs_reg = reg_;
+  value_type rhs_type = type_;
+  RegSlot cond = newIntReg();
+  RegSlot op = static_cast<RegSlot>(select->op);
+  if (lhs_type == value_type::INT && rhs_type == value_type::INT) {
+    emit(Opcode::ICMP, cond, lhs_reg, rhs_reg, op);
+  } else {
+    lhs_reg = asFloat(lhs_reg, lhs_type);
+    rhs_reg = asFloat(rhs_reg, rhs_type);
+    emit(Opcode::FCMP, cond, lhs_reg, rhs_reg, op);
+  }
+
+  select->true_value.accept(this);
+  RegSlot true_reg = reg_;
+  value_type true_type = type_;
+  select->false_value.accept(this);
+  RegSlot false_reg = reg_;
+  value_type false_type = type_;
+  if (true_type == value_type::INT && false_type == value_type::INT) {
+    reg_ = newIntReg();
+    emit(Opcode::ISELECT, reg_, cond, true_reg, false_reg);
+    type_ = value_type::INT;
+    return;
+  }
+  true_reg = asFloat(true_reg, true_type);
+  false_reg = asFloat(false_reg, false_type);
+  reg_ = newFloatReg();
+  emit(Opcode::FSELECT, reg_, cond, true_reg, false_reg);
+  type_ = value_type::FLOAT;
+}
+
+RegSlot BytecodeCompiler::evalVec(IRHandle expr) {
+  expr.accept(this);
+  if (type_ != value_type::VEC) {
+    throw std::runtime_error("Jitter compile error: expect a vector");
+  }
+  return reg_;
+}
+
+Opcode BytecodeCompiler::vecOp(int vecLen, Opcode op4, Opcode op8,
+                               Opcode op16) {
+  if (vecLen == 4) return op4;
+  if (vecLen == 8) return op8;
+  if (vecLen == 16) return op16;
+  throw std::runtime_error("Unsupported VecLen");
+}
+
+void BytecodeCompiler::vecBinary(IRHandle vec, IRHandle lhs, IRHandle rhs,
+                                 int vecLen, Opcode op4, Opcode op8,
+                                 Opcode op16) {
+  RegSlot lhs_reg = evalVec(lhs);
+  RegSlot rhs_reg = evalVec(rhs);
+  emit(vecOp(vecLen, op4, op8, op16), evalVec(vec), lhs_reg, rhs_reg);
+}
+
+void BytecodeCompiler::vecMemory(IRHandle vec, IRHandle data, int vecLen,
+                                 Opcode op4, Opcode op8, Opcode op16,
+                                 bool store) {
+  if (data.Type() != IRNodeType::ACCESS) {
+    throw std::runtime_error(
+        "Jitter compile error: vector memory operand must be an access");
+  }
+  auto access = data.as<AccessNode>();
+  int slot = tensorSlot(access->tensor.as<TensorNode>());
+  RegSlot offset = evalOffset(access);
+  RegSlot vec_reg = evalVec(vec);
+  if (store) {
+    emit(vecOp(vecLen, op4, op8, op16), -1, slot, offset, vec_reg);
+  } else {
+    emit(vecOp(vecLen, op4, op8, op16), vec_reg, slot, offset);
+  }
+}
+
+void BytecodeCompiler::visitVec(VecHandle vec) {
+  auto it = vecs_.find(vec->id);
+  if (it == vecs_.end()) {
+    vecs_[vec->id] = program_.vec_regs++;
+    it = vecs_.find(vec->id);
+  }
+  reg_ = it->second;
+  type_ = value_type::VEC;
+}
+
+void BytecodeCompiler::visitVecScalar(VecScalarHandle vecScalar) {
+  RegSlot scalar = evalFloat(vecScalar->scalar);
+  emit(vecOp(vecScalar->length, Opcode::VSPLAT4, Opcode::VSPLAT8,
+             Opcode::VSPLAT16),
+       evalVec(vecScalar->vec), scalar);
+}
+
+void BytecodeCompiler::visitVecLoad(VecLoadHandle vecLoad) {
+  vecMemory(vecLoad->vec, vecLoad->data, vecLoad->length, Opcode::VLOAD4,
+            Opcode::VLOAD8, Opcode::VLOAD16, false);
+}
+
+void BytecodeCompiler::visitVecBroadCastLoad(
+    VecBroadCastLoadHandle vecBroadCastLoad) {
+  vecMemory(vecBroadCastLoad->vec, vecBroadCastLoad->data,
+            vecBroadCastLoad->length, Opcode::VBCAST4, Opcode::VBCAST8,
+            Opcode::VBCAST16, false);
+}
+
+void BytecodeCompiler::visitVecGather(VecGatherHandle gather) {
+  if (gather->data.Type() != IRNodeType::ACCESS) {
+    throw std::runtime_error(
+        "Jitter compile error: vector memory operand must be an access");
+  }
+  auto access = gather->data.as<AccessNode>();
+  int slot = tensorSlot(access->tensor.as<TensorNode>());
+  RegSlot offset = evalOffset(access);
+  emit(vecOp(gather->length, Opcode::VGATHER4, Opcode::VGATHER8,
+             Opcode::VGATHER16),
+       evalVec(gather->vec), slot, offset, intConst(gather->stride));
+}
+
+void BytecodeCompiler::visitVecStore(VecStoreHandle vecStore) {
+  vecMemory(vecStore->vec, vecStore->data, vecStore->length, Opcode::VSTORE4,
+            Opcode::VSTORE8, Opcode::VSTORE16, true);
+}
+
+void BytecodeCompiler::visitVecAdd(VecAddHandle add) {
+  vecBinary(add->vec, add->lhs, add->rhs, add->length, Opcode::VADD4,
+            Opcode::VADD8, Opcode::VADD16);
+}
+
+void BytecodeCompiler::visitVecSub(VecSubHandle sub) {
+  vecBinary(sub->vec, sub->lhs, sub->rhs, sub->length, Opcode::VSUB4,
+            Opcode::VSUB8, Opcode::VSUB16);
+}
+
+void BytecodeCompiler::visitVecMul(VecMulHandle mul) {
+  vecBinary(mul->vec, mul->lhs, mul->rhs, mul->length, Opcode::VMUL4,
+            Opcode::VMUL8, Opcode::VMUL16);
+}
+
+void BytecodeCompiler::visitVecDiv(VecDivHandle div) {
+  vecBinary(div->vec, div->lhs, div->rhs, div->length, Opcode::VDIV4,
+            Opcode::VDIV8, Opcode::VDIV16);
+}
+
+void BytecodeCompiler::visitVecFMA(VecFMAHandle fma) {
+  RegSlot a_reg = evalVec(fma->a);
+  RegSlot b_reg = evalVec(fma->b);
+  RegSlot c_reg = evalVec(fma->c);
+  emit(vecOp(fma->length, Opcode::VFMA4, Opcode::VFMA8, Opcode::VFMA16),
+       evalVec(fma->vec), a_reg, b_reg, c_reg);
+}
+
+void BytecodeCompiler::visitVecMin(VecMinHandle min) {
+  vecBinary(min->vec, min->lhs, min->rhs, min->length, Opcode::VMIN4,
+            Opcode::VMIN8, Opcode::VMIN16);
+}
+
+void BytecodeCompiler::visitVecMax(VecMaxHandle max) {
+  vecBinary(max->vec, max->lhs, max->rhs, max->length, Opcode::VMAX4,
+            Opcode::VMAX8, Opcode::VMAX16);
+}
+
+void BytecodeCompiler::visitVecCompare(VecCompareHandle compare) {
+  RegSlot lhs_reg = evalVec(compare->lhs);
+  RegSlot rhs_reg = evalVec(compare->rhs);
+  emit(vecOp(compare->length, Opcode::VCMP4, Opcode::VCMP8, Opcode::VCMP16),
+       evalVec(compare->vec), lhs_reg, rhs_reg,
+       static_cast<RegSlot>(compare->op));
+}
+
+void BytecodeCompiler::visitVecBlend(VecBlendHandle blend) {
+  RegSlot mask_reg = evalVec(blend->mask);
+  RegSlot true_reg = evalVec(blend->true_value);
+  RegSlot false_reg = evalVec(blend->false_value);
+  emit(vecOp(blend->length, Opcode::VBLEND4, Opcode::VBLEND8,
+             Opcode::VBLEND16),
+       evalVec(blend->vec), mask_reg, true_reg, false_reg);
+}
+
+void BytecodeCompiler::visitVecReduce(VecReduceHandle reduce) {
+  RegSlot vec_reg = evalVec(reduce->vec);
+  RegSlot value = evalFloat(reduce->data);
+  RegSlot res = newFloatReg();
+  emit(vecOp(reduce->length, Opcode::VREDUCE4, Opcode::VREDUCE8,
+             Opcode::VREDUCE16),
+       res, value, vec_reg, static_cast<RegSlot>(reduce->op));
+  store(reduce->data, res);
+}
+
+}  // namespace polly
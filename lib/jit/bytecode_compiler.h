@@ -0,0 +1,140 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-07 14:25:02
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-07 14:25:02
+ * @CopyRight: Qiming Zheng
+ */
+#pragma once
+
+#include "common.h"
+#include "ir/ir.h"
+#include "ir/ir_visitor.h"
+#include "ir/ir_module.h"
+#include "bytecode.h"
+#include "pass/analysis/memory_planner.h"
+
+namespace polly {
+
+/*!
+ * \brief BytecodeCompiler lowers an IRModule into a BytecodeProgram. Every
+ * symbol (looping var, value, tensor, constant) is resolved to a fixed slot
+ * once, so execution never touches the IR or a symbol table again.
+ *
+ * Loop bounds and increments are evaluated once before entering a loop, which
+ * is valid since the body of a loop can never write its own bounds.
+ *
+ * Constants are int registers left uninitialized by the compiler, see
+ * `BytecodeProgram::constant_slots`.
+ *
+ * The outer-most loop annotated with `parallelization` in each nest is lowered
+ * into a ParallelRegion; parallel loops nested inside it run serially, as in
+ * the C backend.
+ *
+ * With a MemoryPlan, tensors packed into the shared slab are zeroed right
+ * before the first top-level statement that accesses them.
+ */
+class BytecodeCompiler : public IRNotImplementedVisitor {
+ public:
+  BytecodeCompiler() {}
+
+  static BytecodeProgram Compile(IRModule &module,
+                                 const MemoryPlan *plan = nullptr);
+
+  void visitInt(IntHandle int_expr) override;
+  void visitFloat(FloatHandle float_expr) override;
+  void visitAdd(AddHandle add) override;
+  void visitSub(SubHandle sub) override;
+  void visitMul(MulHandle mul) override;
+  void visitDiv(DivHandle div) override;
+  void visitMod(ModHandle mod) override;
+  void visitVar(VarHandle var) override;
+  void visitAccess(AccessHandle access) override;
+  void visitAssign(AssignmentHandle assign) override;
+  void visitTensor(TensorHandle tensor) override;
+  void visitVal(ValHandle val) override;
+  void visitDecl(DeclHandle decl) override;
+  void visitFor(ForHandle loop) override;
+  void visitConst(ConstHandle con) override;
+  void visitPrint(PrintHandle print) override;
+  void visitFunc(FuncHandle func) override;
+  void visitPrefetch(PrefetchHandle prefetch) override;
+
+  void visitMin(MinHandle min) override;
+  void visitMax(MaxHandle max) override;
+  void visitSelect(SelectHandle select) override;
+
+  void visitVec(VecHandle vec) override;
+  void visitVecScalar(VecScalarHandle vecScalar) override;
+  void visitVecLoad(VecLoadHandle vecLoad) override;
+  void visitVecBroadCastLoad(VecBroadCastLoadHandle vecBroadCastLoad) override;
+  void visitVecGather(VecGatherHandle gather) override;
+  void visitVecStore(VecStoreHandle vecStore) override;
+  void visitVecAdd(VecAddHandle add) override;
+  void visitVecSub(VecSubHandle sub) override;
+  void visitVecMul(VecMulHandle mul) override;
+  void visitVecDiv(VecDivHandle div) override;
+  void visitVecFMA(VecFMAHandle fma) override;
+  void visitVecMin(VecMinHandle min) override;
+  void visitVecMax(VecMaxHandle max) override;
+  void visitVecCompare(VecCompareHandle compare) override;
+  void visitVecBlend(VecBlendHandle blend) override;
+  void visitVecReduce(VecReduceHandle reduce) override;
+
+ private:
+  enum value_type {
+    INT,
+    FLOAT,
+    VEC,
+  };
+
+  RegSlot newIntReg(int64_t init = 0);
+  RegSlot newFloatReg(float init = .0);
+  RegSlot intConst(int64_t x);
+  RegSlot floatConst(float x);
+  int tensorSlot(TensorHandle tensor);
+  RegSlot constantSlot(const std::string &name);
+
+  size_t emit(Opcode op, RegSlot dst, RegSlot src0 = -1, RegSlot src1 = -1,
+              RegSlot src2 = -1);
+
+  /// Evaluate `expr`, and convert the result into a float register.
+  RegSlot evalFloat(IRHandle expr);
+  /// Evaluate `expr`, the result must be an int register.
+  RegSlot evalInt(IRHandle expr);
+  /// Compute the flat element offset of an access into an int register.
+  RegSlot evalOffset(AccessHandle access);
+  /// The float register holding the value of `reg`, converted if an int.
+  RegSlot asFloat(RegSlot reg, value_type type);
+
+  /// Store the float register `value` into an access or a value.
+  void store(IRHandle lhs, RegSlot value);
+  void binary(IRHandle lhs, IRHandle rhs, Opcode int_op, Opcode float_op);
+
+  /// Evaluate `expr`, the result must be a vector register.
+  RegSlot evalVec(IRHandle expr);
+  /// Pick the opcode matching a vector length.
+  Opcode vecOp(int vecLen, Opcode op4, Opcode op8, Opcode op16);
+  void vecBinary(IRHandle vec, IRHandle lhs, IRHandle rhs, int vecLen,
+                 Opcode op4, Opcode op8, Opcode op16);
+  void vecMemory(IRHandle vec, IRHandle data, int vecLen, Opcode op4,
+                 Opcode op8, Opcode op16, bool store);
+
+  BytecodeProgram program_;
+
+  std::map<int64_t, RegSlot> int_consts_;
+  // keyed by bit pattern so that -0.0 and 0.0 stay distinct.
+  std::map<uint32_t, RegSlot> float_consts_;
+  std::map<IRNodeKey, RegSlot> vars_;
+  std::map<IRNodeKey, RegSlot> vals_;
+  std::map<IRNodeKey, RegSlot> vecs_;
+  bool in_parallel_region_ = false;
+  const MemoryPlan *plan_ = nullptr;
+
+  /// Result of the last visited expression.
+  RegSlot reg_;
+  value_type type_;
+};
+
+}  // namespace polly
@@ -0,0 +1,556 @@
+#include "bytecode_vm.h"
+
+#include <immintrin.h>
+
+namespace polly {
+
+// a * b + c, fused when the library is built with FMA (e.g. -mfma).
+#if defined(__FMA__)
+static inline __m128 fma4(__m128 a, __m128 b, __m128 c) {
+  return _mm_fmadd_ps(a, b, c);
+}
+#else
+static inline __m128 fma4(__m128 a, __m128 b, __m128 c) {
+  return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+#endif
+
+// 8-wide vectors live in a single ymm register when the library is built with
+// AVX enabled (e.g. -mavx2), and in a pair of xmm registers otherwise.
+#if defined(__AVX__)
+typedef __m256 vec8;
+static inline vec8 load8(const float *p) { return _mm256_loadu_ps(p); }
+static inline void store8(float *p, vec8 x) { _mm256_storeu_ps(p, x); }
+static inline vec8 splat8(float x) { return _mm256_set1_ps(x); }
+static inline vec8 add8(vec8 a, vec8 b) { return _mm256_add_ps(a, b); }
+static inline vec8 sub8(vec8 a, vec8 b) { return _mm256_sub_ps(a, b); }
+static inline vec8 mul8(vec8 a, vec8 b) { return _mm256_mul_ps(a, b); }
+static inline vec8 div8(vec8 a, vec8 b) { return _mm256_div_ps(a, b); }
+static inline vec8 min8(vec8 a, vec8 b) { return _mm256_min_ps(a, b); }
+static inline vec8 max8(vec8 a, vec8 b) { return _mm256_max_ps(a, b); }
+#if defined(__FMA__)
+static inline vec8 fma8(vec8 a, vec8 b, vec8 c) {
+  return _mm256_fmadd_ps(a, b, c);
+}
+#else
+static inline vec8 fma8(vec8 a, vec8 b, vec8 c) { return add8(mul8(a, b), c); }
+#endif
+#else
+struct vec8 {
+  __m128 lo, hi;
+};
+static inline vec8 load8(const float *p) {
+  return {_mm_loadu_ps(p), _mm_loadu_ps(p + 4)};
+}
+static inline void store8(float *p, vec8 x) {
+  _mm_storeu_ps(p, x.lo);
+  _mm_storeu_ps(p + 4, x.hi);
+}
+static inline vec8 splat8(float x) { return {_mm_set1_ps(x), _mm_set1_ps(x)}; }
+static inline vec8 add8(vec8 a, vec8 b) {
+  return {_mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi)};
+}
+static inline vec8 sub8(vec8 a, vec8 b) {
+  return {_mm_sub_ps(a.lo, b.lo), _mm_sub_ps(a.hi, b.hi)};
+}
+static inline vec8 mul8(vec8 a, vec8 b) {
+  return {_mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi)};
+}
+static inline vec8 div8(vec8 a, vec8 b) {
+  return {_mm_div_ps(a.lo, b.lo), _mm_div_ps(a.hi, b.hi)};
+}
+static inline vec8 min8(vec8 a, vec8 b) {
+  return {_mm_min_ps(a.lo, b.lo), _mm_min_ps(a.hi, b.hi)};
+}
+static inline vec8 max8(vec8 a, vec8 b) {
+  return {_mm_max_ps(a.lo, b.lo), _mm_max_ps(a.hi, b.hi)};
+}
+static inline vec8 fma8(vec8 a, vec8 b, vec8 c) {
+  return {fma4(a.lo, b.lo, c.lo), fma4(a.hi, b.hi, c.hi)};
+}
+#endif
+
+// 16-wide vectors are a single zmm register with AVX-512, two 8-wide halves
+// otherwise.
+#if defined(__AVX512F__)
+typedef __m512 vec16;
+static inline vec16 load16(const float *p) { return _mm512_loadu_ps(p); }
+static inline void store16(float *p, vec16 x) { _mm512_storeu_ps(p, x); }
+static inline vec16 splat16(float x) { return _mm512_set1_ps(x); }
+static inline vec16 add16(vec16 a, vec16 b) { return _mm512_add_ps(a, b); }
+static inline vec16 sub16(vec16 a, vec16 b) { return _mm512_sub_ps(a, b); }
+static inline vec16 mul16(vec16 a, vec16 b) { return _mm512_mul_ps(a, b); }
+static inline vec16 div16(vec16 a, vec16 b) { return _mm512_div_ps(a, b); }
+static inline vec16 min16(vec16 a, vec16 b) { return _mm512_min_ps(a, b); }
+static inline vec16 max16(vec16 a, vec16 b) { return _mm512_max_ps(a, b); }
+static inline vec16 fma16(vec16 a, vec16 b, vec16 c) {
+  return _mm512_fmadd_ps(a, b, c);
+}
+#else
+struct vec16 {
+  vec8 lo, hi;
+};
+static inline vec16 load16(const float *p) { return {load8(p), load8(p + 8)}; }
+static inline void store16(float *p, vec16 x) {
+  store8(p, x.lo);
+  store8(p + 8, x.hi);
+}
+static inline vec16 splat16(float x) { return {splat8(x), splat8(x)}; }
+static inline vec16 add16(vec16 a, vec16 b) {
+  return {add8(a.lo, b.lo), add8(a.hi, b.hi)};
+}
+static inline vec16 sub16(vec16 a, vec16 b) {
+  return {sub8(a.lo, b.lo), sub8(a.hi, b.hi)};
+}
+static inline vec16 mul16(vec16 a, vec16 b) {
+  return {mul8(a.lo, b.lo), mul8(a.hi, b.hi)};
+}
+static inline vec16 div16(vec16 a, vec16 b) {
+  return {div8(a.lo, b.lo), div8(a.hi, b.hi)};
+}
+static inline vec16 min16(vec16 a, vec16 b) {
+  return {min8(a.lo, b.lo), min8(a.hi, b.hi)};
+}
+static inline vec16 max16(vec16 a, vec16 b) {
+  return {max8(a.lo, b.lo), max8(a.hi, b.hi)};
+}
+static inline vec16 fma16(vec16 a, vec16 b, vec16 c) {
+  return {fma8(a.lo, b.lo, c.lo), fma8(a.hi, b.hi, c.hi)};
+}
+#endif
+
+template <typename T>
+static inline bool Compare(T a, T b, CompareOp op) {
+  switch (op) {
+    case CompareOp::GE:
+      return a >= b;
+    case CompareOp::LE:
+      return a <= b;
+    case CompareOp::GT:
+      return a > b;
+    case CompareOp::LT:
+      return a < b;
+    case CompareOp::EQ:
+      return a == b;
+    default:
+      return a != b;
+  }
+}
+
+// Masks and blends are rare enough to be run 4 lanes at a time at any length.
+static inline __m128 cmp4(__m128 a, __m128 b, CompareOp op) {
+  switch (op) {
+    case CompareOp::GE:
+      return _mm_cmpge_ps(a, b);
+    case CompareOp::LE:
+      return _mm_cmple_ps(a, b);
+    case CompareOp::GT:
+      return _mm_cmpgt_ps(a, b);
+    case CompareOp::LT:
+      return _mm_cmplt_ps(a, b);
+    case CompareOp::EQ:
+      return _mm_cmpeq_ps(a, b);
+    default:
+      return _mm_cmpneq_ps(a, b);
+  }
+}
+static inline void cmpLanes(float *dst, const float *a, const float *b,
+                            CompareOp op, int lanes) {
+  for (int k = 0; k < lanes; k += 4) {
+    _mm_storeu_ps(dst + k, cmp4(_mm_loadu_ps(a + k), _mm_loadu_ps(b + k), op));
+  }
+}
+static inline void blendLanes(float *dst, const float *mask, const float *a,
+                              const float *b, int lanes) {
+  for (int k = 0; k < lanes; k += 4) {
+    __m128 m = _mm_loadu_ps(mask + k);
+    _mm_storeu_ps(dst + k, _mm_or_ps(_mm_and_ps(m, _mm_loadu_ps(a + k)),
+                                     _mm_andnot_ps(m, _mm_loadu_ps(b + k))));
+  }
+}
+static inline void gatherLanes(float *dst, const float *base, int64_t stride,
+                               int lanes) {
+  for (int k = 0; k < lanes; k++) dst[k] = base[k * stride];
+}
+
+static inline float Reduce(float a, float b, ReduceOp op) {
+  switch (op) {
+    case ReduceOp::ADD:
+      return a + b;
+    case ReduceOp::MUL:
+      return a * b;
+    case ReduceOp::MIN:
+      return std::min(a, b);
+    default:
+      return std::max(a, b);
+  }
+}
+// Folds the upper half of the lanes onto the lower one until a single lane is
+// left, as the C backend does.
+static inline float reduceLanes(float init, const float *a, ReduceOp op,
+                                int lanes) {
+  float x[VecRegLanes];
+  std::copy(a, a + lanes, x);
+  for (int half = lanes / 2; half > 0; half /= 2) {
+    for (int k = 0; k < half; k++) x[k] = Reduce(x[k], x[k + half], op);
+  }
+  return Reduce(init, x[0], op);
+}
+
+void BytecodeVM::Run(BytecodeFrame &frame, size_t begin, size_t end) {
+  const Instruction *code = program_.code.data();
+  int64_t *i = frame.int_regs.data();
+  float *f = frame.float_regs.data();
+  float *v = frame.vec_regs.data();
+  float *const *t = tensors_;
+#define VREG(x) (v + (x)*VecRegLanes)
+
+  size_t pc = begin;
+  while (pc < end) {
+    const Instruction &ins = code[pc++];
+    switch (ins.op) {
+      case Opcode::IADD:
+        i[ins.dst] = i[ins.src0] + i[ins.src1];
+        break;
+      case Opcode::ISUB:
+        i[ins.dst] = i[ins.src0] - i[ins.src1];
+        break;
+      case Opcode::IMUL:
+        i[ins.dst] = i[ins.src0] * i[ins.src1];
+        break;
+      case Opcode::IDIV:
+        i[ins.dst] = i[ins.src0] / i[ins.src1];
+        break;
+      case Opcode::IMOD:
+        i[ins.dst] = i[ins.src0] % i[ins.src1];
+        break;
+      case Opcode::IMIN:
+        i[ins.dst] = std::min(i[ins.src0], i[ins.src1]);
+        break;
+      case Opcode::IMAX:
+        i[ins.dst] = std::max(i[ins.src0], i[ins.src1]);
+        break;
+      case Opcode::IMAD:
+        i[ins.dst] = i[ins.src0] * i[ins.src1] + i[ins.src2];
+        break;
+      case Opcode::IMOV:
+        i[ins.dst] = i[ins.src0];
+        break;
+
+      case Opcode::FADD:
+        f[ins.dst] = f[ins.src0] + f[ins.src1];
+        break;
+      case Opcode::FSUB:
+        f[ins.dst] = f[ins.src0] - f[ins.src1];
+        break;
+      case Opcode::FMUL:
+        f[ins.dst] = f[ins.src0] * f[ins.src1];
+        break;
+      case Opcode::FDIV:
+        f[ins.dst] = f[ins.src0] / f[ins.src1];
+        break;
+      case Opcode::FMIN:
+        f[ins.dst] = std::min(f[ins.src0], f[ins.src1]);
+        break;
+      case Opcode::FMAX:
+        f[ins.dst] = std::max(f[ins.src0], f[ins.src1]);
+        break;
+      case Opcode::FMOV:
+        f[ins.dst] = f[ins.src0];
+        break;
+      case Opcode::I2F:
+        f[ins.dst] = static_cast<float>(i[ins.src0]);
+        break;
+
+      case Opcode::ICMP:
+        i[ins.dst] = Compare(i[ins.src0], i[ins.src1],
+                             static_cast<CompareOp>(ins.src2));
+        break;
+      case Opcode::FCMP:
+        i[ins.dst] = Compare(f[ins.src0], f[ins.src1],
+                             static_cast<CompareOp>(ins.src2));
+        break;
+      case Opcode::ISELECT:
+        i[ins.dst] = i[ins.src0] ? i[ins.src1] : i[ins.src2];
+        break;
+      case Opcode::FSELECT:
+        f[ins.dst] = i[ins.src0] ? f[ins.src1] : f[ins.src2];
+        break;
+
+      case Opcode::FLOAD:
+        f[ins.dst] = t[ins.src0][i[ins.src1]];
+        break;
+      case Opcode::FSTORE:
+        t[ins.src0][i[ins.src1]] = f[ins.src2];
+        break;
+      case Opcode::PREFETCH:
+        __builtin_prefetch(t[ins.src0] + i[ins.src1]);
+        break;
+      case Opcode::TZERO:
+        std::fill(t[ins.src0], t[ins.src0] + program_.tensors[ins.src0].size,
+                  0.0f);
+        break;
+
+      case Opcode::JUMP:
+        pc = ins.dst;
+        break;
+      case Opcode::JGE:
+        if (i[ins.src0] >= i[ins.src1]) pc = ins.dst;
+        break;
+      case Opcode::JLT:
+        if (i[ins.src0] < i[ins.src1]) pc = ins.dst;
+        break;
+
+      case Opcode::VSPLAT4:
+        _mm_storeu_ps(VREG(ins.dst), _mm_set1_ps(f[ins.src0]));
+        break;
+      case Opcode::VSPLAT8:
+        store8(VREG(ins.dst), splat8(f[ins.src0]));
+        break;
+      case Opcode::VSPLAT16:
+        store16(VREG(ins.dst), splat16(f[ins.src0]));
+        break;
+      case Opcode::VLOAD4:
+        _mm_storeu_ps(VREG(ins.dst), _mm_loadu_ps(&t[ins.src0][i[ins.src1]]));
+        break;
+      case Opcode::VLOAD8:
+        store8(VREG(ins.dst), load8(&t[ins.src0][i[ins.src1]]));
+        break;
+      case Opcode::VLOAD16:
+        store16(VREG(ins.dst), load16(&t[ins.src0][i[ins.src1]]));
+        break;
+      case Opcode::VBCAST4:
+        _mm_storeu_ps(VREG(ins.dst), _mm_set1_ps(t[ins.src0][i[ins.src1]]));
+        break;
+      case Opcode::VBCAST8:
+        store8(VREG(ins.dst), splat8(t[ins.src0][i[ins.src1]]));
+        break;
+      case Opcode::VBCAST16:
+        store16(VREG(ins.dst), splat16(t[ins.src0][i[ins.src1]]));
+        break;
+      case Opcode::VGATHER4:
+        gatherLanes(VREG(ins.dst), &t[ins.src0][i[ins.src1]], i[ins.src2], 4);
+        break;
+      case Opcode::VGATHER8:
+        gatherLanes(VREG(ins.dst), &t[ins.src0][i[ins.src1]], i[ins.src2], 8);
+        break;
+      case Opcode::VGATHER16:
+        gatherLanes(VREG(ins.dst), &t[ins.src0][i[ins.src1]], i[ins.src2],
+                    16);
+        break;
+      case Opcode::VSTORE4:
+        _mm_storeu_ps(&t[ins.src0][i[ins.src1]], _mm_loadu_ps(VREG(ins.src2)));
+        break;
+      case Opcode::VSTORE8:
+        store8(&t[ins.src0][i[ins.src1]], load8(VREG(ins.src2)));
+        break;
+      case Opcode::VSTORE16:
+        store16(&t[ins.src0][i[ins.src1]], load16(VREG(ins.src2)));
+        break;
+      case Opcode::VADD4:
+        _mm_storeu_ps(VREG(ins.dst), _mm_add_ps(_mm_loadu_ps(VREG(ins.src0)),
+                                                _mm_loadu_ps(VREG(ins.src1))));
+        break;
+      case Opcode::VADD8:
+        store8(VREG(ins.dst),
+               add8(load8(VREG(ins.src0)), load8(VREG(ins.src1))));
+        break;
+      case Opcode::VADD16:
+        store16(VREG(ins.dst),
+                add16(load16(VREG(ins.src0)), load16(VREG(ins.src1))));
+        break;
+      case Opcode::VSUB4:
+        _mm_storeu_ps(VREG(ins.dst), _mm_sub_ps(_mm_loadu_ps(VREG(ins.src0)),
+                                                _mm_loadu_ps(VREG(ins.src1))));
+        break;
+      case Opcode::VSUB8:
+        store8(VREG(ins.dst),
+               sub8(load8(VREG(ins.src0)), load8(VREG(ins.src1))));
+        break;
+      case Opcode::VSUB16:
+        store16(VREG(ins.dst),
+                sub16(load16(VREG(ins.src0)), load16(VREG(ins.src1))));
+        break;
+      case Opcode::VMUL4:
+        _mm_storeu_ps(VREG(ins.dst), _mm_mul_ps(_mm_loadu_ps(VREG(ins.src0)),
+                                                _mm_loadu_ps(VREG(ins.src1))));
+        break;
+      case Opcode::VMUL8:
+        store8(VREG(ins.dst),
+               mul8(load8(VREG(ins.src0)), load8(VREG(ins.src1))));
+        break;
+      case Opcode::VMUL16:
+        store16(VREG(ins.dst),
+                mul16(load16(VREG(ins.src0)), load16(VREG(ins.src1))));
+        break;
+      case Opcode::VDIV4:
+        _mm_storeu_ps(VREG(ins.dst), _mm_div_ps(_mm_loadu_ps(VREG(ins.src0)),
+                                                _mm_loadu_ps(VREG(ins.src1))));
+        break;
+      case Opcode::VDIV8:
+        store8(VREG(ins.dst),
+               div8(load8(VREG(ins.src0)), load8(VREG(ins.src1))));
+        break;
+      case Opcode::VDIV16:
+        store16(VREG(ins.dst),
+                div16(load16(VREG(ins.src0)), load16(VREG(ins.src1))));
+        break;
+      case Opcode::VFMA4:
+        _mm_storeu_ps(VREG(ins.dst), fma4(_mm_loadu_ps(VREG(ins.src0)),
+                                          _mm_loadu_ps(VREG(ins.src1)),
+                                          _mm_loadu_ps(VREG(ins.src2))));
+        break;
+      case Opcode::VFMA8:
+        store8(VREG(ins.dst), fma8(load8(VREG(ins.src0)), load8(VREG(ins.src1)),
+                                   load8(VREG(ins.src2))));
+        break;
+      case Opcode::VFMA16:
+        store16(VREG(ins.dst),
+                fma16(load16(VREG(ins.src0)), load16(VREG(ins.src1)),
+                      load16(VREG(ins.src2))));
+        break;
+      case Opcode::VMIN4:
+        _mm_storeu_ps(VREG(ins.dst), _mm_min_ps(_mm_loadu_ps(VREG(ins.src0)),
+                                                _mm_loadu_ps(VREG(ins.src1))));
+        break;
+      case Opcode::VMIN8:
+        store8(VREG(ins.dst),
+               min8(load8(VREG(ins.src0)), load8(VREG(ins.src1))));
+        break;
+      case Opcode::VMIN16:
+        store16(VREG(ins.dst),
+                min16(load16(VREG(ins.src0)), load16(VREG(ins.src1))));
+        break;
+      case Opcode::VMAX4:
+        _mm_storeu_ps(VREG(ins.dst), _mm_max_ps(_mm_loadu_ps(VREG(ins.src0)),
+                                                _mm_loadu_ps(VREG(ins.src1))));
+        break;
+      case Opcode::VMAX8:
+        store8(VREG(ins.dst),
+               max8(load8(VREG(ins.src0)), load8(VREG(ins.src1))));
+        break;
+      case Opcode::VMAX16:
+        store16(VREG(ins.dst),
+                max16(load16(VREG(ins.src0)), load16(VREG(ins.src1))));
+        break;
+      case Opcode::VCMP4:
+        cmpLanes(VREG(ins.dst), VREG(ins.src0), VREG(ins.src1),
+                 static_cast<CompareOp>(ins.src2), 4);
+        break;
+      case Opcode::VCMP8:
+        cmpLanes(VREG(ins.dst), VREG(ins.src0), VREG(ins.src1),
+                 static_cast<CompareOp>(ins.src2), 8);
+        break;
+      case Opcode::VCMP16:
+        cmpLanes(VREG(ins.dst), VREG(ins.src0), VREG(ins.src1),
+                 static_cast<CompareOp>(ins.src2), 16);
+        break;
+      case Opcode::VBLEND4:
+        blendLanes(VREG(ins.dst), VREG(ins.src0), VREG(ins.src1),
+                   VREG(ins.src2), 4);
+        break;
+      case Opcode::VBLEND8:
+        blendLanes(VREG(ins.dst), VREG(ins.src0), VREG(ins.src1),
+                   VREG(ins.src2), 8);
+        break;
+      case Opcode::VBLEND16:
+        blendLanes(VREG(ins.dst), VREG(ins.src0), VREG(ins.src1),
+                   VREG(ins.src2), 16);
+        break;
+      case Opcode::VREDUCE4:
+        f[ins.dst] = reduceLanes(f[ins.src0], VREG(ins.src1),
+                                 static_cast<ReduceOp>(ins.src2), 4);
+        break;
+      case Opcode::VREDUCE8:
+        f[ins.dst] = reduceLanes(f[ins.src0], VREG(ins.src1),
+                                 static_cast<ReduceOp>(ins.src2), 8);
+        break;
+      case Opcode::VREDUCE16:
+        f[ins.dst] = reduceLanes(f[ins.src0], VREG(ins.src1),
+                                 static_cast<ReduceOp>(ins.src2), 16);
+        break;
+
+      case Opcode::PFOR: {
+        const ParallelRegion &region = program_.parallel_regions[ins.dst];
+        runParallel(frame, region);
+        pc = region.body_end;
+        break;
+      }
+
+      case Opcode::PRINTI:
+        std::cout << i[ins.src0] << std::endl;
+        break;
+      case Opcode::PRINTF:
+        std::cout << f[ins.src0] << std::endl;
+        break;
+
+      case Opcode::HALT:
+        return;
+      default:
+        throw std::runtime_error("Jitter runtime error: unknown opcode");
+    }
+  }
+#undef VREG
+}
+
+void BytecodeVM::runParallel(BytecodeFrame &frame,
+                             const ParallelRegion &region) {
+  int64_t min = frame.int_regs[region.min];
+  int64_t max = frame.int_regs[region.max];
+  int64_t increment = frame.int_regs[region.increment];
+  if (min >= max) return;
+  int64_t trip_count = (max - min + increment - 1) / increment;
+
+  auto run_chunk = [&](BytecodeFrame &local, int64_t first, int64_t last) {
+    for (int64_t it = first; it < last; it++) {
+      local.int_regs[region.var] = min + it * increment;
+      Run(local, region.body_begin, region.body_end);
+    }
+  };
+
+  if (pool_ == nullptr || pool_->thread_num == 0 || trip_count == 1) {
+    run_chunk(frame, 0, trip_count);
+    return;
+  }
+
+  std::vector<BytecodeFrame> frames(pool_->thread_num + 1, frame);
+  int64_t chunk = std::max(region.chunk, 1);
+  std::atomic<int64_t> next(0);
+  pool_->parallel_region([&](int wid, int worker_size) {
+    switch (region.schedule) {
+      case LoopAnnotation::Schedule::STATIC:
+        if (region.chunk <= 0) {
+          run_chunk(frames[wid], trip_count * wid / worker_size,
+                    trip_count * (wid + 1) / worker_size);
+          break;
+        }
+        for (int64_t base = wid * chunk; base < trip_count;
+             base += worker_size * chunk) {
+          run_chunk(frames[wid], base, std::min(base + chunk, trip_count));
+        }
+        break;
+      case LoopAnnotation::Schedule::DYNAMIC:
+        while (true) {
+          int64_t base = next.fetch_add(chunk, std::memory_order_relaxed);
+          if (base >= trip_count) break;
+          run_chunk(frames[wid], base, std::min(base + chunk, trip_count));
+        }
+        break;
+      case LoopAnnotation::Schedule::GUIDED:
+        while (true) {
+          int64_t base = next.load(std::memory_order_relaxed), end;
+          do {
+            if (base >= trip_count) return;
+            end = base + std::max((trip_count - base) / (2 * worker_size),
+                                  chunk);
+            end = std::min(end, trip_count);
+          } while (!next.compare_exchange_weak(base, end,
+                                               std::memory_order_relaxed));
+          run_chunk(frames[wid], base, end);
+        }
+        break;
+    }
+  });
+}
+
+}  // namespace polly
@@ -0,0 +1,50 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-07 15:02:47
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-07 15:02:47
+ * @CopyRight: Qiming Zheng
+ */
+#pragma once
+
+#include "common.h"
+#include "bytecode.h"
+#include "runtime/multi_threading.h"
+
+namespace polly {
+
+/*!
+ * \brief BytecodeVM executes a BytecodeProgram with a single dispatch loop.
+ *
+ * \param program The lowered program, shared by all frames.
+ * \param tensors Base pointers of the tensors, indexed by tensor slot.
+ * \param pool Workers used to run parallel regions, together with the calling
+ * thread. Parallel regions run serially when no pool is given.
+ */
+class BytecodeVM {
+ public:
+  BytecodeVM(const BytecodeProgram &program, float *const *tensors,
+             MultiThreading *pool = nullptr)
+      : program_(program), tensors_(tensors), pool_(pool) {}
+
+  /// Run the whole program in a fresh frame.
+  void Run() {
+    BytecodeFrame frame(program_);
+    Run(frame, 0, program_.code.size());
+  }
+
+  /// Run the instructions in [begin, end) upon `frame`.
+  void Run(BytecodeFrame &frame, size_t begin, size_t end);
+
+ private:
+  /// Statically split the iterations of `region` into one contiguous chunk
+  /// per thread, each executed upon its own copy of `frame`.
+  void runParallel(BytecodeFrame &frame, const ParallelRegion &region);
+
+  const BytecodeProgram &program_;
+  float *const *tensors_;
+  MultiThreading *pool_;
+};
+
+}  // namespace polly
@@ -1,305 +1,135 @@
 #include "jit_module.h"
+#include "pass/check/constant_extent_check.h"
 
 namespace polly {
 
-void JitModule::visitInt(IntHandle int_expr) {
-  v.int_value = int_expr->value;
-  t = value_type::INT;
-  return;
+void JitModule::compile() {
+  program_ = BytecodeCompiler::Compile(module_);
+  tensors_.assign(program_.tensors.size(), nullptr);
+  compiled_ = true;
 }
 
-void JitModule::visitFloat(FloatHandle float_expr) {
-  v.float_value = float_expr->value;
-  t = value_type::FLOAT;
-  return;
-}
-
-void JitModule::visitAdd(AddHandle add) {
-  add->lhs.accept(this);
-  value lhs = v;
-  value_type lhs_type = t;
-  add->rhs.accept(this);
-  value rhs = v;
-  value_type rhs_type = t;
-  if (lhs_type != rhs_type) {
+void JitModule::PlanMemory(std::vector<IRNodeKey> live_out) {
+  // The tensors of an executed module are allocated already, a plan would
+  // take all of them for bound ones and pack nothing.
+  if (executed_) {
     throw std::runtime_error(
-        "Jitter Interpret error: cannot add two expression of different  type");
-  }
-  switch (t) {
-    case value_type::INT:
-      v.int_value = lhs.int_value + rhs.int_value;
-      break;
-    case value_type::FLOAT:
-      v.float_value = lhs.float_value + rhs.float_value;
-      break;
-    default:
-      throw std::runtime_error("Unknown value type");
+        "JitModule: memory must be planned before the first execution");
   }
+  plan_memory_ = true;
+  live_out_ = std::set<IRNodeKey>(live_out.begin(), live_out.end());
 }
 
-void JitModule::visitSub(SubHandle sub) {
-  sub->lhs.accept(this);
-  value lhs = v;
-  value_type lhs_type = t;
-  sub->rhs.accept(this);
-  value rhs = v;
-  value_type rhs_type = t;
-  if (lhs_type != rhs_type) {
-    throw std::runtime_error(
-        "Jitter Interpret error: cannot sub two expression of different  type");
+void JitModule::planMemory() {
+  std::set<IRNodeKey> external = live_out_;
+  for (int i = 0; i < tensors_.size(); i++) {
+    if (tensors_[i] != nullptr) external.insert(program_.tensors[i].id);
   }
-  switch (t) {
-    case value_type::INT:
-      v.int_value = lhs.int_value - rhs.int_value;
-      break;
-    case value_type::FLOAT:
-      v.float_value = lhs.float_value - rhs.float_value;
-      break;
-    default:
-      throw std::runtime_error("Unknown value type");
+  auto ret = MemoryPlanner::runPass(MemoryPlanner::Arg::create(
+      module_.GetRoot(), module_.GetTensors(), external));
+  memory_plan_ = PassRet::as<MemoryPlanner::Ret>(ret)->plan;
+  // Tensor slots only depend on the module, so bindings stay valid.
+  program_ = BytecodeCompiler::Compile(module_, &memory_plan_);
+  if (memory_plan_.slab_size > 0) {
+    slab_ = Buffer<float>(memory_plan_.slab_size);
   }
-}
-
-void JitModule::visitMul(MulHandle mul) {
-  mul->lhs.accept(this);
-  value lhs = v;
-  value_type lhs_type = t;
-  mul->rhs.accept(this);
-  value rhs = v;
-  value_type rhs_type = t;
-  if (lhs_type != rhs_type) {
-    throw std::runtime_error(
-        "Jitter Interpret error: cannot mul two expression of different  type");
-  }
-  switch (t) {
-    case value_type::INT:
-      v.int_value = lhs.int_value * rhs.int_value;
-      break;
-    case value_type::FLOAT:
-      v.float_value = lhs.float_value * rhs.float_value;
-      break;
-    default:
-      throw std::runtime_error("Unknown value type");
+  for (auto &allocation : memory_plan_.allocations) {
+    tensors_[program_.tensor_slots[allocation.tensor]] =
+        slab_.data + allocation.offset;
   }
+  planned_ = true;
 }
 
-void JitModule::visitDiv(DivHandle div) {
-  div->lhs.accept(this);
-  value lhs = v;
-  value_type lhs_type = t;
-  div->rhs.accept(this);
-  value rhs = v;
-  value_type rhs_type = t;
-  if (lhs_type != rhs_type) {
-    throw std::runtime_error(
-        "Jitter Interpret error: cannot div two expression of different  type");
-  }
-  switch (t) {
-    case value_type::INT:
-      v.int_value = lhs.int_value / rhs.int_value;
-      break;
-    case value_type::FLOAT:
-      v.float_value = lhs.float_value / rhs.float_value;
-      break;
-    default:
-      throw std::runtime_error("Unknown value type");
+int JitModule::getSlot(const IRNodeKey &id) {
+  if (!compiled_) compile();
+  auto it = program_.tensor_slots.find(id);
+  if (it == program_.tensor_slots.end()) {
+    throw std::runtime_error("JitModule: unknown tensor " + id);
   }
+  return it->second;
 }
 
-void JitModule::visitMod(ModHandle mod) {
-  mod->lhs.accept(this);
-  value lhs = v;
-  value_type lhs_type = t;
-  mod->rhs.accept(this);
-  value rhs = v;
-  value_type rhs_type = t;
-  if (lhs_type != rhs_type) {
-    throw std::runtime_error(
-        "Jitter Interpret error: cannot mod two expression of different  type");
+void JitModule::BindTensor(const IRNodeKey &id, float *data) {
+  if (data == nullptr) {
+    throw std::runtime_error("JitModule: cannot bind tensor " + id +
+                             " to a null pointer");
   }
-  switch (t) {
-    case value_type::INT:
-      v.int_value = lhs.int_value % rhs.int_value;
-      break;
-    case value_type::FLOAT:
-      throw std::runtime_error("Cannot use \% for two floating number");
-      break;
-    default:
-      throw std::runtime_error("Unknown value type");
+  if (memory_plan_.Find(id) != nullptr) {
+    throw std::runtime_error("JitModule: tensor " + id +
+                             " lives in the shared slab and cannot be bound");
   }
+  tensors_[getSlot(id)] = data;
 }
 
-void JitModule::visitVar(VarHandle var) {
-  if (symbols_.find(var->id) == symbols_.end()) {
-    // Initialize variable
-    var->min.accept(this);
-    assert(t == value_type::INT);
-    symbols_[var->id] = v;
+void JitModule::BindTensor(const IRNodeKey &id, Buffer<float> &buffer) {
+  int slot = getSlot(id);
+  if (buffer.size < program_.tensors[slot].size) {
+    throw std::runtime_error("JitModule: buffer bound to tensor " + id +
+                             " is smaller than the tensor");
   }
-  t = value_type::INT;
-  v = symbols_[var->id];
+  BindTensor(id, buffer.data);
 }
 
-void JitModule::visitAccess(AccessHandle access) {
-  access->tensor.accept(this);
-  int offset = 0;
-  for (int i = 0; i < access->indices.size(); i++) {
-    access->indices[i].accept(this);
-    if (t != value_type::INT) {
-      throw std::runtime_error("cannot access a tensor with float indices");
-    }
-    offset = offset * tensor_shapes_[access->tensor.as<TensorNode>()->id][i] +
-             v.int_value;
+void JitModule::SetConstant(const std::string &name, int64_t value) {
+  if (!compiled_) compile();
+  if (program_.constant_slots.count(name) == 0) {
+    throw std::runtime_error("JitModule: unknown constant " + name);
   }
-  t = value_type::FLOAT;
-  v.float_value = *(tensor_ptr + offset);
+  constants_[name] = value;
+  extents_checked_ = false;
 }
 
-void JitModule::visitAssign(AssignmentHandle assign) {
-  assign->rhs.accept(this);
-  float assigned_value = v.float_value;
-  switch (assign->lhs.Type()) {
-    case IRNodeType::ACCESS: {
-      // Assert lhs must be a tensor access
-      int offset = 0;
-
-      auto access = assign->lhs.as<AccessNode>();
-
-      for (int i = 0; i < access->indices.size(); i++) {
-        access->indices[i].accept(this);
-        if (t != value_type::INT) {
-          throw std::runtime_error("cannot access a tensor with float indices");
-        }
-        offset =
-            offset * tensor_shapes_[access->tensor.as<TensorNode>()->id][i] +
-            v.int_value;
-      }
-      assign->lhs.as<AccessNode>()->tensor.accept(this);
-      tensor_ptr[offset] = assigned_value;
-      break;
-    }
-    case IRNodeType::VALUE: {
-      symbols_[assign->lhs.as<ValNode>()->id].float_value = assigned_value;
-      break;
-    }
-    default:
-      break;
-  }
+void JitModule::PinWorkers(TopologyLevel level) {
+  pin_workers_ = true;
+  affinity_ = level;
+  if (pool_ != nullptr) pool_->PinWorkers(affinity_);
 }
 
-void JitModule::visitTensor(TensorHandle tensor) {
-  if (tensors_.find(tensor->id) == tensors_.end()) {
-    tensor_shapes_[tensor->id] = {};
-    size_t size = 1;
-    for (int i = 0; i < tensor->shape.size(); i++) {
-      tensor_shapes_[tensor->id].push_back(tensor->shape[i]);
-      size *= tensor->shape[i];
+void JitModule::execute() {
+  if (!compiled_) compile();
+  if (plan_memory_ && !planned_) planMemory();
+  for (auto &it : program_.constant_slots) {
+    auto value = constants_.find(it.first);
+    if (value == constants_.end()) {
+      throw std::runtime_error("JitModule: constant " + it.first +
+                               " is not set");
     }
-    tensors_[tensor->id] = new float[size];
-    for (int i = 0; i < size; i++) tensors_[tensor->id][i] = .0;
-  }
-  tensor_ptr = tensors_[tensor->id];
-}
-
-void JitModule::visitVal(ValHandle val) {
-  if (symbols_.find(val->id) == symbols_.end()) {
-    // left the value undefined.
-    symbols_[val->id].float_value = __FLT_MAX__;
-  } else {
-    t = value_type::FLOAT;
-    v = symbols_[val->id];
-  }
-}
-
-void JitModule::visitDecl(DeclHandle decl) { decl->decl.accept(this); }
-
-void JitModule::visitFor(ForHandle loop) {
-  loop->looping_var_.accept(this);
-  VarHandle looping_var = loop->looping_var_.as<VarNode>();
-  looping_var->max.accept(this);
-  assert(t == value_type::INT);
-  while (symbols_[looping_var->id].int_value < v.int_value) {
-    for (int i = 0; i < loop->body.size(); i++) {
-      loop->body[i].accept(this);
+    program_.int_regs[it.second] = value->second;
+  }
+  if (!extents_checked_) {
+    auto ret = ConstantExtentCheck::runPass(
+        ConstantExtentCheck::Arg::create(module_.GetRoot(), constants_));
+    auto violation = PassRet::as<ConstantExtentCheck::Ret>(ret)->violation;
+    if (!violation.empty()) {
+      throw std::runtime_error("JitModule: " + violation);
+    }
+    extents_checked_ = true;
+  }
+  if (pool_ == nullptr && num_threads_ > 1 &&
+      !program_.parallel_regions.empty()) {
+    pool_.reset(new MultiThreading(num_threads_ - 1));
+    if (pin_workers_) pool_->PinWorkers(affinity_);
+  }
+  for (int i = 0; i < tensors_.size(); i++) {
+    if (tensors_[i] == nullptr) {
+      Buffer<float> buffer(program_.tensors[i].size);
+      // Let the workers that run the parallel loops touch their pages first.
+      if (pool_ != nullptr) {
+        FirstTouch(*pool_, buffer.data, buffer.size);
+      } else {
+        buffer.Fill(0);
+      }
+      tensors_[i] = buffer.data;
+      owned_tensors_.push_back(std::move(buffer));
     }
-    looping_var->increment.accept(this);
-    assert(t == value_type::INT);
-    symbols_[looping_var->id].int_value += v.int_value;
-    looping_var->max.accept(this);
-    assert(t == value_type::INT);
-  }
-  // when leave the for-loop scope, erase its var;
-  symbols_.erase(looping_var->id);
-}
-
-void JitModule::visitConst(ConstHandle con) {
-  throw std::runtime_error("Constant value is unknown");
-}
-
-void JitModule::visitPrint(PrintHandle print) {
-  print->print.accept(this);
-  switch (t) {
-    case value_type::INT:
-      std::cout << v.int_value << std::endl;
-      break;
-    case value_type::FLOAT:
-      std::cout << v.float_value << std::endl;
-      break;
-    default:
-      throw std::runtime_error("Cannot print an unknown type data");
-  }
-}
-
-void JitModule::visitFunc(FuncHandle func) {
-  for (int i = 0; i < func->body.size(); i++) {
-    func->body[i].accept(this);
-  }
-}
-
-void JitModule::visitMin(MinHandle min) {
-  min->lhs.accept(this);
-  value lhs = v;
-  value_type lhs_type = t;
-  min->rhs.accept(this);
-  value rhs = v;
-  value_type rhs_type = t;
-  if (lhs_type != rhs_type) {
-    throw std::runtime_error(
-        "Jitter Interpret error: cannot min two expression of different type");
-  }
-  switch (t) {
-    case value_type::INT:
-      v.int_value = std::min(lhs.int_value, rhs.int_value);
-      break;
-    case value_type::FLOAT:
-      v.float_value = std::min(lhs.float_value, rhs.float_value);
-      break;
-    default:
-      throw std::runtime_error("Unknown value type");
   }
+  executed_ = true;
+  BytecodeVM vm(program_, tensors_.data(), pool_.get());
+  vm.Run();
 }
 
-void JitModule::visitMax(MaxHandle max) {
-  max->lhs.accept(this);
-  value lhs = v;
-  value_type lhs_type = t;
-  max->rhs.accept(this);
-  value rhs = v;
-  value_type rhs_type = t;
-  if (lhs_type != rhs_type) {
-    throw std::runtime_error(
-        "Jitter Interpret error: cannot max two expression of different type");
-  }
-  switch (t) {
-    case value_type::INT:
-      v.int_value = std::max(lhs.int_value, rhs.int_value);
-      break;
-    case value_type::FLOAT:
-      v.float_value = std::max(lhs.float_value, rhs.float_value);
-      break;
-    default:
-      throw std::runtime_error("Unknown value type");
-  }
+float *JitModule::GetTensor(const IRNodeKey &id) {
+  return tensors_[getSlot(id)];
 }
 
-}  // namespace polly
\ No newline at end of file
+}  // namespace polly
@@ -1,66 +1,96 @@
 /*
- * @Description: Polly: A DSL compiler for Tensor Program 
- * @Author: Qiming Zheng 
- * @Date: 2022-01-18 20:32:34 
- * @Last Modified by:   Qiming Zheng 
- * @Last Modified time: 2022-01-18 20:32:34 
- * @CopyRight: Qiming Zheng 
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-01-18 20:32:34
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-08 16:03:52
+ * @CopyRight: Qiming Zheng
  */
 #pragma once
 
 #include "ir/ir.h"
 #include "ir/ir_module.h"
+#include "runtime/buffer.h"
+#include "bytecode.h"
+#include "bytecode_compiler.h"
+#include "bytecode_vm.h"
 
 namespace polly {
 
-/// Jitter Module that executes a program.
-class JitModule : public IRNotImplementedVisitor {
+/*!
+ * \brief Jitter Module that executes a program. The IR is lowered into a
+ * register bytecode (see BytecodeCompiler) once; later executions only run the
+ * BytecodeVM.
+ *
+ * Tensors can be bound to caller-owned memory with `BindTensor` before
+ * `execute()`. Bound memory is read and written in place, and is never copied,
+ * zeroed or freed by the JitModule. Tensors that are left unbound are
+ * allocated (zero-initialized) by the module on the first execution, from the
+ * BufferAllocator pool, and go back to the pool with the module.
+ *
+ * Constants referenced by the program must be bound with `SetConstant`
+ * before `execute()`. Tensors are allocated with their declared shape, which
+ * bounds the sizes the constants can describe; `execute()` throws if the
+ * constants drive an access out of its tensor.
+ *
+ * Loops annotated as parallel are split across a pool of `num_threads`
+ * threads (the calling thread included), each with its own register state.
+ * Tensors allocated by the module are first touched by the same threads, with
+ * the same static split as the outer parallel loop.
+ */
+class JitModule : public Uncopyable {
  public:
-  JitModule(const IRModule &workspace) : module_(workspace) {}
-  ~JitModule() {
-    for (auto tensor : tensors_) {
-      delete[] tensor.second;
-    }
-  }
-  void execute() { visit(module_.GetRoot()); }
+  JitModule(const IRModule &workspace,
+            int num_threads = std::thread::hardware_concurrency())
+      : module_(workspace), num_threads_(std::max(num_threads, 1)) {}
+  void execute();
+
+  /// Bind tensor `id` to `data`, which must hold at least as many elements
+  /// as the tensor.
+  void BindTensor(const IRNodeKey &id, float *data);
+  void BindTensor(const IRNodeKey &id, Buffer<float> &buffer);
+
+  /// Bind constant `name` to `value` for the following executions.
+  void SetConstant(const std::string &name, int64_t value);
 
-  void visitInt(IntHandle int_expr) override;
-  void visitFloat(FloatHandle float_expr) override;
-  void visitAdd(AddHandle add) override;
-  void visitSub(SubHandle sub) override;
-  void visitMul(MulHandle mul) override;
-  void visitDiv(DivHandle div) override;
-  void visitMod(ModHandle mod) override;
-  void visitVar(VarHandle var) override;
-  void visitAccess(AccessHandle access) override;
-  void visitAssign(AssignmentHandle assign) override;
-  void visitTensor(TensorHandle tensor) override;
-  void visitVal(ValHandle val) override;
-  void visitDecl(DeclHandle decl) override;
-  void visitFor(ForHandle loop) override;
-  void visitConst(ConstHandle con) override;
-  void visitPrint(PrintHandle print) override;
-  void visitFunc(FuncHandle func) override;
+  /// Storage of tensor `id`, either bound by the caller or allocated by the
+  /// first `execute()`.
+  float *GetTensor(const IRNodeKey &id);
 
-  void visitMin(MinHandle min) override;
-  void visitMax(MaxHandle max) override;
+  /// Pin the worker threads, one per unit of `level` (see CpuTopology).
+  void PinWorkers(TopologyLevel level);
+
+  /// Let intermediate tensors share one slab (see MemoryPlanner). Tensors in
+  /// `live_out` and tensors bound before the first `execute()` keep their own
+  /// storage; the others are only meaningful while the program runs. Throws
+  /// once the module has been executed.
+  void PlanMemory(std::vector<IRNodeKey> live_out);
+  const MemoryPlan &GetMemoryPlan() const { return memory_plan_; }
 
  private:
-  union value {
-    int int_value;
-    float float_value;
-  };
-  enum value_type {
-    INT,
-    FLOAT,
-  };
-  float *tensor_ptr;
-  value v;
-  value_type t;
+  void compile();
+  void planMemory();
+  int getSlot(const IRNodeKey &id);
+
+  bool compiled_ = false;
   IRModule module_;
-  std::map<std::string, value> symbols_;
-  std::map<std::string, float *> tensors_;
-  std::map<std::string, std::vector<int>> tensor_shapes_;
+  int num_threads_;
+  std::unique_ptr<MultiThreading> pool_;
+  bool pin_workers_ = false;
+  TopologyLevel affinity_;
+  BytecodeProgram program_;
+  /// Indexed by the tensor slots of `program_`.
+  std::vector<float *> tensors_;
+  std::vector<Buffer<float>> owned_tensors_;
+  std::map<std::string, int64_t> constants_;
+  bool extents_checked_ = false;
+
+  bool executed_ = false;
+  bool plan_memory_ = false;
+  bool planned_ = false;
+  std::set<IRNodeKey> live_out_;
+  MemoryPlan memory_plan_;
+  Buffer<float> slab_;
 };
 
 }  // namespace polly
@@ -0,0 +1,235 @@
+#include "native_module.h"
+#include "codegen/codegen.h"
+#include "pass/check/constant_extent_check.h"
+#include "runtime/c_runtime_api.h"
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+namespace polly {
+
+// The CostModel times the candidates of the auto-scheduler with these flags,
+// so a tuned schedule behaves the same once loaded.
+const std::string NativeModule::DefaultCompileFlags =
+    "--std=c++11 -O3 -mfma -pthread";
+const std::string NativeModule::PortableCompileFlags =
+    "--std=c++11 -O3 -pthread";
+
+static const std::string EntryName = "polly_native_entry";
+
+NativeModule::NativeModule(IRModule &module, std::string program_name,
+                           std::string compile_flags)
+    : module_(module),
+      program_name_(program_name),
+      compile_flags_(compile_flags) {
+  init();
+}
+
+NativeModule::NativeModule(IRModule &module,
+                           std::vector<KernelVariant> variants,
+                           std::string program_name,
+                           std::string compile_flags)
+    : module_(module),
+      program_name_(program_name),
+      compile_flags_(compile_flags),
+      variants_(variants) {
+  init();
+}
+
+void NativeModule::init() {
+  char dir_template[] = "/tmp/polly_native_XXXXXX";
+  if (mkdtemp(dir_template) == nullptr) {
+    throw std::runtime_error("NativeModule: cannot create a working directory");
+  }
+  workdir_ = dir_template;
+
+  for (auto &tensor : module_.GetTensors()) {
+    tensor_order_.push_back(tensor.as<TensorNode>()->id);
+    size_t size = 1;
+    for (auto dim : tensor.as<TensorNode>()->shape) size *= dim;
+    tensor_sizes_.push_back(size);
+  }
+  // The destructor does not run when the constructor throws.
+  try {
+    load(generic_, "");
+  } catch (...) {
+    rmdir(workdir_.c_str());
+    throw;
+  }
+}
+
+NativeModule::~NativeModule() {
+  for (auto &library : specializations_) unload(library);
+  unload(generic_);
+  rmdir(workdir_.c_str());
+}
+
+void NativeModule::load(Library &library, std::string suffix) {
+  library.source_path = workdir_ + "/" + program_name_ + suffix + ".cc";
+  library.library_path = workdir_ + "/" + program_name_ + suffix + ".so";
+  // A library that fails to build or load leaves none of its files behind.
+  try {
+    build(library);
+  } catch (...) {
+    unload(library);
+    library.handle = nullptr;
+    throw;
+  }
+}
+
+void NativeModule::build(Library &library) {
+  std::ofstream f;
+  f.open(library.source_path);
+  {
+    CodeGenC codegen;
+    codegen.constant_values_ = library.values;
+    if (variants_.empty()) {
+      f << codegen.genCode(module_.GetRoot(), module_.GetTensors(),
+                           program_name_);
+    } else {
+      f << codegen.genDispatch(variants_, module_.GetTensors(), program_name_);
+    }
+    alignment_ = std::max(alignment_, codegen.alignment_);
+    constant_order_ = codegen.constant_name;
+  }
+  f << genEntry(module_.GetTensors(), program_name_);
+  f.close();
+
+  int status;
+  std::string log = executeCommands(
+      "g++ " + compile_flags_ + " -shared -fPIC -o " + library.library_path +
+          " " + library.source_path + " 2>&1",
+      status);
+  if (status != 0) {
+    throw std::runtime_error("NativeModule: failed to compile " +
+                             library.source_path + ":\n" + log);
+  }
+
+  library.handle = dlopen(library.library_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (library.handle == nullptr) {
+    throw std::runtime_error(std::string("NativeModule: ") + dlerror());
+  }
+  library.func = reinterpret_cast<KernelFunc>(
+      dlsym(library.handle, EntryName.c_str()));
+  if (library.func == nullptr) {
+    throw std::runtime_error(std::string("NativeModule: ") + dlerror());
+  }
+  // Kernels with parallel loops run them on the runtime pool of this process.
+  auto launch = reinterpret_cast<PollyParallelLaunchFunc *>(
+      dlsym(library.handle, "polly_parallel_launch"));
+  if (launch != nullptr) *launch = polly_backend_parallel_launch;
+}
+
+void NativeModule::unload(Library &library) {
+  if (library.handle != nullptr) dlclose(library.handle);
+  unlink(library.library_path.c_str());
+  unlink(library.source_path.c_str());
+}
+
+void NativeModule::SetConstant(const std::string &name, int64_t value) {
+  bool declared = std::find(constant_order_.begin(), constant_order_.end(),
+                            name) != constant_order_.end();
+  for (auto &constant : module_.GetConstants()) {
+    declared |= constant.as<ConstNode>()->name == name;
+  }
+  if (!declared) {
+    throw std::runtime_error("NativeModule: unknown constant " + name);
+  }
+  constant_values_[name] = value;
+  extents_checked_ = false;
+}
+
+void NativeModule::checkExtents() {
+  auto ret = ConstantExtentCheck::runPass(
+      ConstantExtentCheck::Arg::create(module_.GetRoot(), constant_values_));
+  auto violation = PassRet::as<ConstantExtentCheck::Ret>(ret)->violation;
+  if (!violation.empty()) {
+    throw std::runtime_error("NativeModule: " + violation);
+  }
+  extents_checked_ = true;
+}
+
+void NativeModule::Specialize(const std::map<std::string, int64_t> &values) {
+  for (auto &it : values) {
+    if (std::find(constant_order_.begin(), constant_order_.end(), it.first) ==
+        constant_order_.end()) {
+      throw std::runtime_error("NativeModule: unknown constant " + it.first);
+    }
+  }
+  for (auto &library : specializations_) {
+    if (library.values == values) return;
+  }
+  Library library;
+  library.values = values;
+  load(library, "_" + std::to_string(specializations_.size()));
+  specializations_.push_back(library);
+}
+
+NativeModule::KernelFunc NativeModule::dispatch() const {
+  for (auto &library : specializations_) {
+    bool match = true;
+    for (auto &it : library.values) {
+      auto bound = constant_values_.find(it.first);
+      match &= bound != constant_values_.end() && bound->second == it.second;
+    }
+    if (match) return library.func;
+  }
+  return generic_.func;
+}
+
+std::vector<Buffer<float>> NativeModule::AllocateTensors() {
+  std::vector<Buffer<float>> buffers;
+  for (auto size : tensor_sizes_) {
+    buffers.emplace_back(size);
+    buffers.back().Fill(0);
+  }
+  return buffers;
+}
+
+void NativeModule::execute(std::vector<Buffer<float>> &buffers) {
+  std::vector<float *> data;
+  for (int i = 0; i < buffers.size(); i++) {
+    if (i < tensor_sizes_.size() && buffers[i].size < tensor_sizes_[i]) {
+      throw std::runtime_error("NativeModule: buffer of tensor " +
+                               tensor_order_[i] + " is too small");
+    }
+    data.push_back(buffers[i].data);
+  }
+  execute(data);
+}
+
+/// The entry point forwards the flat buffers and the constants to the kernel
+/// parameters.
+std::string NativeModule::genEntry(std::vector<IRHandle> &tensors,
+                                   std::string program_name) {
+  std::ostringstream oss;
+  oss << "#include <stdint.h>\n";
+  oss << "extern \"C\" void " << EntryName
+      << "(float **buffers, const int64_t *constants) {\n";
+  oss << "  " << program_name << "(";
+  for (int i = 0; i < tensors.size(); i++) {
+    if (i > 0) oss << ", ";
+    oss << "buffers[" << i << "]";
+  }
+  for (int i = 0; i < constant_order_.size(); i++) {
+    if (i > 0 || !tensors.empty()) oss << ", ";
+    oss << "constants[" << i << "]";
+  }
+  oss << ");\n";
+  oss << "}\n";
+  return oss.str();
+}
+
+std::string NativeModule::executeCommands(std::string cmd, int &status) {
+  char buffer[128];
+  std::string result = "";
+  FILE *pipe = popen(cmd.c_str(), "r");
+  if (!pipe) throw std::runtime_error("popen() failed!");
+  while (fgets(buffer, sizeof buffer, pipe) != NULL) {
+    result += buffer;
+  }
+  status = pclose(pipe);
+  return result;
+}
+
+}  // namespace polly
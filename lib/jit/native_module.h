@@ -0,0 +1,149 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-08 10:41:37
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-08 10:41:37
+ * @CopyRight: Qiming Zheng
+ */
+#pragma once
+
+#include "common.h"
+#include "ir/ir.h"
+#include "ir/ir_module.h"
+#include "codegen/codegen.h"
+#include "runtime/buffer.h"
+
+namespace polly {
+
+/*!
+ * \brief NativeModule compiles the CodeGenC output of a program into a shared
+ * object and loads it into the current process. The kernel is exposed through
+ * a uniform C entry point taking one caller-owned float buffer per tensor, in
+ * the order of `GetTensorOrder()`, so it can be invoked repeatedly at native
+ * speed without spawning a process. The buffers must not overlap, the kernel
+ * takes them as `__restrict__` pointers.
+ *
+ * The values of the program constants follow as a second array, in the order
+ * of `GetConstantOrder()`, so one binary runs every size the tensors can
+ * hold; `execute` throws if the bound values exceed the tensor shapes. Hot
+ * sizes can be given their own binary with `Specialize`, compiled with the
+ * constants as literals; `execute` dispatches to it whenever the constants
+ * take these values.
+ *
+ * A module can also be built from variants of the program for several
+ * instruction sets, of which the best one the CPU supports runs, see
+ * CodeGenC::genDispatch.
+ *
+ * \param module The program to be compiled.
+ * \param program_name Name of the generated kernel.
+ * \param compile_flags Flags passed to the host compiler.
+ */
+class NativeModule : public Uncopyable {
+ public:
+  typedef void (*KernelFunc)(float **buffers, const int64_t *constants);
+
+  static const std::string DefaultCompileFlags;
+  /// For multiversioned modules, which run on any x86-64 CPU.
+  static const std::string PortableCompileFlags;
+
+  NativeModule(IRModule &module, std::string program_name = "kernel",
+               std::string compile_flags = DefaultCompileFlags);
+  /// The `variants` are scheduled from `module`, which gives the tensors.
+  NativeModule(IRModule &module, std::vector<KernelVariant> variants,
+               std::string program_name = "kernel",
+               std::string compile_flags = PortableCompileFlags);
+  ~NativeModule();
+
+  /// The generic kernel, which takes the constants as arguments.
+  KernelFunc GetFunction() const { return generic_.func; }
+
+  /// Tensor ids, in the order their buffers are expected by the kernel.
+  const std::vector<IRNodeKey> &GetTensorOrder() const { return tensor_order_; }
+
+  /// Constant names, in the order their values are expected by the kernel.
+  const std::vector<std::string> &GetConstantOrder() const {
+    return constant_order_;
+  }
+
+  /// Bind constant `name` to `value` for the following executions.
+  void SetConstant(const std::string &name, int64_t value);
+
+  /// Compile a variant of the kernel for the constants in `values`.
+  void Specialize(const std::map<std::string, int64_t> &values);
+
+  /// Alignment in bytes the kernel expects of every buffer, 0 if none. It is
+  /// met by the buffers of `AllocateTensors()`.
+  int GetAlignment() const { return alignment_; }
+
+  void execute(std::vector<float *> buffers) {
+    if (buffers.size() != tensor_order_.size()) {
+      throw std::runtime_error("NativeModule: expect " +
+                               std::to_string(tensor_order_.size()) +
+                               " buffers, got " +
+                               std::to_string(buffers.size()));
+    }
+    for (int i = 0; alignment_ > 0 && i < buffers.size(); i++) {
+      if (reinterpret_cast<uintptr_t>(buffers[i]) % alignment_ != 0) {
+        throw std::runtime_error("NativeModule: buffer of tensor " +
+                                 tensor_order_[i] + " is not " +
+                                 std::to_string(alignment_) +
+                                 "-byte aligned");
+      }
+    }
+    std::vector<int64_t> constants;
+    for (auto &name : constant_order_) {
+      auto it = constant_values_.find(name);
+      if (it == constant_values_.end()) {
+        throw std::runtime_error("NativeModule: constant " + name +
+                                 " is not set");
+      }
+      constants.push_back(it->second);
+    }
+    if (!extents_checked_) checkExtents();
+    dispatch()(buffers.data(), constants.data());
+  }
+
+  /// Zero-initialized storage from the BufferAllocator pool for every tensor,
+  /// in the order of `GetTensorOrder()`.
+  std::vector<Buffer<float>> AllocateTensors();
+  void execute(std::vector<Buffer<float>> &buffers);
+
+ private:
+  /// A compiled kernel, specialized for `values` if any.
+  struct Library {
+    std::map<std::string, int64_t> values;
+    std::string source_path;
+    std::string library_path;
+    void *handle = nullptr;
+    KernelFunc func = nullptr;
+  };
+
+  void init();
+  void load(Library &library, std::string suffix);
+  void build(Library &library);
+  void unload(Library &library);
+  /// Throws if the bound constants drive an access out of its tensor.
+  void checkExtents();
+  /// The specialization matching the bound constants, else the generic one.
+  KernelFunc dispatch() const;
+  std::string genEntry(std::vector<IRHandle> &tensors,
+                       std::string program_name);
+  std::string executeCommands(std::string cmd, int &status);
+
+  IRModule module_;
+  std::string program_name_;
+  std::string compile_flags_;
+  std::vector<KernelVariant> variants_;
+  std::string workdir_;
+  Library generic_;
+  std::vector<Library> specializations_;
+  std::vector<IRNodeKey> tensor_order_;
+  std::vector<size_t> tensor_sizes_;
+  std::vector<std::string> constant_order_;
+  std::map<std::string, int64_t> constant_values_;
+  bool extents_checked_ = false;
+  int alignment_ = 0;
+};
+
+}  // namespace polly
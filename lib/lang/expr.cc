@@ -29,6 +29,25 @@ Expr operator%(const Expr &a, const Expr &b) {
   return Expr(ModNode::make(a.GetIRHandle(), b.GetIRHandle()));
 }
 
+Condition operator>=(const Expr &a, const Expr &b) {
+  return Condition{CompareOp::GE, a, b};
+}
+Condition operator<=(const Expr &a, const Expr &b) {
+  return Condition{CompareOp::LE, a, b};
+}
+Condition operator>(const Expr &a, const Expr &b) {
+  return Condition{CompareOp::GT, a, b};
+}
+Condition operator<(const Expr &a, const Expr &b) {
+  return Condition{CompareOp::LT, a, b};
+}
+Condition operator==(const Expr &a, const Expr &b) {
+  return Condition{CompareOp::EQ, a, b};
+}
+Condition operator!=(const Expr &a, const Expr &b) {
+  return Condition{CompareOp::NE, a, b};
+}
+
 Access::Access(const Expr tensor, const std::vector<Expr> &indices) {
   std::vector<IRHandle> indicesIRNodes;
   indicesIRNodes.clear();
@@ -58,7 +77,10 @@ Value &Value::operator=(const Expr &rhs) {
   Assignment(Expr(GetIRHandle()), rhs);
 }
 
-Constant::Constant(const std::string name) { handle_ = ConstNode::make(name); }
+Constant::Constant(const std::string name) : name(name) {
+  handle_ = ConstNode::make(name);
+  Program::GetInstance()->DeclareConstant(this);
+}
 
 Max::Max(const Expr &a, const Expr &b) {
   handle_ = MaxNode::make(a.GetIRHandle(), b.GetIRHandle());
@@ -66,5 +88,10 @@ Max::Max(const Expr &a, const Expr &b) {
 Min::Min(const Expr &a, const Expr &b) {
   handle_ = MinNode::make(a.GetIRHandle(), b.GetIRHandle());
 }
+Select::Select(const Condition &cond, const Expr &a, const Expr &b) {
+  handle_ = SelectNode::make(cond.op, cond.lhs.GetIRHandle(),
+                             cond.rhs.GetIRHandle(), a.GetIRHandle(),
+                             b.GetIRHandle());
+}
 
 }  // namespace polly
\ No newline at end of file
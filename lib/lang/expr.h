@@ -31,6 +31,19 @@ Expr operator-(const Expr &a, const Expr &b);
 Expr operator*(const Expr &a, const Expr &b);
 Expr operator/(const Expr &a, const Expr &b);
 
+/// A comparison of two expressions, the condition of a Select.
+struct Condition {
+  CompareOp op;
+  Expr lhs, rhs;
+};
+
+Condition operator>=(const Expr &a, const Expr &b);
+Condition operator<=(const Expr &a, const Expr &b);
+Condition operator>(const Expr &a, const Expr &b);
+Condition operator<(const Expr &a, const Expr &b);
+Condition operator==(const Expr &a, const Expr &b);
+Condition operator!=(const Expr &a, const Expr &b);
+
 /// Looping itearator
 class Variable : public Expr {
  public:
@@ -115,7 +128,8 @@ class Value : public Expr {
   }
 };
 
-/// TODO: Should not be exposed to users.
+/// A symbolic integer, e.g. a loop extent, whose value is only bound when the
+/// program runs. Constants with the same name are the same constant.
 class Constant : public Expr {
  public:
   std::string name;
@@ -132,4 +146,11 @@ class Max : public Expr {
   Max(const Expr &a, const Expr &b);
 };
 
+/// `a` where `cond` holds, `b` elsewhere, e.g. a leaky ReLU
+/// `Select(A(i) > 0, A(i), A(i) * 0.1f)`.
+class Select : public Expr {
+ public:
+  Select(const Condition &cond, const Expr &a, const Expr &b);
+};
+
 }  // namespace polly
\ No newline at end of file
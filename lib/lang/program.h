@@ -16,6 +16,7 @@
 #include "codegen/codegen.h"
 #include "ir/ir_module.h"
 #include "jit/jit_module.h"
+#include "jit/aot_module.h"
 
 #include "pass/pass.h"
 #include "pass/optimization/constant_folding.h"
@@ -208,6 +209,17 @@ class Program {
                                  program_name_);
   }
 
+  /// Export the program into `directory` as a library (shared, else static)
+  /// and a C header for services to link, see AotModule. Tensors but the ones
+  /// in `external` live in the workspace, if any are given.
+  std::string Export(std::string directory, bool shared = true,
+                     std::vector<IRNodeKey> external = {}) {
+    AotModule aot(module_, program_name_);
+    if (!external.empty()) aot.PlanMemory(external);
+    return shared ? aot.ExportSharedLibrary(directory)
+                  : aot.ExportStaticLibrary(directory);
+  }
+
   void GenerateCuda() {
     CodeGenCuda codegen;
     std::cout << codegen.genCode(module_.GetRoot(), module_.GetTensors());
@@ -218,6 +230,16 @@ class Program {
         static_cast<IRHandle>(tensor->GetIRHandle()));
   }
 
+  void DeclareConstant(Constant *constant) {
+    for (auto &declared : module_.GetConstants()) {
+      if (declared.as<ConstNode>()->name == constant->name) {
+        constant->handle_ = declared;
+        return;
+      }
+    }
+    module_.GetConstants().push_back(constant->GetIRHandle());
+  }
+
   void RunJit() {
     JitModule jit(module_);
     jit.execute();
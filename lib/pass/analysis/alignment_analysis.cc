@@ -0,0 +1,102 @@
+#include "alignment_analysis.h"
+
+namespace polly {
+
+typedef AlignmentAnalysis::Congruence Congruence;
+
+static int64_t gcd(int64_t a, int64_t b) {
+  a = a < 0 ? -a : a;
+  b = b < 0 ? -b : b;
+  while (b != 0) {
+    int64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+static Congruence normalize(Congruence x) {
+  if (x.modulus != 0) {
+    x.residue = (x.residue % x.modulus + x.modulus) % x.modulus;
+  }
+  return x;
+}
+
+static Congruence add(Congruence a, Congruence b) {
+  return normalize({gcd(a.modulus, b.modulus), a.residue + b.residue});
+}
+
+static Congruence scale(Congruence a, int64_t c) {
+  return normalize({a.modulus * (c < 0 ? -c : c), a.residue * c});
+}
+
+// The value is either `a` or `b`.
+static Congruence join(Congruence a, Congruence b) {
+  return normalize({gcd(gcd(a.modulus, b.modulus), a.residue - b.residue),
+                    a.residue});
+}
+
+Congruence AlignmentAnalysis::ComputeCongruence(IRHandle expr) {
+  const Congruence unknown = {1, 0};
+  switch (expr.Type()) {
+    case IRNodeType::INT:
+      return {0, expr.as<IntNode>()->value};
+    case IRNodeType::VAR: {
+      auto var = expr.as<VarNode>();
+      if (var->increment.Type() != IRNodeType::INT) return unknown;
+      return add(ComputeCongruence(var->min),
+                 {var->increment.as<IntNode>()->value, 0});
+    }
+    case IRNodeType::ADD:
+      return add(ComputeCongruence(expr.as<AddNode>()->lhs),
+                 ComputeCongruence(expr.as<AddNode>()->rhs));
+    case IRNodeType::SUB:
+      return add(ComputeCongruence(expr.as<SubNode>()->lhs),
+                 scale(ComputeCongruence(expr.as<SubNode>()->rhs), -1));
+    case IRNodeType::MUL: {
+      auto lhs = ComputeCongruence(expr.as<MulNode>()->lhs);
+      auto rhs = ComputeCongruence(expr.as<MulNode>()->rhs);
+      if (lhs.modulus == 0) return scale(rhs, lhs.residue);
+      if (rhs.modulus == 0) return scale(lhs, rhs.residue);
+      return unknown;
+    }
+    case IRNodeType::MIN:
+      return join(ComputeCongruence(expr.as<MinNode>()->lhs),
+                  ComputeCongruence(expr.as<MinNode>()->rhs));
+    case IRNodeType::MAX:
+      return join(ComputeCongruence(expr.as<MaxNode>()->lhs),
+                  ComputeCongruence(expr.as<MaxNode>()->rhs));
+    default:
+      return unknown;
+  }
+}
+
+bool AlignmentAnalysis::isAligned(IRHandle data, int length) {
+  if (base_alignment_ % (length * 4) != 0) return false;
+  if (data.Type() != IRNodeType::ACCESS) return false;
+  auto access = data.as<AccessNode>();
+  auto &shape = access->tensor.as<TensorNode>()->shape;
+
+  // Row-major flat offset, in elements.
+  Congruence offset = {0, 0};
+  int64_t stride = 1;
+  for (int i = access->indices.size() - 1; i >= 0; i--) {
+    offset = add(offset, scale(ComputeCongruence(access->indices[i]), stride));
+    stride *= shape[i];
+  }
+  return offset.modulus % length == 0 && offset.residue % length == 0;
+}
+
+void AlignmentAnalysis::enter(IRHandle node) {
+  if (node.Type() == IRNodeType::VEC_LOAD) {
+    auto load = node.as<VecLoadNode>();
+    load->aligned = isAligned(load->data, load->length);
+    aligned_ += load->aligned;
+  } else if (node.Type() == IRNodeType::VEC_STORE) {
+    auto store = node.as<VecStoreNode>();
+    store->aligned = isAligned(store->data, store->length);
+    aligned_ += store->aligned;
+  }
+}
+
+}  // namespace polly
@@ -0,0 +1,86 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-21 09:47:15
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-21 09:47:15
+ * @CopyRight: Qiming Zheng
+ */
+
+#pragma once
+
+#include "common.h"
+#include "pass/pass.h"
+#include "ir/ir.h"
+#include "ir/ir_visitor.h"
+
+namespace polly {
+
+/*!
+ * \brief The AlignmentAnalysis marks the VecLoad and VecStore nodes whose
+ * addresses are provably multiples of the vector size, so that backends can
+ * use aligned memory instructions for them.
+ *
+ * The flat offset of every access is summarized as a congruence
+ * `offset = residue (mod modulus)` over all iterations: a looping variable
+ * is congruent to its lower bound modulo its increment, and congruences
+ * propagate through additions and multiplications by constants. An access of
+ * `length` lanes is aligned if both the modulus and the residue are multiples
+ * of `length`, and the tensor base is aligned to the vector size.
+ *
+ * \param program The program, or a loop of it.
+ * \param base_alignment The alignment in bytes every tensor buffer has.
+ */
+class AlignmentAnalysis : public Pass, public IRRecursiveVisitor {
+  AlignmentAnalysis(IRHandle program, int base_alignment)
+      : base_alignment_(base_alignment), aligned_(0) {
+    program.accept(this);
+  }
+
+ public:
+  /// Tensors start on a cache line, see BufferAllocator and MemoryPlan.
+  static const int DefaultBaseAlignment = 64;
+
+  static PassRetHandle runPass(PassArgHandle arg) {
+    AlignmentAnalysis analysis(PassArg::as<Arg>(arg)->program,
+                               PassArg::as<Arg>(arg)->base_alignment);
+    return Ret::create(analysis.aligned_);
+  }
+
+  void enter(IRHandle node) override;
+
+  /// `value = residue (mod modulus)`; a modulus of 0 means `value = residue`.
+  struct Congruence {
+    int64_t modulus, residue;
+  };
+  static Congruence ComputeCongruence(IRHandle expr);
+
+  struct Arg : public PassArg {
+    IRHandle program;
+    int base_alignment;
+    Arg() {}
+    Arg(IRHandle p, int b) : program(p), base_alignment(b) {}
+    static PassArgHandle create(IRHandle program,
+                                int base_alignment = DefaultBaseAlignment) {
+      return std::shared_ptr<Arg>(new Arg(program, base_alignment));
+    }
+  };
+
+  struct Ret : public PassRet {
+    // The number of vector accesses marked aligned.
+    int aligned;
+    static PassRetHandle create(int aligned) {
+      auto ret = std::shared_ptr<Ret>(new Ret);
+      ret->aligned = aligned;
+      return ret;
+    }
+  };
+
+ private:
+  bool isAligned(IRHandle access, int length);
+
+  int base_alignment_;
+  int aligned_;
+};
+
+}  // namespace polly
@@ -15,8 +15,20 @@ solver::AccessMap DataDependencyModel::BuildAccessMap(solver::context &ctx,
     indices_names.push_back("x" + std::to_string(i));
   }
 
+  // Symbolic constants in the bounds or the indices are isl parameters.
+  std::set<std::string> params;
+  for (auto &param : st.iters_.GetParams()) params.insert(param);
+  for (auto &index : acc.access.indices_) {
+    for (auto &it : index.coeffs) {
+      if (std::find(iter_names.begin(), iter_names.end(), it.first) ==
+          iter_names.end())
+        params.insert(it.first);
+    }
+  }
+
   solver::AccessMap ret = solver::AccessMap(
-      ctx, st.statementName, iter_names, acc.access.arrayName_, indices_names);
+      ctx, st.statementName, iter_names, acc.access.arrayName_, indices_names,
+      std::vector<std::string>(params.begin(), params.end()));
 
   for (int i = 0; i < acc.access.indices_.size(); i++) {
     std::map<std::string, int> ind = acc.access.indices_[i].coeffs;
@@ -0,0 +1,81 @@
+#include "memory_planner.h"
+
+namespace polly {
+
+const int64_t MemoryPlan::Alignment;
+
+MemoryPlanner::MemoryPlanner(IRHandle program, std::vector<IRHandle> &tensors,
+                             std::set<IRNodeKey> &external) {
+  if (program.Type() != IRNodeType::FUNC) {
+    throw std::runtime_error("MemoryPlanner: expect a FuncNode");
+  }
+  auto func = program.as<FuncNode>();
+  for (stage_ = 0; stage_ < func->body.size(); stage_++) {
+    func->body[stage_].accept(this);
+  }
+  pack(tensors, external);
+  SetStatus(Pass::PassStatus::VALID);
+}
+
+void MemoryPlanner::access(IRHandle tensor) {
+  LiveRange &range = ranges_[tensor.as<TensorNode>()->id];
+  if (range.first_stage == -1) range.first_stage = stage_;
+  range.last_stage = stage_;
+}
+
+void MemoryPlanner::enter(IRHandle node) {
+  if (node.Type() == IRNodeType::ACCESS) {
+    access(node.as<AccessNode>()->tensor);
+  }
+}
+
+void MemoryPlanner::pack(std::vector<IRHandle> &tensors,
+                         std::set<IRNodeKey> &external) {
+  std::vector<MemoryPlan::Allocation> candidates;
+  for (int i = 0; i < tensors.size(); i++) {
+    auto tensor = tensors[i].as<TensorNode>();
+    auto it = ranges_.find(tensor->id);
+    // Unused tensors keep their own storage.
+    if (external.count(tensor->id) || it == ranges_.end()) continue;
+    int64_t size = 1;
+    for (auto dim : tensor->shape) size *= dim;
+    candidates.push_back(
+        {tensor->id, 0, size, it->second.first_stage, it->second.last_stage});
+    plan_.unplanned_size += size;
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const MemoryPlan::Allocation &a,
+                      const MemoryPlan::Allocation &b) {
+                     return a.size > b.size;
+                   });
+
+  for (auto &candidate : candidates) {
+    std::vector<MemoryPlan::Allocation> live;
+    for (auto &placed : plan_.allocations) {
+      if (placed.last_stage < candidate.first_stage ||
+          candidate.last_stage < placed.first_stage)
+        continue;
+      live.push_back(placed);
+    }
+    std::sort(live.begin(), live.end(),
+              [](const MemoryPlan::Allocation &a,
+                 const MemoryPlan::Allocation &b) {
+                return a.offset < b.offset;
+              });
+    // First fit: the lowest aligned offset that leaves every live neighbour
+    // untouched.
+    int64_t offset = 0;
+    for (auto &placed : live) {
+      if (offset + candidate.size <= placed.offset) break;
+      int64_t end = placed.offset + placed.size;
+      end = (end + MemoryPlan::Alignment - 1) / MemoryPlan::Alignment *
+            MemoryPlan::Alignment;
+      offset = std::max(offset, end);
+    }
+    candidate.offset = offset;
+    plan_.allocations.push_back(candidate);
+    plan_.slab_size = std::max(plan_.slab_size, offset + candidate.size);
+  }
+}
+
+}  // namespace polly
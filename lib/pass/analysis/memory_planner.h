@@ -0,0 +1,113 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-14 10:12:37
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-14 10:12:37
+ * @CopyRight: Qiming Zheng
+ */
+
+#pragma once
+
+#include "common.h"
+#include "pass/pass.h"
+#include "ir/ir.h"
+#include "ir/ir_visitor.h"
+
+namespace polly {
+
+/*!
+ * \brief Placement of the intermediate tensors of a program in one shared
+ * slab. Sizes and offsets are in elements; offsets are multiples of
+ * `Alignment` so that every tensor starts on a cache line.
+ *
+ * Tensor storage is zero-initialized, so a backend must zero the slice of
+ * every allocation when its first stage starts.
+ */
+struct MemoryPlan {
+  static const int64_t Alignment = 16;
+
+  struct Allocation {
+    IRNodeKey tensor;
+    int64_t offset;
+    int64_t size;
+    /// The live range, in top-level statements of the FuncNode body.
+    int first_stage, last_stage;
+  };
+
+  std::vector<Allocation> allocations;
+  /// Size of the shared slab.
+  int64_t slab_size = 0;
+  /// Memory the same tensors take without sharing.
+  int64_t unplanned_size = 0;
+
+  const Allocation *Find(const IRNodeKey &tensor) const {
+    for (auto &allocation : allocations) {
+      if (allocation.tensor == tensor) return &allocation;
+    }
+    return nullptr;
+  }
+};
+
+/*!
+ * \brief The MemoryPlanner computes the live range of every tensor over the
+ * top-level statements (stages) of the FuncNode body, and packs the
+ * intermediate tensors into a single slab: tensors whose live ranges do not
+ * overlap may share memory. Tensors are placed largest first at the lowest
+ * offset that does not collide with a live neighbour.
+ *
+ * \param program The FuncNode of the program.
+ * \param tensors All tensors of the program.
+ * \param external Tensors that are visible outside of the program (inputs,
+ * outputs, caller-owned memory); they are never packed.
+ */
+class MemoryPlanner : public Pass, public IRRecursiveVisitor {
+  MemoryPlanner(IRHandle program, std::vector<IRHandle> &tensors,
+                std::set<IRNodeKey> &external);
+
+ public:
+  static PassRetHandle runPass(PassArgHandle arg) {
+    auto planner_arg = PassArg::as<Arg>(arg);
+    MemoryPlanner planner(planner_arg->program, planner_arg->tensors,
+                          planner_arg->external);
+    return Ret::create(planner.plan_);
+  }
+
+  void enter(IRHandle node) override;
+
+  struct Arg : public PassArg {
+    IRHandle program;
+    std::vector<IRHandle> tensors;
+    std::set<IRNodeKey> external;
+    Arg() {}
+    Arg(IRHandle p, std::vector<IRHandle> t, std::set<IRNodeKey> e)
+        : program(p), tensors(t), external(e) {}
+    static PassArgHandle create(IRHandle program, std::vector<IRHandle> tensors,
+                                std::set<IRNodeKey> external) {
+      return std::shared_ptr<Arg>(new Arg(program, tensors, external));
+    }
+  };
+
+  struct Ret : public PassRet {
+    MemoryPlan plan;
+    static PassRetHandle create(MemoryPlan plan) {
+      auto ret = std::shared_ptr<Ret>(new Ret);
+      ret->plan = plan;
+      return ret;
+    }
+  };
+
+ private:
+  struct LiveRange {
+    int first_stage = -1, last_stage = -1;
+  };
+
+  void access(IRHandle tensor);
+  void pack(std::vector<IRHandle> &tensors, std::set<IRNodeKey> &external);
+
+  int stage_;
+  std::map<IRNodeKey, LiveRange> ranges_;
+  MemoryPlan plan_;
+};
+
+}  // namespace polly
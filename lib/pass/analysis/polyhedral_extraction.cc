@@ -8,6 +8,27 @@
 
 namespace polly {
 
+// The accesses and values a statement reads, leaving out the ones inside
+// indices. The arithmetic around them, e.g. a Select, is not modelled.
+class StmtReadHelper : public IRRecursiveVisitor {
+ public:
+  void enter(IRHandle node) override {
+    if (node.Type() == IRNodeType::VALUE && depth_ == 0) reads.push_back(node);
+    if (node.Type() != IRNodeType::ACCESS) return;
+    if (depth_ == 0) reads.push_back(node);
+    depth_ += 1;
+  }
+  void exit(IRHandle node) override {
+    if (node.Type() == IRNodeType::ACCESS) depth_ -= 1;
+  }
+  // The bounds of the variable are no reads.
+  void visitVar(VarHandle var) override {}
+  std::vector<IRHandle> reads;
+
+ private:
+  int depth_ = 0;
+};
+
 void PolyhedralExtraction::visitInt(IntHandle int_expr) {
   workspace.clear();
   workspace.expr.constant = int_expr->value;
@@ -151,7 +172,9 @@ void PolyhedralExtraction::visitAssign(AssignmentHandle assign) {
         statementName));
   }
   affineAccesses.clear();
-  assign->rhs.accept(this);
+  StmtReadHelper helper;
+  assign->rhs.accept(&helper);
+  for (auto &read : helper.reads) read.accept(this);
   for (int i = 0; i < affineAccesses.size(); i++) {
     accesses.push_back(ArrayAccess(
         ArrayDomain(ArrayDomain::AccessType::READ, affineAccesses[i].first,
@@ -211,6 +234,11 @@ void PolyhedralExtraction::visitFor(ForHandle loop) {
   loops.pop_back();
 }
 
+void PolyhedralExtraction::visitConst(ConstHandle con) {
+  workspace.clear();
+  workspace.expr.coeffs[con->name] = 1;
+}
+
 void PolyhedralExtraction::visitPrint(PrintHandle print) {
   /// Pass
   StatementKey statementName = print->id;
@@ -218,7 +246,9 @@ void PolyhedralExtraction::visitPrint(PrintHandle print) {
   std::vector<ArrayAccess> accesses;
 
   affineAccesses.clear();
-  print->print.accept(this);
+  StmtReadHelper helper;
+  print->print.accept(&helper);
+  for (auto &read : helper.reads) read.accept(this);
   for (int i = 0; i < affineAccesses.size(); i++) {
     accesses.push_back(ArrayAccess(
         ArrayDomain(ArrayDomain::AccessType::READ, affineAccesses[i].first,
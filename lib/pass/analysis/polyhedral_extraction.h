@@ -73,6 +73,7 @@ class PolyhedralExtraction : public IRNotImplementedVisitor {
   void visitVal(ValHandle val) override;
   void visitDecl(DeclHandle decl) override;
   void visitFor(ForHandle loop) override;
+  void visitConst(ConstHandle con) override;
   void visitPrint(PrintHandle print) override;
   void visitFunc(FuncHandle func) override;
 
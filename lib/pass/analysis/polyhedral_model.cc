@@ -7,6 +7,12 @@ IRHandle ReorderedBounds::IslConstraintToBound(solver::constraint c,
   bool is_negative;
   QuasiAffineExpr expr;
   expr.constant = c.get_constant().integer();
+  for (int i = 0; i < c.get_dim(isl_dim_param); i++) {
+    if (c.get_coefficient(isl_dim_param, i).integer() != 0) {
+      expr.coeffs[c.get_dim_name(isl_dim_param, i)] =
+          c.get_coefficient(isl_dim_param, i).integer();
+    }
+  }
   for (int i = 0; i < c.get_dim(isl_dim_set); i++) {
     if (c.get_coefficient(isl_dim_set, i).integer() != 0) {
       auto dim_name = c.get_dim_name(isl_dim_set, i);
@@ -37,12 +43,19 @@ IRHandle ReorderedBounds::IslConstraintToBound(solver::constraint c,
 IRHandle ReorderedBounds::QuasiAffineExprToIR(QuasiAffineExpr expr) {
   std::vector<IRHandle> muls;
   for (auto it : expr.coeffs) {
+    bool is_loop_var = false;
     for (int i = 0; i < loop_vars.size(); i++) {
       if (loop_vars[i].as<VarNode>()->id == it.first) {
         muls.push_back(MulNode::make(loop_vars[i], IntNode::make(it.second)));
+        is_loop_var = true;
         break;
       }
     }
+    // The others are the symbolic constants carried as isl parameters.
+    if (!is_loop_var) {
+      muls.push_back(
+          MulNode::make(ConstNode::make(it.first), IntNode::make(it.second)));
+    }
   }
   muls.push_back(IntNode::make(expr.constant));
   while (muls.size() > 1) {
@@ -69,7 +82,8 @@ void ReorderedBounds::GetReorderedBound(std::vector<IRHandle> loop_vars_,
   for (int i = 0; i < loop_vars.size(); i++) {
     iter_names.push_back(loop_vars[i].as<VarNode>()->id);
   }
-  solver::IterSet polyhedral(ctx, "S", iter_names);
+  solver::IterSet polyhedral(ctx, "S", iter_names,
+                             IterDomain(extractedIters).GetParams());
 
   for (int i = 0; i < extractedIters.size(); i++) {
     for (auto lb : extractedIters[i].lowerBounds_) {
@@ -146,7 +160,8 @@ bool EmptyBounds::IsEmptyPolyhedral(std::vector<IRHandle> loop_vars,
   for (int i = 0; i < loop_vars.size(); i++) {
     iter_names.push_back(loop_vars[i].as<VarNode>()->id);
   }
-  solver::IterSet polyhedral(ctx, "S", iter_names);
+  solver::IterSet polyhedral(ctx, "S", iter_names,
+                             IterDomain(extractedIters).GetParams());
 
   for (int i = 0; i < extractedIters.size(); i++) {
     for (auto lb : extractedIters[i].lowerBounds_) {
@@ -23,7 +23,9 @@ typedef std::string ArrayKey;
 /*!
  * \brief QuasiAffineExpr describes a linear combination of variables. It
  * represents formulas in the form of: (\sum_{i = 1}^{n} c_i x_i + c_0) / d,
- * where c_i is constant integer coefficients, x_i is integer variable.
+ * where c_i is constant integer coefficients, x_i is integer variable. A
+ * symbolic constant (see ConstNode) is keyed by its name like a variable, and
+ * becomes a parameter of the isl sets.
  */
 class QuasiAffineExpr {
  public:
@@ -118,6 +120,25 @@ class IterDomain {
   }
   std::vector<Iteration> iterations_;
 
+  /// Symbolic constants the bounds refer to, i.e. the non-iteration keys.
+  std::vector<std::string> GetParams() {
+    std::set<std::string> iters, params;
+    for (auto &iteration : iterations_) iters.insert(iteration.iterName_);
+    for (auto &iteration : iterations_) {
+      for (auto &bound : iteration.lowerBounds_) {
+        for (auto &it : bound.coeffs) {
+          if (iters.count(it.first) == 0) params.insert(it.first);
+        }
+      }
+      for (auto &bound : iteration.upperBounds_) {
+        for (auto &it : bound.coeffs) {
+          if (iters.count(it.first) == 0) params.insert(it.first);
+        }
+      }
+    }
+    return std::vector<std::string>(params.begin(), params.end());
+  }
+
   std::string DbgMsg() {
     std::string ret = "";
     for (int i = 0; i < iterations_.size(); i++) {
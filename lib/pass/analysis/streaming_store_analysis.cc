@@ -0,0 +1,89 @@
+#include "streaming_store_analysis.h"
+
+namespace polly {
+
+// Whether the looping variable `var` occurs in `expr`.
+static bool UsesVar(IRHandle expr, IRNodeKey var) {
+  switch (expr.Type()) {
+    case IRNodeType::VAR:
+      return expr.as<VarNode>()->id == var;
+    case IRNodeType::ADD:
+    case IRNodeType::SUB:
+    case IRNodeType::MUL:
+    case IRNodeType::DIV:
+    case IRNodeType::MOD:
+    case IRNodeType::MIN:
+    case IRNodeType::MAX:
+      return UsesVar(expr.as<BinaryNode>()->lhs, var) ||
+             UsesVar(expr.as<BinaryNode>()->rhs, var);
+    default:
+      return false;
+  }
+}
+
+StreamingStoreAnalysis::StreamingStoreAnalysis(IRHandle program,
+                                               int64_t min_bytes)
+    : streamed_(0) {
+  program.accept(this);
+
+  for (auto &it : uses_) {
+    auto &use = it.second;
+    if (use.scalar_stores != 0 || use.stores.size() != 1) continue;
+    // Every access is the one of the store.
+    if (use.accesses != 1) continue;
+    auto store = use.stores[0];
+    if (!store->aligned) continue;
+
+    auto access = store->data.as<AccessNode>();
+    int64_t bytes = sizeof(float);
+    for (auto dim : access->tensor.as<TensorNode>()->shape) bytes *= dim;
+    if (bytes < min_bytes) continue;
+
+    bool moves = true;
+    for (auto &var : use.loops[0]) {
+      bool used = false;
+      for (auto &index : access->indices) used |= UsesVar(index, var);
+      moves &= used;
+    }
+    if (!moves) continue;
+
+    store->nontemporal = true;
+    streamed_ += 1;
+  }
+}
+
+void StreamingStoreAnalysis::enter(IRHandle node) {
+  switch (node.Type()) {
+    case IRNodeType::FOR:
+      looping_vars_.push_back(
+          node.as<ForNode>()->looping_var_.as<VarNode>()->id);
+      break;
+    case IRNodeType::ACCESS:
+      uses_[node.as<AccessNode>()->tensor.as<TensorNode>()->id].accesses += 1;
+      break;
+    case IRNodeType::ASSIGN: {
+      auto lhs = node.as<AssignmentNode>()->lhs;
+      if (lhs.Type() != IRNodeType::ACCESS) break;
+      uses_[lhs.as<AccessNode>()->tensor.as<TensorNode>()->id].scalar_stores +=
+          1;
+      break;
+    }
+    case IRNodeType::VEC_STORE: {
+      auto store = node.as<VecStoreNode>();
+      if (store->data.Type() != IRNodeType::ACCESS) break;
+      auto &use =
+          uses_[store->data.as<AccessNode>()->tensor.as<TensorNode>()->id];
+      use.stores.push_back(store);
+      use.loops.push_back(looping_vars_);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void StreamingStoreAnalysis::exit(IRHandle node) {
+  if (node.Type() == IRNodeType::FOR) looping_vars_.pop_back();
+}
+
+}  // namespace polly
@@ -0,0 +1,86 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-28 14:12:06
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-28 14:12:06
+ * @CopyRight: Qiming Zheng
+ */
+
+#pragma once
+
+#include "common.h"
+#include "pass/pass.h"
+#include "ir/ir.h"
+#include "ir/ir_visitor.h"
+
+namespace polly {
+
+/*!
+ * \brief The StreamingStoreAnalysis marks the VecStore nodes of write-once
+ * output tensors non-temporal, so that backends store them around the caches
+ * instead of reading every line for ownership first, e.g. `A(i) = i * 2`.
+ *
+ * A tensor is streamed if it is not read anywhere in the program, it is
+ * written by a single aligned VecStore, and every loop enclosing that store
+ * moves its address. Smaller tensors are left in the cache, the next stage
+ * is likely to read them from there.
+ *
+ * Alignment must be known already, see AlignmentAnalysis.
+ *
+ * \param program The whole program, tensors read outside of it are missed.
+ * \param min_bytes The size in bytes from which tensors are streamed.
+ */
+class StreamingStoreAnalysis : public Pass, public IRRecursiveVisitor {
+  StreamingStoreAnalysis(IRHandle program, int64_t min_bytes);
+
+ public:
+  /// About the size of a private L2 cache.
+  static const int64_t DefaultMinBytes = 1 << 20;
+
+  static PassRetHandle runPass(PassArgHandle arg) {
+    StreamingStoreAnalysis analysis(PassArg::as<Arg>(arg)->program,
+                                    PassArg::as<Arg>(arg)->min_bytes);
+    return Ret::create(analysis.streamed_);
+  }
+
+  void enter(IRHandle node) override;
+  void exit(IRHandle node) override;
+
+  struct Arg : public PassArg {
+    IRHandle program;
+    int64_t min_bytes;
+    Arg() {}
+    Arg(IRHandle p, int64_t m) : program(p), min_bytes(m) {}
+    static PassArgHandle create(IRHandle program,
+                                int64_t min_bytes = DefaultMinBytes) {
+      return std::shared_ptr<Arg>(new Arg(program, min_bytes));
+    }
+  };
+
+  struct Ret : public PassRet {
+    // The number of vector stores marked non-temporal.
+    int streamed;
+    static PassRetHandle create(int streamed) {
+      auto ret = std::shared_ptr<Ret>(new Ret);
+      ret->streamed = streamed;
+      return ret;
+    }
+  };
+
+ private:
+  // The accesses and the stores of a tensor.
+  struct TensorUse {
+    int accesses = 0;
+    int scalar_stores = 0;
+    std::vector<VecStoreHandle> stores;
+    // The looping variables enclosing each of `stores`.
+    std::vector<std::vector<IRNodeKey>> loops;
+  };
+
+  std::map<IRNodeKey, TensorUse> uses_;
+  std::vector<IRNodeKey> looping_vars_;
+  int streamed_;
+};
+
+}  // namespace polly
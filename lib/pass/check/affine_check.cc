@@ -181,4 +181,19 @@ void AffineCheck::visitMax(MaxHandle max) {
   }
 }
 
+void AffineCheck::visitSelect(SelectHandle select) {
+  // Indices are never selected.
+  if (!firstTimeEntering) {
+    isAffine = false;
+    return;
+  }
+  select->lhs.accept(this);
+  if (!isAffine) return;
+  select->rhs.accept(this);
+  if (!isAffine) return;
+  select->true_value.accept(this);
+  if (!isAffine) return;
+  select->false_value.accept(this);
+}
+
 }  // namespace polly
\ No newline at end of file
@@ -66,6 +66,7 @@ class AffineCheck : public IRNotImplementedVisitor, public Pass {
 
   void visitMin(MinHandle min) override;
   void visitMax(MaxHandle max) override;
+  void visitSelect(SelectHandle select) override;
 
   struct Arg : public PassArg {
     IRHandle program;
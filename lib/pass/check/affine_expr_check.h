@@ -90,6 +90,7 @@ class IsAffineIRHandle : public IRNotImplementedVisitor, public Pass {
     }
   }
   void visitVar(VarHandle var) override { isAffine = true; }
+  void visitConst(ConstHandle con) override { isAffine = true; }
   void visitAccess(AccessHandle access) override { isAffine = false; }
   void visitTensor(TensorHandle tensor) override { isAffine = false; }
 
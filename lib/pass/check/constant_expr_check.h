@@ -61,6 +61,8 @@ class IsConstantIRHandle : public IRNotImplementedVisitor, public Pass {
     mod->rhs.accept(this);
   }
   void visitVar(VarHandle var) override { isConstant = false; }
+  // Only known when the program runs.
+  void visitConst(ConstHandle con) override { isConstant = false; }
   void visitAccess(AccessHandle access) override { isConstant = false; }
   void visitTensor(TensorHandle tensor) override { isConstant = false; }
 
@@ -0,0 +1,130 @@
+#include "constant_extent_check.h"
+
+namespace polly {
+
+ConstantExtentCheck::ConstantExtentCheck(
+    IRHandle program, const std::map<std::string, int64_t> &values)
+    : values_(values) {
+  program.accept(this);
+  SetStatus(Pass::PassStatus::VALID);
+}
+
+ConstantExtentCheck::Range ConstantExtentCheck::evaluate(IRHandle expr) {
+  Range range;
+  switch (expr.Type()) {
+    case IRNodeType::INT:
+      range.lo = range.hi = expr.as<IntNode>()->value;
+      range.known = true;
+      return range;
+    case IRNodeType::CONST: {
+      auto it = values_.find(expr.as<ConstNode>()->name);
+      if (it == values_.end()) return range;
+      range.lo = range.hi = it->second;
+      range.known = range.symbolic = true;
+      return range;
+    }
+    case IRNodeType::VAR: {
+      auto it = ranges_.find(expr.as<VarNode>()->id);
+      return it == ranges_.end() ? range : it->second;
+    }
+    case IRNodeType::ADD:
+    case IRNodeType::SUB:
+    case IRNodeType::MUL:
+    case IRNodeType::DIV:
+    case IRNodeType::MOD:
+    case IRNodeType::MIN:
+    case IRNodeType::MAX:
+      break;
+    default:
+      return range;
+  }
+
+  auto binary = expr.as<BinaryNode>();
+  Range lhs = evaluate(binary->lhs), rhs = evaluate(binary->rhs);
+  if (!lhs.known || !rhs.known) return range;
+  range.known = true;
+  range.symbolic = lhs.symbolic || rhs.symbolic;
+  switch (expr.Type()) {
+    case IRNodeType::ADD:
+      range.lo = lhs.lo + rhs.lo;
+      range.hi = lhs.hi + rhs.hi;
+      break;
+    case IRNodeType::SUB:
+      range.lo = lhs.lo - rhs.hi;
+      range.hi = lhs.hi - rhs.lo;
+      break;
+    case IRNodeType::MUL: {
+      int64_t products[] = {lhs.lo * rhs.lo, lhs.lo * rhs.hi, lhs.hi * rhs.lo,
+                            lhs.hi * rhs.hi};
+      range.lo = *std::min_element(products, products + 4);
+      range.hi = *std::max_element(products, products + 4);
+      break;
+    }
+    // Division and modulo are only bounded by a positive literal divisor.
+    case IRNodeType::DIV:
+      if (rhs.lo != rhs.hi || rhs.lo <= 0) return Range();
+      range.lo = lhs.lo / rhs.lo;
+      range.hi = lhs.hi / rhs.lo;
+      break;
+    case IRNodeType::MOD:
+      if (rhs.lo != rhs.hi || rhs.lo <= 0 || lhs.lo < 0) return Range();
+      range.lo = lhs.hi < rhs.lo ? lhs.lo : 0;
+      range.hi = std::min(lhs.hi, rhs.lo - 1);
+      break;
+    case IRNodeType::MIN:
+      range.lo = std::min(lhs.lo, rhs.lo);
+      range.hi = std::min(lhs.hi, rhs.hi);
+      break;
+    case IRNodeType::MAX:
+      range.lo = std::max(lhs.lo, rhs.lo);
+      range.hi = std::max(lhs.hi, rhs.hi);
+      break;
+    default:
+      break;
+  }
+  return range;
+}
+
+/// The looping var ranges over [min, max - 1]. A loop that cannot run with
+/// the given values makes no access at all.
+void ConstantExtentCheck::visitFor(ForHandle loop) {
+  auto var = loop->looping_var_.as<VarNode>();
+  Range min = evaluate(var->min), max = evaluate(var->max);
+  Range increment = evaluate(var->increment);
+  Range range;
+  if (min.known && max.known && increment.known && increment.lo > 0) {
+    if (max.hi <= min.lo) return;
+    range.lo = min.lo;
+    range.hi = max.hi - 1;
+    range.known = true;
+    range.symbolic = min.symbolic || max.symbolic;
+  }
+
+  auto outer = ranges_.find(var->id);
+  bool shadowed = outer != ranges_.end();
+  Range saved = shadowed ? outer->second : Range();
+  ranges_[var->id] = range;
+  for (auto &stmt : loop->body) stmt.accept(this);
+  if (shadowed) {
+    ranges_[var->id] = saved;
+  } else {
+    ranges_.erase(var->id);
+  }
+}
+
+void ConstantExtentCheck::visitAccess(AccessHandle access) {
+  auto tensor = access->tensor.as<TensorNode>();
+  for (int i = 0; i < access->indices.size() && i < tensor->shape.size(); i++) {
+    Range index = evaluate(access->indices[i]);
+    if (!index.known || !index.symbolic || !violation_.empty()) continue;
+    if (index.lo < 0 || index.hi >= tensor->shape[i]) {
+      violation_ = "access to tensor " + tensor->id + " reaches index " +
+                   std::to_string(index.lo < 0 ? index.lo : index.hi) +
+                   " of dimension " + std::to_string(i) + ", which holds " +
+                   std::to_string(tensor->shape[i]);
+    }
+  }
+  IRRecursiveVisitor::visitAccess(access);
+}
+
+}  // namespace polly
@@ -0,0 +1,84 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-16 14:05:12
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-16 14:05:12
+ * @CopyRight: Qiming Zheng
+ */
+
+#pragma once
+
+#include "common.h"
+#include "pass/pass.h"
+#include "ir/ir.h"
+#include "ir/ir_visitor.h"
+
+namespace polly {
+
+/*!
+ * \brief Checks that the accesses of a program stay inside the static shape of
+ * their tensors once its constants take the given values. Tensor shapes are
+ * the capacity of the loop extents that depend on constants, which are only
+ * known when the program runs.
+ *
+ * The range of every index is derived from the ranges of the enclosing loops
+ * by interval arithmetic. Only the indices whose range depends on a constant
+ * are checked; an index the analysis cannot bound is accepted.
+ *
+ * \param program The FuncNode of the program.
+ * \param values The value of every constant.
+ */
+class ConstantExtentCheck : public Pass, public IRRecursiveVisitor {
+  ConstantExtentCheck(IRHandle program,
+                      const std::map<std::string, int64_t> &values);
+
+ public:
+  static PassRetHandle runPass(PassArgHandle arg) {
+    auto check_arg = PassArg::as<Arg>(arg);
+    ConstantExtentCheck checker(check_arg->program, check_arg->values);
+    return Ret::create(checker.violation_);
+  }
+
+  void visitFor(ForHandle loop) override;
+  void visitAccess(AccessHandle access) override;
+
+  struct Arg : public PassArg {
+    IRHandle program;
+    std::map<std::string, int64_t> values;
+    Arg() {}
+    Arg(IRHandle p, std::map<std::string, int64_t> v) : program(p), values(v) {}
+    static PassArgHandle create(IRHandle program,
+                                std::map<std::string, int64_t> values) {
+      return std::shared_ptr<Arg>(new Arg(program, values));
+    }
+  };
+
+  struct Ret : public PassRet {
+    /// The first out-of-bounds access found, empty if there is none.
+    std::string violation;
+    static PassRetHandle create(std::string violation) {
+      auto ret = std::shared_ptr<Ret>(new Ret);
+      ret->violation = violation;
+      return ret;
+    }
+  };
+
+ private:
+  /// The values an expression can take, [lo, hi].
+  struct Range {
+    int64_t lo = 0, hi = 0;
+    bool known = false;
+    /// Whether the range depends on a constant.
+    bool symbolic = false;
+  };
+
+  Range evaluate(IRHandle expr);
+
+  const std::map<std::string, int64_t> &values_;
+  /// Ranges of the looping vars of the enclosing loops.
+  std::map<IRNodeKey, Range> ranges_;
+  std::string violation_;
+};
+
+}  // namespace polly
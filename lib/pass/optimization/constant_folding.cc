@@ -166,6 +166,7 @@ class ConstantFoldingEvaluator : public IRNotImplementedVisitor {
   void visitConst(ConstHandle con) { t = value_type::DEFAULT; }
   void visitPrint(PrintHandle print) { t = value_type::DEFAULT; }
   void visitFunc(FuncHandle func) { t = value_type::DEFAULT; }
+  void visitSelect(SelectHandle select) { t = value_type::DEFAULT; }
 
   void visitMin(MinHandle min) {
     t = value_type::DEFAULT;
@@ -577,4 +578,15 @@ void ConstantFoldingPass::visitMax(MaxHandle max) {
   max->rhs = simplify(max->rhs);
 }
 
+void ConstantFoldingPass::visitSelect(SelectHandle select) {
+  ConstantFoldingEvaluator evaluator;
+  for (auto *operand : {&select->lhs, &select->rhs, &select->true_value,
+                        &select->false_value}) {
+    operand->accept(this);
+    IRHandle value = evaluator.Evaluate(*operand);
+    if (value != NullIRHandle) *operand = value;
+    *operand = simplify(*operand);
+  }
+}
+
 }  // namespace polly
\ No newline at end of file
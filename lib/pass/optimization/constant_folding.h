@@ -70,6 +70,7 @@ class ConstantFoldingPass : public Pass, public IRNotImplementedVisitor {
 
   void visitMin(MinHandle min) override;
   void visitMax(MaxHandle max) override;
+  void visitSelect(SelectHandle select) override;
 
   struct Arg : public PassArg {
     IRHandle program;
@@ -0,0 +1,61 @@
+#include "fma_fusion.h"
+
+namespace polly {
+
+void FMAFusion::fuse(std::vector<IRHandle> &body) {
+  VecUseCounter counter;
+  for (auto &stmt : body) {
+    stmt.accept(&counter);
+  }
+
+  for (int i = 0; i < body.size(); i++) {
+    if (body[i].Type() != IRNodeType::VEC_MUL) continue;
+    auto mul = body[i].as<VecMulNode>();
+    // Defined here and read exactly once, so the product is not needed on
+    // its own.
+    if (counter.counts[mul->vec.as<VecNode>()->id] != 2) continue;
+
+    for (int j = i + 1; j < body.size(); j++) {
+      if (body[j].Type() != IRNodeType::VEC_ADD) continue;
+      auto add = body[j].as<VecAddNode>();
+      IRHandle addend;
+      if (add->lhs.equals(mul->vec)) {
+        addend = add->rhs;
+      } else if (add->rhs.equals(mul->vec)) {
+        addend = add->lhs;
+      } else {
+        continue;
+      }
+      if (add->length != mul->length) break;
+
+      // The product has a single use, this VecAdd, so the VecMul folds into
+      // it. The factors still hold their values here: only reduction
+      // accumulators are reassigned, each by the VecAdd updating it.
+      body[j] = VecFMANode::make(add->vec, mul->lhs, mul->rhs, addend,
+                                 add->length);
+      body.erase(body.begin() + i);
+      i -= 1;
+      fused_ += 1;
+      break;
+    }
+  }
+}
+
+void FMAFusion::visitFor(ForHandle loop) {
+  for (auto &stmt : loop->body) {
+    if (stmt.Type() == IRNodeType::FOR) {
+      stmt.accept(this);
+    }
+  }
+  fuse(loop->body);
+}
+
+void FMAFusion::visitFunc(FuncHandle func) {
+  for (auto &stmt : func->body) {
+    if (stmt.Type() == IRNodeType::FOR) {
+      stmt.accept(this);
+    }
+  }
+}
+
+}  // namespace polly
@@ -0,0 +1,75 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-20 15:12:08
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-20 15:12:08
+ * @CopyRight: Qiming Zheng
+ */
+#pragma once
+
+#include "common.h"
+#include "ir/ir.h"
+#include "ir/ir_visitor.h"
+#include "pass/pass.h"
+
+namespace polly {
+
+// Fuse a VecMul whose only use is a following VecAdd of the same loop body
+// into one VecFMA, i.e.
+//   t = a * b; r = t + c;  ->  r = fma(a, b, c);
+// The pass is meant to run on vectorized loops, see LoopVectorization.
+class FMAFusion : public Pass, public IRNotImplementedVisitor {
+  FMAFusion(IRHandle program) : program_(program), fused_(0) {
+    program_.accept(this);
+  }
+
+ public:
+  constexpr static PassKey id = FMAFusionPassID;
+
+  static PassRetHandle runPass(PassArgHandle arg) {
+    FMAFusion fusion(PassArg::as<Arg>(arg)->program);
+    return Ret::create(fusion.fused_);
+  }
+
+  void visitFor(ForHandle loop) override;
+  void visitFunc(FuncHandle func) override;
+
+  struct Arg : public PassArg {
+    IRHandle program;
+    Arg() {}
+    Arg(IRHandle p) : program(p) {}
+    static PassArgHandle create(IRHandle program) {
+      return std::shared_ptr<Arg>(new Arg(program));
+    }
+  };
+
+  struct Ret : public PassRet {
+    // The number of VecMul nodes folded into a VecFMA.
+    int fused;
+    static PassRetHandle create(int fused) {
+      auto ret = std::shared_ptr<Ret>(new Ret);
+      ret->fused = fused;
+      return ret;
+    }
+  };
+
+ private:
+  void fuse(std::vector<IRHandle> &body);
+
+  IRHandle program_;
+  int fused_;
+};
+
+// Count the occurrences of every vector register, the definition included.
+class VecUseCounter : public IRRecursiveVisitor {
+ public:
+  void enter(IRHandle node) override {
+    if (node.Type() == IRNodeType::VEC) {
+      counts[node.as<VecNode>()->id]++;
+    }
+  }
+  std::map<IRNodeKey, int> counts;
+};
+
+}  // namespace polly
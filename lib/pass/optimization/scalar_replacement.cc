@@ -0,0 +1,372 @@
+#include "scalar_replacement.h"
+
+namespace polly {
+
+static bool IsVecStmt(IRHandle node) {
+  switch (node.Type()) {
+    case IRNodeType::VEC_SCALAR:
+    case IRNodeType::VEC_LOAD:
+    case IRNodeType::VEC_BROADCAST_LOAD:
+    case IRNodeType::VEC_GATHER:
+    case IRNodeType::VEC_STORE:
+    case IRNodeType::VEC_ADD:
+    case IRNodeType::VEC_SUB:
+    case IRNodeType::VEC_MUL:
+    case IRNodeType::VEC_DIV:
+    case IRNodeType::VEC_FMA:
+    case IRNodeType::VEC_MIN:
+    case IRNodeType::VEC_MAX:
+    case IRNodeType::VEC_COMPARE:
+    case IRNodeType::VEC_BLEND:
+    case IRNodeType::VEC_REDUCE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static IRNodeKey TensorOf(IRHandle access) {
+  return access.as<AccessNode>()->tensor.as<TensorNode>()->id;
+}
+
+// The accesses, looping variables and parallel loops under a loop.
+class LoopContentHelper : public IRRecursiveVisitor {
+ public:
+  explicit LoopContentHelper(IRHandle loop) { loop.accept(this); }
+
+  void enter(IRHandle node) override {
+    if (IsVecStmt(node)) {
+      vec_depth_ += 1;
+      vectorized = true;
+    }
+    switch (node.Type()) {
+      case IRNodeType::FOR:
+        loop_vars.insert(node.as<ForNode>()->looping_var_.as<VarNode>()->id);
+        parallel |= node.as<ForNode>()->annotation.parallelization;
+        break;
+      case IRNodeType::ASSIGN:
+        assigns.push_back(node);
+        break;
+      case IRNodeType::ACCESS:
+        accesses.push_back({node, vec_depth_ == 0 && access_depth_ == 0});
+        access_depth_ += 1;
+        break;
+      default:
+        break;
+    }
+  }
+  void exit(IRHandle node) override {
+    if (IsVecStmt(node)) vec_depth_ -= 1;
+    if (node.Type() == IRNodeType::ACCESS) access_depth_ -= 1;
+  }
+
+  std::vector<IRHandle> assigns;
+  // Every access, and whether it is a plain scalar one, i.e. neither the
+  // operand of a vector statement nor part of the indices of another access.
+  std::vector<std::pair<IRHandle, bool>> accesses;
+  std::set<IRNodeKey> loop_vars;
+  bool parallel = false;
+  bool vectorized = false;
+
+ private:
+  int vec_depth_ = 0;
+  int access_depth_ = 0;
+};
+
+// The looping variables an expression reads, and whether it reads anything
+// else which may change, i.e. values or memory.
+class IndexUseHelper : public IRRecursiveVisitor {
+ public:
+  void enter(IRHandle node) override {
+    if (node.Type() == IRNodeType::VAR) {
+      vars.insert(node.as<VarNode>()->id);
+    }
+    if (node.Type() == IRNodeType::VALUE || node.Type() == IRNodeType::ACCESS) {
+      opaque = true;
+    }
+  }
+  std::set<IRNodeKey> vars;
+  bool opaque = false;
+};
+
+// Whether `access` addresses the same element whatever the values of the
+// looping variables `vars`.
+static bool IsInvariant(IRHandle access, const std::set<IRNodeKey> &vars) {
+  for (auto &index : access.as<AccessNode>()->indices) {
+    IndexUseHelper helper;
+    index.accept(&helper);
+    if (helper.opaque) return false;
+    for (auto &var : helper.vars) {
+      if (vars.count(var)) return false;
+    }
+  }
+  return true;
+}
+
+// `expr` with the looping variable `var` replaced by `value`, built from new
+// nodes wherever it changes, and always a new node for an access.
+static IRHandle Substitute(IRHandle expr, IRNodeKey var, IRHandle value) {
+  switch (expr.Type()) {
+    case IRNodeType::VAR:
+      return expr.as<VarNode>()->id == var ? value : expr;
+    case IRNodeType::ACCESS: {
+      auto access = expr.as<AccessNode>();
+      std::vector<IRHandle> indices;
+      for (auto &index : access->indices) {
+        indices.push_back(Substitute(index, var, value));
+      }
+      return AccessNode::make(access->tensor, indices);
+    }
+    case IRNodeType::ADD:
+    case IRNodeType::SUB:
+    case IRNodeType::MUL:
+    case IRNodeType::DIV:
+    case IRNodeType::MOD:
+    case IRNodeType::MIN:
+    case IRNodeType::MAX: {
+      auto binary = expr.as<BinaryNode>();
+      auto lhs = Substitute(binary->lhs, var, value);
+      auto rhs = Substitute(binary->rhs, var, value);
+      switch (expr.Type()) {
+        case IRNodeType::ADD:
+          return AddNode::make(lhs, rhs);
+        case IRNodeType::SUB:
+          return SubNode::make(lhs, rhs);
+        case IRNodeType::MUL:
+          return MulNode::make(lhs, rhs);
+        case IRNodeType::DIV:
+          return DivNode::make(lhs, rhs);
+        case IRNodeType::MOD:
+          return ModNode::make(lhs, rhs);
+        case IRNodeType::MIN:
+          return MinNode::make(lhs, rhs);
+        default:
+          return MaxNode::make(lhs, rhs);
+      }
+    }
+    default:
+      return expr;
+  }
+}
+
+// A loop of vector statements whose constant bounds make it run once.
+static bool IsSingleVecIteration(IRHandle stmt) {
+  if (stmt.Type() != IRNodeType::FOR) return false;
+  auto loop = stmt.as<ForNode>();
+  auto var = loop->looping_var_.as<VarNode>();
+  if (var->min.Type() != IRNodeType::INT) return false;
+  if (var->max.Type() != IRNodeType::INT) return false;
+  if (var->increment.Type() != IRNodeType::INT) return false;
+  if (var->max.as<IntNode>()->value - var->min.as<IntNode>()->value !=
+      var->increment.as<IntNode>()->value)
+    return false;
+  if (loop->body.empty()) return false;
+  for (auto &s : loop->body) {
+    if (!IsVecStmt(s)) return false;
+  }
+  return true;
+}
+
+// The vector register a vector statement assigns, nullptr for a store or a
+// reduction.
+static IRHandle *VecDef(IRHandle stmt) {
+  switch (stmt.Type()) {
+    case IRNodeType::VEC_SCALAR:
+      return &stmt.as<VecScalarNode>()->vec;
+    case IRNodeType::VEC_LOAD:
+      return &stmt.as<VecLoadNode>()->vec;
+    case IRNodeType::VEC_BROADCAST_LOAD:
+      return &stmt.as<VecBroadCastLoadNode>()->vec;
+    case IRNodeType::VEC_GATHER:
+      return &stmt.as<VecGatherNode>()->vec;
+    case IRNodeType::VEC_ADD:
+      return &stmt.as<VecAddNode>()->vec;
+    case IRNodeType::VEC_SUB:
+      return &stmt.as<VecSubNode>()->vec;
+    case IRNodeType::VEC_MUL:
+      return &stmt.as<VecMulNode>()->vec;
+    case IRNodeType::VEC_DIV:
+      return &stmt.as<VecDivNode>()->vec;
+    case IRNodeType::VEC_FMA:
+      return &stmt.as<VecFMANode>()->vec;
+    case IRNodeType::VEC_MIN:
+      return &stmt.as<VecMinNode>()->vec;
+    case IRNodeType::VEC_MAX:
+      return &stmt.as<VecMaxNode>()->vec;
+    case IRNodeType::VEC_COMPARE:
+      return &stmt.as<VecCompareNode>()->vec;
+    case IRNodeType::VEC_BLEND:
+      return &stmt.as<VecBlendNode>()->vec;
+    default:
+      return nullptr;
+  }
+}
+
+// The vector registers a vector statement reads.
+static std::vector<IRHandle *> VecReads(IRHandle stmt) {
+  switch (stmt.Type()) {
+    case IRNodeType::VEC_STORE:
+      return {&stmt.as<VecStoreNode>()->vec};
+    case IRNodeType::VEC_ADD:
+      return {&stmt.as<VecAddNode>()->lhs, &stmt.as<VecAddNode>()->rhs};
+    case IRNodeType::VEC_SUB:
+      return {&stmt.as<VecSubNode>()->lhs, &stmt.as<VecSubNode>()->rhs};
+    case IRNodeType::VEC_MUL:
+      return {&stmt.as<VecMulNode>()->lhs, &stmt.as<VecMulNode>()->rhs};
+    case IRNodeType::VEC_DIV:
+      return {&stmt.as<VecDivNode>()->lhs, &stmt.as<VecDivNode>()->rhs};
+    case IRNodeType::VEC_FMA:
+      return {&stmt.as<VecFMANode>()->a, &stmt.as<VecFMANode>()->b,
+              &stmt.as<VecFMANode>()->c};
+    case IRNodeType::VEC_MIN:
+      return {&stmt.as<VecMinNode>()->lhs, &stmt.as<VecMinNode>()->rhs};
+    case IRNodeType::VEC_MAX:
+      return {&stmt.as<VecMaxNode>()->lhs, &stmt.as<VecMaxNode>()->rhs};
+    case IRNodeType::VEC_COMPARE:
+      return {&stmt.as<VecCompareNode>()->lhs,
+              &stmt.as<VecCompareNode>()->rhs};
+    case IRNodeType::VEC_BLEND:
+      return {&stmt.as<VecBlendNode>()->mask,
+              &stmt.as<VecBlendNode>()->true_value,
+              &stmt.as<VecBlendNode>()->false_value};
+    case IRNodeType::VEC_REDUCE:
+      return {&stmt.as<VecReduceNode>()->vec};
+    default:
+      return {};
+  }
+}
+
+int ScalarReplacement::promoteScalar(std::vector<IRHandle> &body, int pos) {
+  LoopContentHelper content(body[pos]);
+  // IRMutatorVisitor does not know vector statements.
+  if (content.parallel || content.vectorized) return -1;
+
+  for (auto &assign : content.assigns) {
+    auto target = assign.as<AssignmentNode>()->lhs;
+    if (target.Type() != IRNodeType::ACCESS) continue;
+    if (!IsInvariant(target, content.loop_vars)) continue;
+    bool alone = true;
+    for (auto &access : content.accesses) {
+      if (TensorOf(access.first) != TensorOf(target)) continue;
+      if (!access.second || !access.first.equals(target)) alone = false;
+    }
+    if (!alone) continue;
+
+    auto gen = IRNodeKeyGen::GetInstance();
+    auto access = target.as<AccessNode>();
+    auto val = ValNode::make(gen->YieldValKey(), looping_vars_);
+    IRMutatorVisitor mutator(target, val);
+    mutator.visit(body[pos]);
+
+    body.insert(body.begin() + pos,
+                {DeclNode::make(gen->YieldStatementKey(), val),
+                 AssignmentNode::make(
+                     gen->YieldStatementKey(), val,
+                     AccessNode::make(access->tensor, access->indices))});
+    pos += 2;
+    body.insert(body.begin() + pos + 1,
+                AssignmentNode::make(
+                    gen->YieldStatementKey(),
+                    AccessNode::make(access->tensor, access->indices), val));
+    return pos;
+  }
+  return -1;
+}
+
+int ScalarReplacement::promoteVector(std::vector<IRHandle> &body, int pos) {
+  LoopContentHelper content(body[pos]);
+  if (content.parallel) return -1;
+
+  for (auto &stmt : body[pos].as<ForNode>()->body) {
+    if (!IsSingleVecIteration(stmt)) continue;
+    auto var = stmt.as<ForNode>()->looping_var_.as<VarNode>();
+    auto &stmts = stmt.as<ForNode>()->body;
+
+    for (int s = 0; s < stmts.size(); s++) {
+      if (stmts[s].Type() != IRNodeType::VEC_STORE) continue;
+      auto store = stmts[s].as<VecStoreNode>();
+      // The element the single iteration stores to.
+      auto target = Substitute(store->data, var->id, var->min);
+      if (!IsInvariant(target, content.loop_vars)) continue;
+
+      // Besides the store, the loop may only load the same element, before.
+      int load = -1;
+      for (int t = 0; t < s; t++) {
+        if (stmts[t].Type() == IRNodeType::VEC_LOAD &&
+            stmts[t].as<VecLoadNode>()->data.equals(store->data)) {
+          load = t;
+        }
+      }
+      int uses = 0;
+      for (auto &access : content.accesses) {
+        uses += TensorOf(access.first) == TensorOf(target);
+      }
+      if (uses != (load >= 0 ? 2 : 1)) continue;
+
+      // The stored register takes over the loaded one, so it has to be
+      // assigned once the loaded one is no longer read.
+      auto stored = store->vec;
+      auto loaded = load >= 0 ? stmts[load].as<VecLoadNode>()->vec : stored;
+      int def = -1, last_read = load;
+      for (int t = 0; t < stmts.size(); t++) {
+        auto d = VecDef(stmts[t]);
+        if (d != nullptr && d->equals(stored)) def = t;
+        for (auto read : VecReads(stmts[t])) {
+          if (load >= 0 && read->equals(loaded)) last_read = t;
+        }
+      }
+      if (def < 0 || def < last_read) continue;
+      if (load >= 0 && stored.equals(loaded)) continue;
+
+      auto acc = VecNode::make(IRNodeKeyGen::GetInstance()->YieldVecKey(),
+                               store->length);
+      for (auto &t : stmts) {
+        std::vector<IRHandle *> operands = VecReads(t);
+        if (VecDef(t) != nullptr) operands.push_back(VecDef(t));
+        for (auto operand : operands) {
+          if (operand->equals(stored) || operand->equals(loaded)) {
+            *operand = acc;
+          }
+        }
+      }
+      stmts.erase(stmts.begin() + s);
+      if (load >= 0) stmts.erase(stmts.begin() + load);
+
+      body.insert(body.begin() + pos, VecLoadNode::make(acc, target,
+                                                        store->length,
+                                                        store->aligned));
+      pos += 1;
+      body.insert(body.begin() + pos + 1,
+                  VecStoreNode::make(acc,
+                                     Substitute(store->data, var->id, var->min),
+                                     store->length, store->aligned,
+                                     store->nontemporal));
+      return pos;
+    }
+  }
+  return -1;
+}
+
+void ScalarReplacement::promote(std::vector<IRHandle> &body) {
+  for (int pos = 0; pos < body.size(); pos++) {
+    if (body[pos].Type() != IRNodeType::FOR) continue;
+    body[pos].accept(this);
+    while (true) {
+      int next = promoteScalar(body, pos);
+      if (next < 0) next = promoteVector(body, pos);
+      if (next < 0) break;
+      pos = next;
+      promoted_ += 1;
+    }
+  }
+}
+
+void ScalarReplacement::visitFor(ForHandle loop) {
+  looping_vars_.push_back(loop->looping_var_);
+  promote(loop->body);
+  looping_vars_.pop_back();
+}
+
+void ScalarReplacement::visitFunc(FuncHandle func) { promote(func->body); }
+
+}  // namespace polly
@@ -0,0 +1,78 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-24 10:41:37
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-24 10:41:37
+ * @CopyRight: Qiming Zheng
+ */
+#pragma once
+
+#include "common.h"
+#include "ir/ir.h"
+#include "ir/ir_visitor.h"
+#include "pass/pass.h"
+
+namespace polly {
+
+// Keep an access that is invariant in a loop in a register for the whole
+// loop, i.e. for the reduction of a GEMM
+//   for k: C[i][j] = C[i][j] + A[i][k] * B[k][j];
+// becomes
+//   float x; x = C[i][j];
+//   for k: x = x + A[i][k] * B[k][j];
+//   C[i][j] = x;
+// The access must be the only one of its tensor inside the loop. Vectorized
+// code is promoted the same way into a vector register when its loop runs a
+// single iteration per iteration of the enclosing loop, e.g. a 8-wide inner
+// split of `j` below `k`. Loops are promoted inner-most first, and loops
+// which are or contain parallel loops are left alone.
+// The pass is meant to run once the schedule is final, see Mutator::Vectorize.
+class ScalarReplacement : public Pass, public IRNotImplementedVisitor {
+  ScalarReplacement(IRHandle program) : program_(program), promoted_(0) {
+    program_.accept(this);
+  }
+
+ public:
+  constexpr static PassKey id = ScalarReplacementPassID;
+
+  static PassRetHandle runPass(PassArgHandle arg) {
+    ScalarReplacement replacement(PassArg::as<Arg>(arg)->program);
+    return Ret::create(replacement.promoted_);
+  }
+
+  void visitFor(ForHandle loop) override;
+  void visitFunc(FuncHandle func) override;
+
+  struct Arg : public PassArg {
+    IRHandle program;
+    Arg() {}
+    Arg(IRHandle p) : program(p) {}
+    static PassArgHandle create(IRHandle program) {
+      return std::shared_ptr<Arg>(new Arg(program));
+    }
+  };
+
+  struct Ret : public PassRet {
+    // The number of accesses kept in a register.
+    int promoted;
+    static PassRetHandle create(int promoted) {
+      auto ret = std::shared_ptr<Ret>(new Ret);
+      ret->promoted = promoted;
+      return ret;
+    }
+  };
+
+ private:
+  void promote(std::vector<IRHandle> &body);
+  // Promote one access of the loop `body[pos]`, returning the new position of
+  // the loop, or -1 if nothing could be promoted.
+  int promoteScalar(std::vector<IRHandle> &body, int pos);
+  int promoteVector(std::vector<IRHandle> &body, int pos);
+
+  IRHandle program_;
+  int promoted_;
+  std::vector<IRHandle> looping_vars_;
+};
+
+}  // namespace polly
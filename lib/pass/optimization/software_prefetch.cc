@@ -0,0 +1,150 @@
+#include "software_prefetch.h"
+#include "pass/analysis/polyhedral_extraction.h"
+#include "pass/check/affine_expr_check.h"
+
+namespace polly {
+
+// The accesses of a statement, leaving out the ones inside indices, and the
+// number of consecutive elements each of them reads or writes.
+class StmtAccessHelper : public IRRecursiveVisitor {
+ public:
+  void enter(IRHandle node) override {
+    if (node.Type() == IRNodeType::VEC_LOAD) {
+      width_ = node.as<VecLoadNode>()->length;
+    } else if (node.Type() == IRNodeType::VEC_STORE) {
+      width_ = node.as<VecStoreNode>()->length;
+    }
+    if (node.Type() != IRNodeType::ACCESS) return;
+    if (depth_ == 0) {
+      accesses.push_back(node);
+      widths.push_back(width_);
+    }
+    depth_ += 1;
+  }
+  void exit(IRHandle node) override {
+    if (node.Type() == IRNodeType::VEC_LOAD ||
+        node.Type() == IRNodeType::VEC_STORE) {
+      width_ = 1;
+    }
+    if (node.Type() == IRNodeType::ACCESS) depth_ -= 1;
+  }
+  std::vector<IRHandle> accesses;
+  std::vector<int> widths;
+
+ private:
+  int depth_ = 0;
+  int width_ = 1;
+};
+
+// Whether PolyhedralExtraction takes an index: no modulo, no min/max, and
+// nothing but looping variables and constants.
+class IndexFormHelper : public IRRecursiveVisitor {
+ public:
+  void enter(IRHandle node) override {
+    switch (node.Type()) {
+      case IRNodeType::MOD:
+      case IRNodeType::MIN:
+      case IRNodeType::MAX:
+      case IRNodeType::ACCESS:
+      case IRNodeType::VALUE:
+      case IRNodeType::FLOAT:
+        supported = false;
+        break;
+      default:
+        break;
+    }
+  }
+  // The bounds of the variable do not matter.
+  void visitVar(VarHandle var) override {}
+  bool supported = true;
+};
+
+// A loop with constant bounds running a single iteration.
+static bool RunsOnce(IRHandle stmt) {
+  auto var = stmt.as<ForNode>()->looping_var_.as<VarNode>();
+  if (var->min.Type() != IRNodeType::INT) return false;
+  if (var->max.Type() != IRNodeType::INT) return false;
+  if (var->increment.Type() != IRNodeType::INT) return false;
+  int trips = var->max.as<IntNode>()->value - var->min.as<IntNode>()->value;
+  return trips > 0 && trips <= var->increment.as<IntNode>()->value;
+}
+
+int64_t SoftwarePrefetch::ElementStride(IRHandle access, IRNodeKey var) {
+  auto node = access.as<AccessNode>();
+  auto &shape = node->tensor.as<TensorNode>()->shape;
+  int64_t stride = 0, row = 1;
+  for (int i = node->indices.size() - 1; i >= 0; i--) {
+    IndexFormHelper form;
+    node->indices[i].accept(&form);
+    if (!form.supported) return 0;
+    if (!IsAffineIRHandle(node->indices[i]).isAffine) return 0;
+    auto expr = PolyhedralExtraction::IRHandleToQuasiAffine(node->indices[i]);
+    auto it = expr.coeffs.find(var);
+    if (it != expr.coeffs.end() && it->second != 0) {
+      if (expr.divisor != 1) return 0;
+      stride += it->second * row;
+    }
+    row *= shape[i];
+  }
+  return stride;
+}
+
+void SoftwarePrefetch::prefetch(ForHandle loop, std::vector<IRHandle> &body) {
+  auto var = loop->looping_var_.as<VarNode>();
+  if (var->increment.Type() != IRNodeType::INT) return;
+  int increment = var->increment.as<IntNode>()->value;
+
+  std::vector<IRHandle> prefetches;
+  for (auto &stmt : body) {
+    if (stmt.Type() == IRNodeType::FOR) {
+      if (RunsOnce(stmt)) prefetch(loop, stmt.as<ForNode>()->body);
+      continue;
+    }
+    if (stmt.Type() == IRNodeType::PREFETCH) continue;
+
+    StmtAccessHelper helper;
+    stmt.accept(&helper);
+    for (int i = 0; i < helper.accesses.size(); i++) {
+      auto &access = helper.accesses[i];
+      int64_t stride = ElementStride(access, var->id) * increment;
+      if (std::abs(stride) < CacheLineFloats) continue;
+      // A stream moving by no more than the elements it touches is
+      // contiguous, the hardware prefetcher follows it.
+      if (std::abs(stride) <= helper.widths[i]) continue;
+
+      // The access `distance_` iterations ahead.
+      auto tensor = access.as<AccessNode>()->tensor;
+      std::map<IRNodeKey, IRHandle> dict;
+      dict[tensor.as<TensorNode>()->id] = tensor;
+      dict[var->id] = AddNode::make(loop->looping_var_,
+                                    IntNode::make(distance_ * increment));
+      auto ahead = access.clone(dict);
+
+      bool seen = false;
+      for (auto &other : prefetches) seen |= other.equals(ahead);
+      if (!seen) prefetches.push_back(ahead);
+    }
+  }
+
+  for (int i = prefetches.size() - 1; i >= 0; i--) {
+    body.insert(body.begin(), PrefetchNode::make(prefetches[i]));
+  }
+  inserted_ += prefetches.size();
+}
+
+void SoftwarePrefetch::visitFor(ForHandle loop) {
+  for (auto &stmt : loop->body) {
+    if (stmt.Type() == IRNodeType::FOR) stmt.accept(this);
+  }
+  // A loop running once has no next iteration, its body is prefetched for the
+  // enclosing loop.
+  if (!RunsOnce(IRHandle(loop))) prefetch(loop, loop->body);
+}
+
+void SoftwarePrefetch::visitFunc(FuncHandle func) {
+  for (auto &stmt : func->body) {
+    if (stmt.Type() == IRNodeType::FOR) stmt.accept(this);
+  }
+}
+
+}  // namespace polly
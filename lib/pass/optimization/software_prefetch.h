@@ -0,0 +1,86 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-26 16:03:52
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-26 16:03:52
+ * @CopyRight: Qiming Zheng
+ */
+#pragma once
+
+#include "common.h"
+#include "ir/ir.h"
+#include "ir/ir_visitor.h"
+#include "pass/pass.h"
+
+namespace polly {
+
+// Prefetch the accesses of a loop which move by a cache line or more every
+// iteration, e.g. `B[k][j]` walking down the columns of B in the `k` loop of
+// a GEMM, which hardware prefetchers follow poorly if at all:
+//   for k: C[i][j] = C[i][j] + A[i][k] * B[k][j];
+// becomes
+//   for k: prefetch B[k + distance][j]; C[i][j] = ...;
+// `distance` counts iterations ahead and is tuned by the auto-scheduler, see
+// SearchStrategy::Prefetch. Strides come from the quasi-affine form of the
+// indices, see PolyhedralExtraction. The body of an inner loop running a
+// single iteration, such as a vectorized inner split, counts as part of the
+// body of the enclosing loop. Contiguous streams, which move by no more than
+// the elements they touch, e.g. the vector loads of a loop stepping by the
+// vector length, are left to the hardware prefetcher.
+// The pass is meant to run last, after ScalarReplacement.
+class SoftwarePrefetch : public Pass, public IRNotImplementedVisitor {
+  SoftwarePrefetch(IRHandle program, int distance)
+      : program_(program), distance_(distance), inserted_(0) {
+    if (distance_ > 0) program_.accept(this);
+  }
+
+ public:
+  constexpr static PassKey id = SoftwarePrefetchPassID;
+  constexpr static int CacheLineFloats = 16;
+
+  static PassRetHandle runPass(PassArgHandle arg) {
+    SoftwarePrefetch prefetch(PassArg::as<Arg>(arg)->program,
+                              PassArg::as<Arg>(arg)->distance);
+    return Ret::create(prefetch.inserted_);
+  }
+
+  /// The number of elements between the elements `access` addresses for two
+  /// consecutive values of the looping variable `var`, 0 if `access` does not
+  /// move with `var` affinely.
+  static int64_t ElementStride(IRHandle access, IRNodeKey var);
+
+  void visitFor(ForHandle loop) override;
+  void visitFunc(FuncHandle func) override;
+
+  struct Arg : public PassArg {
+    IRHandle program;
+    int distance;
+    Arg() {}
+    Arg(IRHandle p, int d) : program(p), distance(d) {}
+    static PassArgHandle create(IRHandle program, int distance) {
+      return std::shared_ptr<Arg>(new Arg(program, distance));
+    }
+  };
+
+  struct Ret : public PassRet {
+    // The number of prefetches inserted.
+    int inserted;
+    static PassRetHandle create(int inserted) {
+      auto ret = std::shared_ptr<Ret>(new Ret);
+      ret->inserted = inserted;
+      return ret;
+    }
+  };
+
+ private:
+  // Prefetch the strided accesses of `body` for `loop`, then those of the
+  // single-iteration loops in it.
+  void prefetch(ForHandle loop, std::vector<IRHandle> &body);
+
+  IRHandle program_;
+  int distance_;
+  int inserted_;
+};
+
+}  // namespace polly
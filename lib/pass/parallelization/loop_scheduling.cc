@@ -0,0 +1,114 @@
+#include "loop_scheduling.h"
+
+namespace polly {
+
+/// Whether `expr` refers to any of `vars`.
+static bool Uses(IRHandle expr, const std::set<IRNodeKey> &vars) {
+  switch (expr.Type()) {
+    case IRNodeType::VAR:
+      return vars.count(expr.as<VarNode>()->id) > 0;
+    case IRNodeType::ADD:
+    case IRNodeType::SUB:
+    case IRNodeType::MUL:
+    case IRNodeType::DIV:
+    case IRNodeType::MOD:
+    case IRNodeType::MIN:
+    case IRNodeType::MAX:
+      return Uses(expr.as<BinaryNode>()->lhs, vars) ||
+             Uses(expr.as<BinaryNode>()->rhs, vars);
+    default:
+      return false;
+  }
+}
+
+static bool BoundsUse(IRHandle loop, const std::set<IRNodeKey> &vars) {
+  auto var = loop.as<ForNode>()->looping_var_.as<VarNode>();
+  return Uses(var->min, vars) || Uses(var->max, vars) ||
+         Uses(var->increment, vars);
+}
+
+class UnevenBoundsHelper : public IRRecursiveVisitor {
+ public:
+  bool uneven = false;
+  UnevenBoundsHelper(IRHandle loop, const std::set<IRNodeKey> &vars)
+      : vars(vars) {
+    loop.accept(this);
+  }
+  void enter(IRHandle node) override {
+    if (node.Type() == IRNodeType::FOR) uneven |= BoundsUse(node, vars);
+  }
+
+ private:
+  const std::set<IRNodeKey> &vars;
+};
+
+int LoopScheduling::CollapsibleDepth(IRHandle loop) {
+  std::set<IRNodeKey> vars;
+  int depth = 1;
+  while (true) {
+    auto node = loop.as<ForNode>();
+    vars.insert(node->looping_var_.as<VarNode>()->id);
+    if (node->body.size() != 1 || node->body[0].Type() != IRNodeType::FOR)
+      break;
+    if (BoundsUse(node->body[0], vars)) break;
+    loop = node->body[0];
+    depth++;
+  }
+  return depth;
+}
+
+int64_t LoopScheduling::TripCount(IRHandle loop) {
+  auto var = loop.as<ForNode>()->looping_var_.as<VarNode>();
+  if (var->min.Type() != IRNodeType::INT ||
+      var->max.Type() != IRNodeType::INT ||
+      var->increment.Type() != IRNodeType::INT)
+    return -1;
+  int64_t min = var->min.as<IntNode>()->value;
+  int64_t max = var->max.as<IntNode>()->value;
+  int64_t increment = var->increment.as<IntNode>()->value;
+  if (increment <= 0) return -1;
+  return max > min ? (max - min + increment - 1) / increment : 0;
+}
+
+void LoopScheduling::visitFor(ForHandle loop) {
+  if (!loop->annotation.parallelization) {
+    for (int i = 0; i < loop->body.size(); i++) {
+      if (loop->body[i].Type() == IRNodeType::FOR) {
+        loop->body[i].accept(this);
+      }
+    }
+    return;
+  }
+
+  // The parallel loops nested in this one run serially, see CodeGenC.
+  auto &annotation = loop->annotation;
+  int depth = CollapsibleDepth(IRHandle(loop));
+  std::set<IRNodeKey> vars = {loop->looping_var_.as<VarNode>()->id};
+  int64_t trips = TripCount(IRHandle(loop));
+  IRHandle inner = IRHandle(loop);
+  annotation.collapse = 1;
+  while (annotation.collapse < depth && trips >= 0 &&
+         trips < MinTripsPerWorker * num_workers_) {
+    inner = inner.as<ForNode>()->body[0];
+    if (!inner.as<ForNode>()->annotation.parallelization) break;
+    int64_t inner_trips = TripCount(inner);
+    trips = inner_trips < 0 ? -1 : trips * inner_trips;
+    vars.insert(inner.as<ForNode>()->looping_var_.as<VarNode>()->id);
+    annotation.collapse++;
+  }
+
+  UnevenBoundsHelper helper(IRHandle(loop), vars);
+  annotation.schedule = helper.uneven ? LoopAnnotation::Schedule::DYNAMIC
+                                      : LoopAnnotation::Schedule::STATIC;
+  annotation.chunk = 0;
+}
+
+void LoopScheduling::visitFunc(FuncHandle func) {
+  for (int i = 0; i < func->body.size(); i++) {
+    if (func->body[i].Type() == IRNodeType::FOR) {
+      func->body[i].accept(this);
+    }
+  }
+}
+
+}  // namespace polly
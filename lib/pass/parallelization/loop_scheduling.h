@@ -0,0 +1,74 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-14 10:12:37
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-14 10:12:37
+ * @CopyRight: Qiming Zheng
+ */
+
+#pragma once
+
+#include "common.h"
+#include "ir/ir.h"
+#include "ir/ir_visitor.h"
+#include "pass/pass.h"
+
+namespace polly {
+
+/*!
+ * \brief LoopScheduling picks the collapse depth and the schedule of every
+ * outer-most parallel loop (see LoopAnnotation). A loop with too few constant
+ * iterations to keep `MinTripsPerWorker` per worker is collapsed with the
+ * parallel loops perfectly nested in it. A loop whose nested bounds depend on
+ * the collapsed iterators, e.g. a triangular nest, has iterations of uneven
+ * cost and is scheduled dynamically.
+ *
+ * \param program The root node of the program.
+ * \param num_workers The number of workers sharing the parallel loops.
+ */
+class LoopScheduling : public Pass, public IRNotImplementedVisitor {
+  LoopScheduling(IRHandle program, int num_workers)
+      : num_workers_(std::max(num_workers, 1)) {
+    program.accept(this);
+  }
+
+ public:
+  static constexpr int MinTripsPerWorker = 4;
+
+  /// The number of loops, `loop` included, that can be collapsed into it:
+  /// loops perfectly nested in it whose bounds do not depend on the outer
+  /// ones.
+  static int CollapsibleDepth(IRHandle loop);
+
+  /// The trip count of a loop with constant bounds, -1 for other loops.
+  static int64_t TripCount(IRHandle loop);
+
+  void visitFor(ForHandle loop) override;
+  void visitFunc(FuncHandle func) override;
+
+  static PassRetHandle runPass(PassArgHandle arg) {
+    LoopScheduling(PassArg::as<Arg>(arg)->program,
+                     PassArg::as<Arg>(arg)->num_workers);
+    return Ret::create();
+  }
+
+  struct Arg : public PassArg {
+    IRHandle program;
+    int num_workers;
+    Arg() {}
+    Arg(IRHandle p, int n) : program(p), num_workers(n) {}
+    static PassArgHandle create(
+        IRHandle p, int n = std::thread::hardware_concurrency()) {
+      return std::shared_ptr<Arg>(new Arg(p, n));
+    }
+  };
+  struct Ret : public PassRet {
+    static PassRetHandle create() { return std::shared_ptr<Ret>(new Ret); }
+  };
+
+ private:
+  int num_workers_;
+};
+
+}  // namespace polly
@@ -103,6 +103,12 @@ class SyncParallelHelper : public IRNotImplementedVisitor {
     max->lhs = replace_if_match(max->lhs);
     max->rhs = replace_if_match(max->rhs);
   }
+  void visitSelect(SelectHandle select) override {
+    select->lhs = replace_if_match(select->lhs);
+    select->rhs = replace_if_match(select->rhs);
+    select->true_value = replace_if_match(select->true_value);
+    select->false_value = replace_if_match(select->false_value);
+  }
 };
 
 std::vector<IRHandle> SyncParallel::Adjust(
@@ -19,6 +19,9 @@ constexpr PassKey FissionPassID = 2;
 constexpr PassKey UnrollPassID = 3;
 constexpr PassKey LoopVectorizationPassID = 4;
 constexpr PassKey ConstantFoldingPassID = 5;
+constexpr PassKey FMAFusionPassID = 6;
+constexpr PassKey ScalarReplacementPassID = 7;
+constexpr PassKey SoftwarePrefetchPassID = 8;
 
 struct PassArg;
 typedef std::shared_ptr<PassArg> PassArgHandle;
@@ -57,6 +57,7 @@ class FissionTransform : public Pass, public IRNotImplementedVisitor {
 
   void visitMin(MinHandle min) override;
   void visitMax(MaxHandle max) override;
+  void visitSelect(SelectHandle select) override;
 
   IRHandle program_;
   IRHandle loop_;
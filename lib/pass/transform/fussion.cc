@@ -182,4 +182,13 @@ void FussionTransform::visitMax(MaxHandle max) {
   }
 }
 
+void FussionTransform::visitSelect(SelectHandle select) {
+  if (!searching_) {
+    select->lhs = replace_if_match(select->lhs);
+    select->rhs = replace_if_match(select->rhs);
+    select->true_value = replace_if_match(select->true_value);
+    select->false_value = replace_if_match(select->false_value);
+  }
+}
+
 }  // namespace polly
\ No newline at end of file
@@ -57,6 +57,7 @@ class FussionTransform : public Pass, public IRNotImplementedVisitor {
 
   void visitMin(MinHandle min) override;
   void visitMax(MaxHandle max) override;
+  void visitSelect(SelectHandle select) override;
 
   bool findLoop(std::vector<IRHandle>& handles, IRHandle target);
   IRHandle replace_if_match(IRHandle origin);
@@ -107,6 +107,13 @@ class NormalizationHelper : public IRNotImplementedVisitor {
     max->rhs = replace_with(max->rhs);
   }
 
+  void visitSelect(SelectHandle select) override {
+    select->lhs = replace_with(select->lhs);
+    select->rhs = replace_with(select->rhs);
+    select->true_value = replace_with(select->true_value);
+    select->false_value = replace_with(select->false_value);
+  }
+
   IRHandle replace_with(IRHandle handle) {
     if (handle.equals(loop_var_)) return replace_var_;
     handle.accept(this);
@@ -218,6 +218,15 @@ void LoopSplit::visitMax(MaxHandle max) {
   }
 }
 
+void LoopSplit::visitSelect(SelectHandle select) {
+  if (!searching_) {
+    select->lhs = replace_with(select->lhs);
+    select->rhs = replace_with(select->rhs);
+    select->true_value = replace_with(select->true_value);
+    select->false_value = replace_with(select->false_value);
+  }
+}
+
 IRHandle LoopSplit::get_outter_loop_var(IRHandle loop_var) {
   return VarNode::make(
       IRNodeKeyGen::GetInstance()->YieldVarKey(), IntNode::make(0),
@@ -381,6 +390,18 @@ class LoopSplitHelper : public IRNotImplementedVisitor {
     auto rhs = node;
     node = MaxNode::make(lhs, rhs);
   }
+
+  void visitSelect(SelectHandle select) override {
+    select->lhs.accept(this);
+    auto lhs = node;
+    select->rhs.accept(this);
+    auto rhs = node;
+    select->true_value.accept(this);
+    auto true_value = node;
+    select->false_value.accept(this);
+    auto false_value = node;
+    node = SelectNode::make(select->op, lhs, rhs, true_value, false_value);
+  }
 };
 
 IRHandle LoopSplit::create_remainder_loop(IRHandle loop,
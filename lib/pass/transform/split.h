@@ -51,6 +51,7 @@ class LoopSplit : public Pass, public IRNotImplementedVisitor {
 
   void visitMin(MinHandle min) override;
   void visitMax(MaxHandle max) override;
+  void visitSelect(SelectHandle select) override;
 
   IRHandle replace_with(IRHandle node);
 
@@ -352,6 +352,22 @@ void LoopUnroll::visitMax(MaxHandle max) {
   tape_.push(MaxNode::make(lhs, rhs));
 }
 
+void LoopUnroll::visitSelect(SelectHandle select) {
+  select->lhs.accept(this);
+  select->rhs.accept(this);
+  select->true_value.accept(this);
+  select->false_value.accept(this);
+  auto false_value = tape_.top();
+  tape_.pop();
+  auto true_value = tape_.top();
+  tape_.pop();
+  auto rhs = tape_.top();
+  tape_.pop();
+  auto lhs = tape_.top();
+  tape_.pop();
+  tape_.push(SelectNode::make(select->op, lhs, rhs, true_value, false_value));
+}
+
 IRHandle LoopUnroll::replaceVarWithInt(IRHandle node, IRHandle var,
                                        IRHandle int_expr) {
   assert(tape_.size() == 0);
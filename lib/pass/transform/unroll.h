@@ -52,6 +52,7 @@ class LoopUnroll : public Pass, public IRNotImplementedVisitor {
 
   void visitMin(MinHandle min) override;
   void visitMax(MaxHandle max) override;
+  void visitSelect(SelectHandle select) override;
 
   struct Arg : public PassArg {
     IRHandle program;
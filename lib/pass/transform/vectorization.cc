@@ -3,6 +3,105 @@
 
 namespace polly {
 
+// The looping variables an expression reads.
+class VarUseHelper : public IRRecursiveVisitor {
+ public:
+  void visitVar(VarHandle var) override { vars.insert(var->id); }
+  std::set<IRNodeKey> vars;
+};
+
+// The number of accesses to a tensor, or reads and writes of a value.
+class TargetUseHelper : public IRRecursiveVisitor {
+ public:
+  explicit TargetUseHelper(IRHandle target) : target_(target) {}
+  void enter(IRHandle node) override {
+    if (node.Type() == IRNodeType::ACCESS &&
+        target_.Type() == IRNodeType::ACCESS &&
+        node.as<AccessNode>()->tensor.as<TensorNode>()->id ==
+            target_.as<AccessNode>()->tensor.as<TensorNode>()->id)
+      uses += 1;
+    if (node.Type() == IRNodeType::VALUE &&
+        target_.Type() == IRNodeType::VALUE &&
+        node.as<ValNode>()->id == target_.as<ValNode>()->id)
+      uses += 1;
+  }
+  int uses = 0;
+
+ private:
+  IRHandle target_;
+};
+
+// The statements holding `loop` in `program`, nullptr if there are none.
+static std::vector<IRHandle> *EnclosingBody(IRHandle program, IRHandle loop) {
+  std::vector<IRHandle> *body;
+  if (program.Type() == IRNodeType::FUNC) {
+    body = &program.as<FuncNode>()->body;
+  } else if (program.Type() == IRNodeType::FOR) {
+    body = &program.as<ForNode>()->body;
+  } else {
+    return nullptr;
+  }
+  for (auto &stmt : *body) {
+    if (stmt.GetRaw() == loop.GetRaw()) return body;
+    auto inner = EnclosingBody(stmt, loop);
+    if (inner != nullptr) return inner;
+  }
+  return nullptr;
+}
+
+IRHandle LoopVectorization::ReductionOperand(IRHandle loop, IRHandle assign,
+                                             ReduceOp *op) {
+  if (assign.Type() != IRNodeType::ASSIGN) return NullIRHandle;
+  auto target = assign.as<AssignmentNode>()->lhs;
+  auto rhs = assign.as<AssignmentNode>()->rhs;
+  if (target.Type() != IRNodeType::ACCESS &&
+      target.Type() != IRNodeType::VALUE)
+    return NullIRHandle;
+
+  ReduceOp reduce;
+  switch (rhs.Type()) {
+    case IRNodeType::ADD:
+      reduce = ReduceOp::ADD;
+      break;
+    case IRNodeType::MUL:
+      reduce = ReduceOp::MUL;
+      break;
+    case IRNodeType::MIN:
+      reduce = ReduceOp::MIN;
+      break;
+    case IRNodeType::MAX:
+      reduce = ReduceOp::MAX;
+      break;
+    default:
+      return NullIRHandle;
+  }
+  // Every one of them commutes.
+  IRHandle operand;
+  if (rhs.as<BinaryNode>()->lhs.equals(target)) {
+    operand = rhs.as<BinaryNode>()->rhs;
+  } else if (rhs.as<BinaryNode>()->rhs.equals(target)) {
+    operand = rhs.as<BinaryNode>()->lhs;
+  } else {
+    return NullIRHandle;
+  }
+
+  auto var = loop.as<ForNode>()->looping_var_.as<VarNode>()->id;
+  if (target.Type() == IRNodeType::ACCESS) {
+    for (auto &index : target.as<AccessNode>()->indices) {
+      VarUseHelper helper;
+      index.accept(&helper);
+      if (helper.vars.count(var)) return NullIRHandle;
+    }
+  }
+  // The store and its read, but nothing else.
+  TargetUseHelper helper(target);
+  loop.accept(&helper);
+  if (helper.uses != 2) return NullIRHandle;
+
+  if (op != nullptr) *op = reduce;
+  return operand;
+}
+
 void LoopVectorization::visitInt(IntHandle int_expr) {
   auto vec = VecNode::make(IRNodeKeyGen::GetInstance()->YieldVecKey(), vecLen);
   vectorizationBody.push_back(
@@ -62,11 +161,42 @@ void LoopVectorization::visitMod(ModHandle mod) {
 }
 
 void LoopVectorization::visitMin(MinHandle min) {
-  throw std::runtime_error("Cannot vectorized a min operation");
+  auto res = VecNode::make(IRNodeKeyGen::GetInstance()->YieldVecKey(), vecLen);
+  min->lhs.accept(this);
+  auto lhs = node;
+  min->rhs.accept(this);
+  auto rhs = node;
+  vectorizationBody.push_back(VecMinNode::make(res, lhs, rhs, vecLen));
+  node = res;
 }
 
 void LoopVectorization::visitMax(MaxHandle max) {
-  throw std::runtime_error("Cannot vectorized a max operation");
+  auto res = VecNode::make(IRNodeKeyGen::GetInstance()->YieldVecKey(), vecLen);
+  max->lhs.accept(this);
+  auto lhs = node;
+  max->rhs.accept(this);
+  auto rhs = node;
+  vectorizationBody.push_back(VecMaxNode::make(res, lhs, rhs, vecLen));
+  node = res;
+}
+
+// Both sides are computed in every lane, and blended by the comparison.
+void LoopVectorization::visitSelect(SelectHandle select) {
+  auto mask = VecNode::make(IRNodeKeyGen::GetInstance()->YieldVecKey(), vecLen);
+  auto res = VecNode::make(IRNodeKeyGen::GetInstance()->YieldVecKey(), vecLen);
+  select->lhs.accept(this);
+  auto lhs = node;
+  select->rhs.accept(this);
+  auto rhs = node;
+  vectorizationBody.push_back(
+      VecCompareNode::make(mask, lhs, rhs, select->op, vecLen));
+  select->true_value.accept(this);
+  auto true_value = node;
+  select->false_value.accept(this);
+  auto false_value = node;
+  vectorizationBody.push_back(
+      VecBlendNode::make(res, mask, true_value, false_value, vecLen));
+  node = res;
 }
 
 void LoopVectorization::visitVar(VarHandle var) {
@@ -75,22 +205,73 @@ void LoopVectorization::visitVar(VarHandle var) {
   node = vec;
 }
 
+// Consecutive lanes of an access lie `stride` elements apart in the flattened
+// tensor: contiguous lanes are loaded at once, invariant ones broadcast, and
+// any others gathered.
 void LoopVectorization::visitAccess(AccessHandle access) {
-  QuasiAffineExpr expr =
-      PolyhedralExtraction::IRHandleToQuasiAffine(access->indices.back());
   auto vec = VecNode::make(IRNodeKeyGen::GetInstance()->YieldVecKey(), vecLen);
   auto id = loop_.as<ForNode>()->looping_var_.as<VarNode>()->id;
-  if (expr.coeffs.find(id) != expr.coeffs.end() && expr.coeffs[id] != 0) {
+  auto &shape = access->tensor.as<TensorNode>()->shape;
+  int64_t stride = 0, size = 1;
+  for (int i = access->indices.size() - 1; i >= 0; i--) {
+    QuasiAffineExpr expr =
+        PolyhedralExtraction::IRHandleToQuasiAffine(access->indices[i]);
+    if (expr.coeffs.find(id) != expr.coeffs.end()) {
+      stride += expr.coeffs[id] * size;
+    }
+    size *= shape[i];
+  }
+  if (stride == 1) {
     vectorizationBody.push_back(
         VecLoadNode::make(vec, IRHandle(access), vecLen));
-  } else {
+  } else if (stride == 0) {
     vectorizationBody.push_back(
         VecBroadCastLoadNode::make(vec, IRHandle(access), vecLen));
+  } else {
+    vectorizationBody.push_back(
+        VecGatherNode::make(vec, IRHandle(access), stride, vecLen));
   }
   node = vec;
 }
 
 void LoopVectorization::visitAssign(AssignmentHandle assign) {
+  ReduceOp op;
+  auto operand = ReductionOperand(loop_, IRHandle(assign), &op);
+  if (operand != NullIRHandle) {
+    // The lanes start from the identity of the reduction, Min and Max from
+    // the element itself.
+    auto acc =
+        VecNode::make(IRNodeKeyGen::GetInstance()->YieldVecKey(), vecLen);
+    auto target = assign->lhs;
+    if (target.Type() == IRNodeType::ACCESS) {
+      auto access = target.as<AccessNode>();
+      target = AccessNode::make(access->tensor, access->indices);
+    }
+    IRHandle init = target;
+    if (op == ReduceOp::ADD) init = FloatNode::make(0);
+    if (op == ReduceOp::MUL) init = FloatNode::make(1);
+    prologue_.push_back(VecScalarNode::make(acc, init, vecLen));
+
+    operand.accept(this);
+    switch (op) {
+      case ReduceOp::ADD:
+        vectorizationBody.push_back(VecAddNode::make(acc, acc, node, vecLen));
+        break;
+      case ReduceOp::MUL:
+        vectorizationBody.push_back(VecMulNode::make(acc, acc, node, vecLen));
+        break;
+      case ReduceOp::MIN:
+        vectorizationBody.push_back(VecMinNode::make(acc, acc, node, vecLen));
+        break;
+      default:
+        vectorizationBody.push_back(VecMaxNode::make(acc, acc, node, vecLen));
+        break;
+    }
+    epilogue_.push_back(VecReduceNode::make(acc, assign->lhs, op, vecLen));
+    node = NullIRHandle;
+    return;
+  }
+
   assign->rhs.accept(this);
   vectorizationBody.push_back(VecStoreNode::make(node, assign->lhs, vecLen));
   node = NullIRHandle;
@@ -110,6 +291,19 @@ void LoopVectorization::visitFor(ForHandle loop) {
   loop->body = vectorizationBody;
   vectorizationBody.clear();
   loop->looping_var_.as<VarNode>()->increment = IntNode::make(vecLen);
+
+  if (prologue_.empty()) return;
+  auto body = EnclosingBody(program_, loop_);
+  if (body == nullptr) {
+    throw std::runtime_error(
+        "LoopVectorization: the reduction loop is not part of the program");
+  }
+  int pos = 0;
+  while ((*body)[pos].GetRaw() != loop_.GetRaw()) pos++;
+  body->insert(body->begin() + pos + 1, epilogue_.begin(), epilogue_.end());
+  body->insert(body->begin() + pos, prologue_.begin(), prologue_.end());
+  prologue_.clear();
+  epilogue_.clear();
 }
 
 void LoopVectorization::visitConst(ConstHandle con) {
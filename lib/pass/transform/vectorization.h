@@ -20,11 +20,35 @@ namespace polly {
 // 1. Vectorization Pass should always be the last step.
 // 2. The Loop been vectorized should always be of the form:
 // 0 -> a divisible boundary by vecLen, (1)
+// 3. vecLen is 4 (SSE), 8 (AVX) or 16 (AVX-512) floats.
+// 4. Reductions into an element shared by every iteration, e.g. the `k` loop
+//    of `C(i, j) = C(i, j) + A(i, k) * B(k, j)`, accumulate vecLen partial
+//    results in a register set up ahead of the loop, and combine them into
+//    the element after it (see VecReduceNode). Sums and products are
+//    reassociated.
+// 5. Reads strided along the loop, e.g. `B(k, j)` above, load their lanes one
+//    by one (see VecGatherNode).
 class LoopVectorization : public Pass, public IRNotImplementedVisitor {
  public:
   constexpr static PassKey id = LoopVectorizationPassID;
   LoopVectorization(IRHandle program, IRHandle loop, int vecLen)
-      : program_(program), loop_(loop), vecLen(vecLen) {}
+      : program_(program), loop_(loop), vecLen(vecLen) {
+    if (!IsSupportedVecLen(vecLen)) {
+      throw std::runtime_error("LoopVectorization: unsupported vector length " +
+                               std::to_string(vecLen));
+    }
+  }
+
+  static bool IsSupportedVecLen(int vecLen) {
+    return vecLen == 4 || vecLen == 8 || vecLen == 16;
+  }
+
+  /// The operand `assign` accumulates into an access or a value invariant in
+  /// `loop` by +, *, Min or Max, e.g. `A(i, k) * B(k, j)` above, and its
+  /// ReduceOp in `op`. NullIRHandle if `assign` is no such reduction, or
+  /// anything else in `loop` uses the tensor or value it accumulates into.
+  static IRHandle ReductionOperand(IRHandle loop, IRHandle assign,
+                                   ReduceOp *op = nullptr);
 
   static PassRetHandle runPass(PassArgHandle arg) {
     LoopVectorization vec(PassArg::as<Arg>(arg)->program,
@@ -52,6 +76,7 @@ class LoopVectorization : public Pass, public IRNotImplementedVisitor {
 
   void visitMin(MinHandle min) override;
   void visitMax(MaxHandle max) override;
+  void visitSelect(SelectHandle select) override;
 
   struct Arg : public PassArg {
     IRHandle program;
@@ -73,6 +98,10 @@ class LoopVectorization : public Pass, public IRNotImplementedVisitor {
 
   std::vector<IRHandle> vectorizationBody;
   IRHandle node;
+
+ private:
+  // The accumulators set up ahead of the loop, and combined after it.
+  std::vector<IRHandle> prologue_, epilogue_;
 };
 
 }  // namespace polly
@@ -0,0 +1,62 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-11 09:15:40
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-11 09:15:40
+ * @CopyRight: Qiming Zheng
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/*!
+ * \brief A reusable barrier for a fixed number of threads.
+ *
+ * Arrivals only touch two atomics; the last one to arrive opens the barrier by
+ * bumping the generation, so the same object can be waited on again right
+ * away. Waiters spin briefly before parking on a condition variable.
+ */
+class Barrier {
+ public:
+  explicit Barrier(int count) : count_(count), waiting_(0), generation_(0) {}
+
+  Barrier(const Barrier &) = delete;
+  Barrier &operator=(const Barrier &) = delete;
+
+  void Wait() {
+    int generation = generation_.load(std::memory_order_acquire);
+    if (waiting_.fetch_add(1, std::memory_order_acq_rel) == count_ - 1) {
+      waiting_.store(0, std::memory_order_relaxed);
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        generation_.fetch_add(1, std::memory_order_release);
+      }
+      cv_.notify_all();
+      return;
+    }
+    for (int i = 0; i < SpinCount; i++) {
+      if (generation_.load(std::memory_order_acquire) != generation) return;
+      std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(mtx_);
+    cv_.wait(lock, [&] {
+      return generation_.load(std::memory_order_acquire) != generation;
+    });
+  }
+
+  int Count() const { return count_; }
+
+ private:
+  static const int SpinCount = 1024;
+
+  const int count_;
+  std::atomic<int> waiting_;
+  std::atomic<int> generation_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+};
@@ -0,0 +1,91 @@
+#include "buffer.h"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+
+namespace polly {
+
+const size_t BufferAllocator::CacheLineSize;
+const size_t BufferAllocator::HugePageSize;
+
+BufferAllocator &BufferAllocator::Global() {
+  // Never destroyed, so that buffers in static storage can still be freed.
+  static BufferAllocator *allocator = new BufferAllocator();
+  return *allocator;
+}
+
+size_t BufferAllocator::SizeClass(size_t bytes) {
+  if (bytes >= HugePageSize) {
+    return (bytes + HugePageSize - 1) / HugePageSize * HugePageSize;
+  }
+  size_t size_class = CacheLineSize;
+  while (size_class < bytes) size_class <<= 1;
+  return size_class;
+}
+
+void *BufferAllocator::Allocate(size_t bytes) {
+  size_t size_class = SizeClass(bytes);
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    auto it = free_lists_.find(size_class);
+    if (it != free_lists_.end() && !it->second.empty()) {
+      void *ptr = it->second.back();
+      it->second.pop_back();
+      stats_.reused++;
+      stats_.cached_bytes -= size_class;
+      return ptr;
+    }
+    stats_.allocated++;
+  }
+
+  void *ptr = nullptr;
+  if (posix_memalign(&ptr, Alignment(size_class), size_class) != 0) {
+    throw std::bad_alloc();
+  }
+#ifdef MADV_HUGEPAGE
+  if (size_class >= HugePageSize) madvise(ptr, size_class, MADV_HUGEPAGE);
+#endif
+  return ptr;
+}
+
+void BufferAllocator::Free(void *ptr, size_t bytes) {
+  if (ptr == nullptr) return;
+  size_t size_class = SizeClass(bytes);
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (stats_.cached_bytes + size_class <= cache_limit_) {
+      free_lists_[size_class].push_back(ptr);
+      stats_.cached_bytes += size_class;
+      return;
+    }
+  }
+  free(ptr);
+}
+
+void BufferAllocator::Trim() {
+  std::unordered_map<size_t, std::vector<void *>> free_lists;
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    free_lists.swap(free_lists_);
+    stats_.cached_bytes = 0;
+  }
+  for (auto &it : free_lists) {
+    for (void *ptr : it.second) free(ptr);
+  }
+}
+
+void BufferAllocator::SetCacheLimit(size_t bytes) {
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    cache_limit_ = bytes;
+    if (stats_.cached_bytes <= cache_limit_) return;
+  }
+  Trim();
+}
+
+BufferAllocator::Stats BufferAllocator::GetStats() {
+  std::unique_lock<std::mutex> lock(mtx_);
+  return stats_;
+}
+
+}  // namespace polly
@@ -3,15 +3,79 @@
  * @Author: Qiming Zheng
  * @Date: 2022-01-24 21:20:19
  * @Last Modified by: Qiming Zheng
- * @Last Modified time: 2022-01-24 21:22:27
+ * @Last Modified time: 2022-02-13 11:05:42
  * @CopyRight: Qiming Zheng
  */
 #pragma once
 
 #include "common.h"
 
+#include <mutex>
+#include <unordered_map>
+
 namespace polly {
 
+/*!
+ * \brief A size-class pool of aligned host memory blocks.
+ *
+ * Blocks are at least `CacheLineSize` aligned. Requests below
+ * `HugePageSize` are rounded up to a power of two; larger ones are rounded up
+ * to a multiple of the huge page size, aligned to it and advised to be backed
+ * by transparent huge pages. Freed blocks are kept in per-size free lists (up
+ * to `cache_limit` bytes in total), so that tensors of the same shape reuse
+ * their memory, and its already faulted-in pages, across kernel invocations.
+ */
+class BufferAllocator {
+ public:
+  static const size_t CacheLineSize = 64;
+  static const size_t HugePageSize = 2 << 20;
+
+  struct Stats {
+    /// Allocations served from the free lists.
+    size_t reused = 0;
+    /// Allocations that had to go to the system.
+    size_t allocated = 0;
+    /// Bytes currently held in the free lists.
+    size_t cached_bytes = 0;
+  };
+
+  static BufferAllocator &Global();
+
+  BufferAllocator(size_t cache_limit = size_t(1) << 30)
+      : cache_limit_(cache_limit) {}
+  ~BufferAllocator() { Trim(); }
+
+  /// Returns an uninitialized block of at least `bytes` bytes.
+  void *Allocate(size_t bytes);
+  /// Gives back a block of `bytes` bytes obtained from `Allocate`.
+  void Free(void *ptr, size_t bytes);
+
+  /// Releases all cached blocks to the system.
+  void Trim();
+
+  void SetCacheLimit(size_t bytes);
+
+  Stats GetStats();
+
+  static size_t SizeClass(size_t bytes);
+  static size_t Alignment(size_t size_class) {
+    return size_class >= HugePageSize ? HugePageSize : CacheLineSize;
+  }
+
+ private:
+  std::mutex mtx_;
+  std::unordered_map<size_t, std::vector<void *>> free_lists_;
+  size_t cache_limit_;
+  Stats stats_;
+};
+
+/*!
+ * \brief A one-dimensional tensor storage.
+ *
+ * `Buffer(size)` owns `size` elements from a BufferAllocator and returns them
+ * to it when destroyed. A default-constructed Buffer only describes memory
+ * owned by someone else, in which case `data` and `size` are set by the user.
+ */
 template <typename T>
 class Buffer {
  public:
@@ -20,10 +84,61 @@ class Buffer {
     GPU_MEM,
   };
 
+  Buffer() : size(0), stride(1), alignment(alignof(T)), data(nullptr) {}
+
+  explicit Buffer(size_t size, Type type = CPU_MEM,
+                  BufferAllocator &allocator = BufferAllocator::Global())
+      : size(size), stride(1), allocator_(&allocator) {
+    if (type != CPU_MEM) {
+      throw std::runtime_error("Buffer: only CPU memory is supported");
+    }
+    bytes_ = std::max<size_t>(size, 1) * sizeof(T);
+    data = static_cast<T *>(allocator.Allocate(bytes_));
+    alignment =
+        BufferAllocator::Alignment(BufferAllocator::SizeClass(bytes_));
+  }
+
+  Buffer(const Buffer &) = delete;
+  Buffer &operator=(const Buffer &) = delete;
+
+  Buffer(Buffer &&other) : data(nullptr) { *this = std::move(other); }
+  Buffer &operator=(Buffer &&other) {
+    if (this != &other) {
+      release();
+      size = other.size;
+      stride = other.stride;
+      alignment = other.alignment;
+      data = other.data;
+      allocator_ = other.allocator_;
+      bytes_ = other.bytes_;
+      other.data = nullptr;
+      other.allocator_ = nullptr;
+    }
+    return *this;
+  }
+
+  ~Buffer() { release(); }
+
+  bool Owned() const { return allocator_ != nullptr; }
+
+  void Fill(T value) { std::fill(data, data + size, value); }
+
   size_t size;
   size_t stride;
   size_t alignment;
-  T* data;
+  T *data;
+
+ private:
+  void release() {
+    if (allocator_ != nullptr && data != nullptr) {
+      allocator_->Free(data, bytes_);
+    }
+    allocator_ = nullptr;
+    data = nullptr;
+  }
+
+  BufferAllocator *allocator_ = nullptr;
+  size_t bytes_ = 0;
 };
 
-}  // namespace polly
\ No newline at end of file
+}  // namespace polly
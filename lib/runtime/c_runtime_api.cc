@@ -0,0 +1,21 @@
+#include "c_runtime_api.h"
+
+MultiThreading &GetRuntimeThreadPool() {
+  // Never destroyed: kernels may still launch from static destructors.
+  static MultiThreading *pool = [] {
+    int workers = std::thread::hardware_concurrency();
+    const char *env = getenv("POLLY_NUM_THREADS");
+    if (env != nullptr && atoi(env) > 0) workers = atoi(env);
+    return new MultiThreading(std::max(workers, 1) - 1);
+  }();
+  return *pool;
+}
+
+int polly_backend_num_workers() {
+  return GetRuntimeThreadPool().thread_num + 1;
+}
+
+void polly_backend_parallel_launch(PollyParallelLambda lambda, void *cdata) {
+  GetRuntimeThreadPool().parallel_region(
+      [&](int wid, int worker_size) { lambda(wid, worker_size, cdata); });
+}
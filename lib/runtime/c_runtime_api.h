@@ -0,0 +1,44 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-15 09:48:12
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-15 09:48:12
+ * @CopyRight: Qiming Zheng
+ */
+#pragma once
+
+#include "multi_threading.h"
+
+/*!
+ * \brief The C ABI through which kernels generated by CodeGenC run their
+ * parallel loops on the runtime thread pool.
+ *
+ * A generated kernel holds a `polly_parallel_launch` function pointer. The
+ * loader (e.g. NativeModule) points it to `polly_backend_parallel_launch`, so
+ * every kernel loaded into the process shares the one warm pool of the host
+ * instead of bringing up a runtime of its own.
+ */
+extern "C" {
+
+/// Body of a parallel region, called once for every `wid` in
+/// [0, worker_size) with the closure data given to the launch.
+typedef void (*PollyParallelLambda)(int wid, int worker_size, void *cdata);
+typedef void (*PollyParallelLaunchFunc)(PollyParallelLambda lambda,
+                                        void *cdata);
+
+/// Number of participants of a parallel region, the calling thread included.
+int polly_backend_num_workers();
+
+/// Runs `lambda` on every participant and returns once all of them are done.
+/// Launches from inside a region are nested onto the same pool.
+void polly_backend_parallel_launch(PollyParallelLambda lambda, void *cdata);
+}
+
+/*!
+ * \brief The process-wide pool behind the C ABI, created on first use. It has
+ * one participant per hardware thread, or `POLLY_NUM_THREADS` if set, the
+ * thread launching a region being one of them. The host may pin it or make it
+ * hot around a burst of kernel calls.
+ */
+MultiThreading &GetRuntimeThreadPool();
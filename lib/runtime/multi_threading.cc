@@ -2,6 +2,10 @@
  
 ThreadPool *ThreadPool::pool = nullptr;
 
-void InitializeMultiThreading(std::vector<size_t> dim) {
-  ThreadPool::Initialize(ThreadDim(dim));
+void InitializeMultiThreading(std::vector<size_t> dim,
+                              std::vector<TopologyLevel> levels) {
+  ThreadPool::Initialize(ThreadDim(dim), levels);
 }
+
+thread_local MultiThreading::WorkerContext MultiThreading::context_ = {
+    nullptr, -1, nullptr};
@@ -32,7 +32,16 @@
 #include <mutex>
 #include <future>
 #include <queue>
-// #include <barrier>
+#include <functional>
+#include <condition_variable>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "barrier.h"
+#include "topology.h"
+#include "work_stealing_deque.h"
 
 class ThreadDim {
  public:
@@ -48,38 +57,181 @@ class ThreadDim {
   std::vector<size_t> dim_;
 };
 
+/*!
+ * \brief A unit of work held by the MultiThreading queues. Jobs created by
+ * `submit` own themselves and are deleted once they have run.
+ */
+class Job {
+ public:
+  virtual ~Job() {}
+  virtual void Run() = 0;
+};
+
+template <typename R>
+class PackagedJob : public Job {
+ public:
+  template <typename F>
+  PackagedJob(F &&f) : task(std::forward<F>(f)) {}
+
+  void Run() override {
+    task();
+    delete this;
+  }
+
+  std::packaged_task<R()> task;
+};
+
+/*!
+ * \brief A fork-join job as handed to the worker mailboxes. It lives on the
+ * stack of the forking thread and every participant runs it once with its own
+ * id, so running it must not free it.
+ */
+class ForkJoin {
+ public:
+  virtual ~ForkJoin() {}
+  virtual void Run(int id) = 0;
+};
+
+/*!
+ * \brief Runs `body(id)` once for every participant id in [0, width) and
+ * collects the first exception thrown by any of them.
+ */
+template <typename F>
+class ForkJoinJob : public ForkJoin {
+ public:
+  ForkJoinJob(int width, F &body) : body_(body), remaining_(width) {}
+
+  void Run(int id) override {
+    try {
+      body_(id);
+    } catch (...) {
+      std::unique_lock<std::mutex> lock(mtx_);
+      if (!error_) error_ = std::current_exception();
+    }
+    // Decrement under the lock, so that Wait() cannot return (and destroy the
+    // job) before we are done with it.
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (remaining_.fetch_sub(1) == 1) cv_.notify_all();
+  }
+
+  bool Done() { return remaining_.load() == 0; }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    cv_.wait(lock, [this] { return remaining_.load() == 0; });
+    if (error_) std::rethrow_exception(error_);
+  }
+
+ private:
+  F &body_;
+  std::atomic<int> remaining_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::exception_ptr error_;
+};
+
 class TaskQueue {
  public:
   TaskQueue() {}
 
   bool Empty() { return tasks_.empty(); }
-  void Enqueue(std::function<void(void)> f) { tasks_.push(f); }
+  size_t Size() { return tasks_.size(); }
+  void Enqueue(Job *job) { tasks_.push(job); }
 
-  bool Dequeue(std::function<void(void)> &f) {
+  bool Dequeue(Job *&job) {
     if (tasks_.empty()) return false;
-    f = tasks_.front();
+    job = tasks_.front();
     tasks_.pop();
     return true;
   }
 
  private:
-  std::queue<std::function<void(void)>> tasks_;
+  std::queue<Job *> tasks_;
+};
+
+/// Chunk distribution policies of MultiThreading::parallel_for, with the same
+/// meaning as the OpenMP schedule kinds.
+enum class ParallelSchedule {
+  /// Chunks are dealt round-robin to the participants up front.
+  Static,
+  /// Participants grab the next chunk from a shared counter.
+  Dynamic,
+  /// Like Dynamic, with chunks proportional to the remaining iterations.
+  Guided,
+};
+
+/// Pause the core for a moment inside a spin loop.
+static inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+/*!
+ * \brief How idle workers wait for work. A worker first polls for
+ * `spin_count` rounds with a pause instruction, then for `yield_count` rounds
+ * giving up its time slice, and only then parks on a condition variable. The
+ * submitter of a task has to issue a (futex) wake-up for parked workers only.
+ */
+struct WaitPolicy {
+  int spin_count = 2048;
+  int yield_count = 64;
+};
+
+/// How often idle workers found work while spinning (`spins`), went to sleep
+/// (`parks`), and were woken up again (`wakes`).
+struct WaitStats {
+  uint64_t spins = 0;
+  uint64_t parks = 0;
+  uint64_t wakes = 0;
 };
 
+/*!
+ * \brief A work-stealing thread pool.
+ *
+ * Every worker owns a WorkStealingDeque. Tasks submitted from one of the
+ * workers (e.g. nested parallelism) are pushed onto its own deque without any
+ * lock; tasks submitted from other threads go to a shared injection queue, from
+ * which an idle worker grabs a batch at once and moves it onto its own deque.
+ * A worker whose deque runs dry steals from randomly chosen victims before it
+ * goes to sleep, so a burst of small tasks is spread over all workers without
+ * funnelling through a single lock.
+ *
+ * Bulk work goes through `parallel_for` and `parallel_region`, which fork a
+ * single stack-allocated job over the workers and the calling thread, and join
+ * before returning. The job is handed to each worker through a private
+ * mailbox, never through the stealable queues: the calling thread is
+ * participant 0 and worker i always participant i + 1, so every participant
+ * runs on its own thread and may synchronize with the others through a
+ * Barrier. A fork from inside one of the workers (nested parallelism) has no
+ * free threads to go to and runs on the calling worker alone.
+ *
+ * Idle workers spin, then yield, then park according to the WaitPolicy. For
+ * back-to-back kernel calls the pool can be made hot with `SetHot(true)`:
+ * workers then never park, so a fork costs no wake-up system call at all.
+ */
 class MultiThreading {
  public:
-  MultiThreading(int thread_num) : thread_num(thread_num) {
-    running = true;
+  MultiThreading(int thread_num, WaitPolicy policy = WaitPolicy())
+      : thread_num(thread_num) {
+    running_ = true;
+    SetWaitPolicy(policy);
+    for (int i = 0; i < thread_num; i++) {
+      workers_.emplace_back(new Worker(i));
+    }
     for (int i = 0; i < thread_num; i++) {
-      threads_.push_back(std::thread(&MultiThreading::run, this));
+      threads_.push_back(std::thread(&MultiThreading::run, this, i));
     }
   }
 
   ~MultiThreading() {
-    std::unique_lock<std::mutex> lock(mtx);
-    running = false;
-    cv.notify_all();
-    lock.unlock();
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      running_ = false;
+    }
+    cv_.notify_all();
 
     for (int i = 0; i < thread_num; i++) {
       threads_[i].join();
@@ -87,59 +239,402 @@ class MultiThreading {
     threads_.clear();
   }
 
-  void run() {
-    while (running) {
-      bool found = false;
-      std::function<void(void)> f;
-      {
-        std::unique_lock<std::mutex> lock(mtx);
-        cv.wait(lock, [this] { return !(running && tasks_.Empty()); });
-        if (!running) break;
-        found = tasks_.Dequeue(f);
-      }
-      if (found) {
-        f();
+  template <typename F, typename... Args>
+  auto submit(F &&f, Args &&...args) -> std::future<decltype(f(args...))> {
+    auto job = new PackagedJob<decltype(f(args...))>(
+        std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    auto future = job->task.get_future();
+    schedule(job, 1);
+    return future;
+  }
+
+  /*!
+   * \brief Runs `body(first, last)` over sub-ranges covering [begin, end) on
+   * the workers and the calling thread, and returns once all of them are done.
+   * No memory is allocated per call or per chunk.
+   *
+   * \param chunk Iterations per chunk; the minimum chunk size for Guided. A
+   * non-positive value means one chunk per participant for Static, and 1
+   * otherwise.
+   */
+  template <typename F>
+  void parallel_for(int64_t begin, int64_t end, int64_t chunk,
+                    ParallelSchedule policy, F &&body) {
+    if (begin >= end) return;
+    int64_t total = end - begin;
+    int64_t width = forkWidth();
+    if (chunk <= 0) {
+      chunk = policy == ParallelSchedule::Static ? (total + width - 1) / width
+                                                 : 1;
+    }
+    width = std::min(width, (total + chunk - 1) / chunk);
+
+    std::atomic<int64_t> next(begin);
+    auto participant = [&](int id) {
+      switch (policy) {
+        case ParallelSchedule::Static:
+          for (int64_t first = begin + id * chunk; first < end;
+               first += width * chunk) {
+            body(first, std::min(first + chunk, end));
+          }
+          break;
+        case ParallelSchedule::Dynamic:
+          while (true) {
+            int64_t first = next.fetch_add(chunk);
+            if (first >= end) break;
+            body(first, std::min(first + chunk, end));
+          }
+          break;
+        case ParallelSchedule::Guided: {
+          int64_t first = next.load();
+          while (first < end) {
+            int64_t size = std::max(chunk, (end - first) / (2 * width));
+            if (next.compare_exchange_weak(first, first + size)) {
+              body(first, std::min(first + size, end));
+              first = next.load();
+            }
+          }
+          break;
+        }
       }
+    };
+    fork(width, participant);
+  }
+
+  /*!
+   * \brief Runs `body(wid, worker_size)` for every wid in [0, worker_size) with
+   * worker_size = thread_num + 1, the calling thread taking wid 0 and worker i
+   * wid i + 1 on every call. This is the fork-join shape of the worker
+   * functions emitted by CodeGenC::create_method; participants can share a
+   * Barrier(worker_size). Called from one of the workers of this pool, it runs
+   * `body(0, 1)` on the calling thread.
+   */
+  template <typename F>
+  void parallel_region(F &&body) {
+    int width = forkWidth();
+    auto participant = [&](int id) { body(id, width); };
+    fork(width, participant);
+  }
+
+  void SetWaitPolicy(WaitPolicy policy) {
+    spin_count_ = policy.spin_count;
+    yield_count_ = policy.yield_count;
+  }
+
+  /// While the pool is hot, idle workers keep polling instead of parking.
+  /// Meant to bracket a burst of kernel calls; it burns the idle cores.
+  void SetHot(bool hot) {
+    hot_ = hot;
+    if (!hot) return;
+    // Get the parked workers back to polling.
+    std::unique_lock<std::mutex> lock(mtx_);
+    cv_.notify_all();
+  }
+
+  bool IsHot() { return hot_; }
+
+  /// Restricts worker `index` to the given logical CPUs.
+  bool PinWorker(int index, const std::vector<int> &cpus) {
+    return PinThread(threads_[index], cpus);
+  }
+
+  /// Pins the workers one per unit of `level`, round-robin starting from
+  /// `first_unit`. Returns false if any of the workers could not be pinned.
+  bool PinWorkers(TopologyLevel level, int first_unit = 0) {
+    auto units = CpuTopology::Get().Units(level);
+    bool pinned = true;
+    for (int i = 0; i < thread_num; i++) {
+      pinned &= PinWorker(i, units[(first_unit + i) % units.size()]);
     }
+    return pinned;
   }
 
-  template <typename F, typename... Args>
-  auto submit(F &&f, Args &&...args) -> std::future<decltype(f(args...))> {
-    std::function<decltype(f(args...))()> func =
-        std::bind(std::forward<F>(f), std::forward<Args>(args)...);
-    auto task_ptr =
-        std::make_shared<std::packaged_task<decltype(f(args...))()>>(func);
+  WaitStats GetWaitStats() {
+    WaitStats stats;
+    for (auto &worker : workers_) {
+      stats.spins += worker->spins.load(std::memory_order_relaxed);
+      stats.parks += worker->parks.load(std::memory_order_relaxed);
+      stats.wakes += worker->wakes.load(std::memory_order_relaxed);
+    }
+    return stats;
+  }
 
-    std::function<void()> wrapper_func = [task_ptr]() { (*task_ptr)(); };
+  void ResetWaitStats() {
+    for (auto &worker : workers_) {
+      worker->spins = 0;
+      worker->parks = 0;
+      worker->wakes = 0;
+    }
+  }
 
-    std::unique_lock<std::mutex> lock(mtx);
+  int thread_num;
+
+ private:
+  struct Worker {
+    Worker(int index) : rng(index + 1), mailbox(nullptr) {}
+
+    WorkStealingDeque<Job *> deque;
+    std::minstd_rand rng;
+    std::atomic<ForkJoin *> mailbox;
 
-    tasks_.Enqueue(wrapper_func);
+    // Only written by the owner, read by GetWaitStats().
+    std::atomic<uint64_t> spins{0};
+    std::atomic<uint64_t> parks{0};
+    std::atomic<uint64_t> wakes{0};
+  };
 
-    cv.notify_one();
+  /// The pool and worker index the calling thread belongs to, if any, and the
+  /// pool it is currently forking on as participant 0.
+  struct WorkerContext {
+    MultiThreading *pool;
+    int index;
+    MultiThreading *forking;
+  };
+  static thread_local WorkerContext context_;
 
-    return task_ptr->get_future();
+  /// The number of participants of a fork from the calling thread. The
+  /// workers of this pool are all taken while one of them, or the caller of an
+  /// outer fork, forks.
+  int forkWidth() {
+    bool nested = context_.pool == this || context_.forking == this;
+    return nested ? 1 : thread_num + 1;
   }
 
-  std::mutex mtx;
-  std::condition_variable cv;
+  /// Runs `body` as participant 0 and as participants 1 .. width - 1 on
+  /// workers 0 .. width - 2, and joins.
+  template <typename F>
+  void fork(int width, F &body) {
+    ForkJoinJob<F> job(width, body);
+    if (width > 1) post(&job, width - 1);
+    MultiThreading *outer = context_.forking;
+    context_.forking = this;
+    job.Run(0);
+    context_.forking = outer;
+    spinUntil([&] { return job.Done(); });
+    job.Wait();
+  }
 
+  /// Queues `copies` references to `job` on the shared queues.
+  void schedule(Job *job, int copies) {
+    if (context_.pool == this) {
+      for (int i = 0; i < copies; i++) {
+        workers_[context_.index]->deque.Push(job);
+      }
+    } else {
+      std::unique_lock<std::mutex> lock(inject_mtx_);
+      for (int i = 0; i < copies; i++) injected_.Enqueue(job);
+      injected_size_.store(injected_.Size(), std::memory_order_relaxed);
+    }
+    // Pairs with the sleeping_/pending_ handshake in run(): either the sleeper
+    // observes the new task, or we observe the sleeper and wake it up.
+    pending_.fetch_add(copies);
+    wakeUp(copies > 1);
+  }
+
+  /// Hands `job` to the mailboxes of the first `copies` workers. A mailbox
+  /// still holding the job of a concurrent fork is waited for, rather than
+  /// letting a thread that is already a participant pick up a second one.
+  /// Concurrent forks post one after the other, so they queue up behind each
+  /// other in the same order on every worker.
+  void post(ForkJoin *job, int copies) {
+    std::unique_lock<std::mutex> lock(post_mtx_);
+    for (int i = 0; i < copies; i++) {
+      ForkJoin *expected = nullptr;
+      while (!workers_[i]->mailbox.compare_exchange_weak(expected, job)) {
+        expected = nullptr;
+        std::this_thread::yield();
+      }
+    }
+    wakeUp(true);
+  }
+
+  void wakeUp(bool all) {
+    if (sleeping_.load() == 0) return;
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (all) {
+      cv_.notify_all();
+    } else {
+      cv_.notify_one();
+    }
+  }
+
+  bool findTask(int index, Job *&job) {
+    Worker &self = *workers_[index];
+    if (self.deque.Pop(job)) return true;
+    if (takeInjected(self, job)) return true;
+    for (int attempt = 0; attempt < 2 * thread_num; attempt++) {
+      int victim = self.rng() % thread_num;
+      if (victim == index) continue;
+      if (workers_[victim]->deque.Steal(job)) return true;
+    }
+    return false;
+  }
+
+  /// Moves a fair share of the injection queue onto the deque of `self`, so
+  /// that the rest of the batch can be stolen without touching the lock.
+  bool takeInjected(Worker &self, Job *&job) {
+    if (injected_size_.load(std::memory_order_relaxed) == 0) return false;
+    std::unique_lock<std::mutex> lock(inject_mtx_);
+    if (!injected_.Dequeue(job)) return false;
+    size_t batch = injected_.Size() / thread_num;
+    Job *extra;
+    for (size_t i = 0; i < batch && injected_.Dequeue(extra); i++) {
+      self.deque.Push(extra);
+    }
+    injected_size_.store(injected_.Size(), std::memory_order_relaxed);
+    return true;
+  }
+
+  /// Polls `ready` following the WaitPolicy, and for as long as the pool is
+  /// hot. Returns false if it is time to park.
+  template <typename F>
+  bool spinUntil(F ready) {
+    int spin_count = spin_count_, yield_count = yield_count_;
+    for (int i = 0; i < spin_count; i++) {
+      if (ready()) return true;
+      CpuRelax();
+    }
+    for (int i = 0; i < yield_count; i++) {
+      if (ready()) return true;
+      std::this_thread::yield();
+    }
+    while (hot_) {
+      if (ready()) return true;
+      std::this_thread::yield();
+    }
+    return ready();
+  }
+
+  void run(int index) {
+    context_ = {this, index, nullptr};
+    Worker &self = *workers_[index];
+    auto has_work = [&] {
+      return !running_ || pending_.load() > 0 ||
+             self.mailbox.load() != nullptr;
+    };
+    while (true) {
+      ForkJoin *fork_job = self.mailbox.exchange(nullptr);
+      if (fork_job != nullptr) {
+        fork_job->Run(index + 1);
+        continue;
+      }
+      Job *job;
+      if (findTask(index, job)) {
+        pending_.fetch_sub(1);
+        job->Run();
+        continue;
+      }
+      if (!running_) break;
+      if (spinUntil(has_work)) {
+        self.spins.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(mtx_);
+      if (!running_) break;
+      sleeping_.fetch_add(1);
+      self.parks.fetch_add(1, std::memory_order_relaxed);
+      cv_.wait(lock, [&] { return has_work() || hot_; });
+      self.wakes.fetch_add(1, std::memory_order_relaxed);
+      sleeping_.fetch_sub(1);
+    }
+    context_ = {nullptr, -1, nullptr};
+  }
+
+  std::vector<std::unique_ptr<Worker>> workers_;
   std::vector<std::thread> threads_;
-  TaskQueue tasks_;
-  bool running;
-  int thread_num;
+
+  std::mutex post_mtx_;
+  std::mutex inject_mtx_;
+  std::atomic<size_t> injected_size_{0};
+  TaskQueue injected_;
+
+  // Sleeping workers park on cv_ until pending_ becomes positive or their
+  // mailbox is filled.
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::atomic<int> pending_{0};
+  std::atomic<int> sleeping_{0};
+  std::atomic<bool> running_;
+
+  std::atomic<bool> hot_{false};
+  std::atomic<int> spin_count_;
+  std::atomic<int> yield_count_;
 };
 
+/*!
+ * \brief Zero-fills `data` from the workers of `pool`, split the same way as
+ * a static parallel_region splits the outer loop of a kernel (the calling
+ * thread taking the first part). Under the first-touch policy of the OS, each
+ * page is then placed on the NUMA node of the thread that will compute on it,
+ * since parallel_region runs a given wid on the same thread every time.
+ */
+template <typename T>
+void FirstTouch(MultiThreading &pool, T *data, size_t size) {
+  pool.parallel_region([&](int wid, int worker_size) {
+    size_t first = size * wid / worker_size;
+    size_t last = size * (wid + 1) / worker_size;
+    std::fill(data + first, data + last, T());
+  });
+}
+
+/*!
+ * \brief Hierarchical thread pool with one MultiThreading per ThreadDim level.
+ * Level i + 1 has dim[i] workers for every worker of level i, worker w of
+ * level i + 1 being a child of worker w / dim[i].
+ *
+ * When `levels` is given, level i is mapped to the hardware granularity
+ * levels[i] and every worker of that level is pinned to its own unit (e.g. one
+ * worker per socket, then one per core), so that the OS does not migrate
+ * workers away from the memory they have first-touched. The children of a
+ * worker take the units inside the unit of their parent, round-robin.
+ */
 class ThreadPool {
-  ThreadPool(ThreadDim dim) : dim_(dim) {
-    threadingLevels = new MultiThreading *[dim.size()];
+  ThreadPool(ThreadDim dim, std::vector<TopologyLevel> levels) : dim_(dim) {
+    if (!levels.empty() && levels.size() != dim.dim_.size()) {
+      throw std::runtime_error(
+          "ThreadPool: expect one topology level per thread dimension");
+    }
+    threadingLevels = new MultiThreading *[dim.dim_.size()];
     size_t mult = 1;
-    for (int i = 0; i < dim.size(); i++) {
+    // The CPUs each worker of the previous level is pinned to.
+    std::vector<std::vector<int>> parents;
+    for (int i = 0; i < dim.dim_.size(); i++) {
       threadingLevels[i] = new MultiThreading(mult);
+      if (!levels.empty()) {
+        parents = placeWorkers(threadingLevels[i], levels[i], parents,
+                               i > 0 ? dim[i - 1] : 1);
+      }
       mult *= dim[i];
     }
   }
 
+  static std::vector<std::vector<int>> placeWorkers(
+      MultiThreading *level, TopologyLevel granularity,
+      const std::vector<std::vector<int>> &parents, size_t fanout) {
+    auto units = CpuTopology::Get().Units(granularity);
+    std::vector<std::vector<int>> placed;
+    for (int w = 0; w < level->thread_num; w++) {
+      if (parents.empty()) {
+        placed.push_back(units[w % units.size()]);
+      } else {
+        // Units are contiguous ranges of the topology, a finer one lies in
+        // a coarser one as a whole.
+        auto &parent = parents[w / fanout];
+        std::vector<std::vector<int>> inside;
+        for (auto &unit : units) {
+          if (std::find(parent.begin(), parent.end(), unit[0]) !=
+              parent.end()) {
+            inside.push_back(unit);
+          }
+        }
+        placed.push_back(inside.empty() ? parent
+                                        : inside[w % fanout % inside.size()]);
+      }
+      level->PinWorker(w, placed.back());
+    }
+    return placed;
+  }
+
   MultiThreading **threadingLevels;
 
   ThreadDim dim_;
@@ -147,7 +642,10 @@ class ThreadPool {
  public:
   static ThreadPool *GetInstance() { return pool; }
 
-  static void Initialize(ThreadDim dim) { pool = new ThreadPool(dim); }
+  static void Initialize(ThreadDim dim,
+                         std::vector<TopologyLevel> levels = {}) {
+    pool = new ThreadPool(dim, levels);
+  }
 
   static MultiThreading *GetThreadingLevel(int level) {
     return pool->threadingLevels[level];
@@ -156,7 +654,8 @@ class ThreadPool {
   static ThreadPool *pool;
 };
 
-void InitializeMultiThreading(std::vector<int> dim);
+void InitializeMultiThreading(std::vector<size_t> dim,
+                              std::vector<TopologyLevel> levels = {});
 
 template <typename F, typename... Args>
 auto SubmitToLevel(F &&f, Args &&...args, int level)
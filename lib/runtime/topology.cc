@@ -0,0 +1,128 @@
+#include "topology.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static const std::string SysCpuPath = "/sys/devices/system/cpu/";
+static const std::string SysNodePath = "/sys/devices/system/node/";
+
+static bool readInt(const std::string &path, int &value) {
+  std::ifstream f(path);
+  return static_cast<bool>(f >> value);
+}
+
+/// Parses a sysfs cpu list such as "0-3,8-11".
+static std::vector<int> parseCpuList(const std::string &list) {
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty()) continue;
+    size_t dash = range.find('-');
+    int first = std::stoi(range.substr(0, dash));
+    int last = first;
+    if (dash != std::string::npos) last = std::stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+CpuTopology::CpuTopology() {
+  std::ifstream online(SysCpuPath + "online");
+  std::string list;
+  if (online >> list) {
+    for (int cpu : parseCpuList(list)) {
+      std::string topology = SysCpuPath + "cpu" + std::to_string(cpu) +
+                             "/topology/";
+      CpuInfo info = {cpu, 0, 0, cpu};
+      readInt(topology + "physical_package_id", info.socket);
+      readInt(topology + "core_id", info.core);
+      cpus.push_back(info);
+    }
+  }
+  if (cpus.empty()) {
+    for (int cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency());
+         cpu++) {
+      cpus.push_back({cpu, 0, 0, cpu});
+    }
+  }
+
+  if (DIR *dir = opendir(SysNodePath.c_str())) {
+    while (struct dirent *entry = readdir(dir)) {
+      int node;
+      if (sscanf(entry->d_name, "node%d", &node) != 1) continue;
+      std::ifstream f(SysNodePath + entry->d_name + "/cpulist");
+      std::string node_cpus;
+      if (!(f >> node_cpus)) continue;
+      for (int cpu : parseCpuList(node_cpus)) {
+        for (auto &info : cpus) {
+          if (info.cpu == cpu) info.node = node;
+        }
+      }
+    }
+    closedir(dir);
+  }
+
+  std::sort(cpus.begin(), cpus.end(), [](const CpuInfo &a, const CpuInfo &b) {
+    return std::make_tuple(a.node, a.socket, a.core, a.cpu) <
+           std::make_tuple(b.node, b.socket, b.core, b.cpu);
+  });
+}
+
+const CpuTopology &CpuTopology::Get() {
+  static CpuTopology topology;
+  return topology;
+}
+
+std::vector<std::vector<int>> CpuTopology::Units(TopologyLevel level) const {
+  auto key = [level](const CpuInfo &info) {
+    switch (level) {
+      case TopologyLevel::Node:
+        return std::make_tuple(info.node, -1, -1, -1);
+      case TopologyLevel::Socket:
+        return std::make_tuple(info.node, info.socket, -1, -1);
+      case TopologyLevel::Core:
+        return std::make_tuple(info.node, info.socket, info.core, -1);
+      default:
+        return std::make_tuple(info.node, info.socket, info.core, info.cpu);
+    }
+  };
+  std::vector<std::vector<int>> units;
+  for (int i = 0; i < cpus.size(); i++) {
+    if (i == 0 || key(cpus[i]) != key(cpus[i - 1])) units.emplace_back();
+    units.back().push_back(cpus[i].cpu);
+  }
+  return units;
+}
+
+#ifdef __linux__
+static bool pinHandle(pthread_t handle, const std::vector<int> &cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(handle, sizeof(set), &set) == 0;
+}
+
+bool PinThread(std::thread &thread, const std::vector<int> &cpus) {
+  return pinHandle(thread.native_handle(), cpus);
+}
+
+bool PinCurrentThread(const std::vector<int> &cpus) {
+  return pinHandle(pthread_self(), cpus);
+}
+#else
+bool PinThread(std::thread &thread, const std::vector<int> &cpus) {
+  return false;
+}
+
+bool PinCurrentThread(const std::vector<int> &cpus) { return false; }
+#endif
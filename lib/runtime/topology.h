@@ -0,0 +1,62 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-12 16:20:05
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-12 16:20:05
+ * @CopyRight: Qiming Zheng
+ */
+
+#pragma once
+
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Granularities of the hardware hierarchy a thread level can be mapped to,
+/// from the coarsest to the finest.
+enum class TopologyLevel {
+  /// A NUMA memory node.
+  Node,
+  /// A physical package.
+  Socket,
+  /// A physical core, i.e. all of its SMT siblings.
+  Core,
+  /// A single logical CPU (hardware thread).
+  SMT,
+};
+
+struct CpuInfo {
+  int cpu;
+  int node;
+  int socket;
+  int core;
+};
+
+/*!
+ * \brief The logical CPUs of the machine, as reported by Linux sysfs.
+ *
+ * CPUs are sorted by (node, socket, core, cpu), so that the units of any
+ * TopologyLevel are contiguous ranges of `cpus`. On other systems, or if sysfs
+ * is not readable, every CPU is assumed to sit on its own core of a single
+ * socket and node.
+ */
+class CpuTopology {
+ public:
+  static const CpuTopology &Get();
+
+  /// The CPU sets of all units of the given level, in topology order.
+  std::vector<std::vector<int>> Units(TopologyLevel level) const;
+
+  int NumUnits(TopologyLevel level) const { return Units(level).size(); }
+
+  std::vector<CpuInfo> cpus;
+
+ private:
+  CpuTopology();
+};
+
+/// Restricts `thread` to run on the given logical CPUs. Returns false if the
+/// platform does not support it or the request was rejected.
+bool PinThread(std::thread &thread, const std::vector<int> &cpus);
+bool PinCurrentThread(const std::vector<int> &cpus);
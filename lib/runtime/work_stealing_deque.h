@@ -0,0 +1,131 @@
+/*
+ * @Description: Polly: A DSL compiler for Tensor Program
+ * @Author: Qiming Zheng
+ * @Date: 2022-02-10 14:02:11
+ * @Last Modified by: Qiming Zheng
+ * @Last Modified time: 2022-02-10 14:02:11
+ * @CopyRight: Qiming Zheng
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * \brief Chase-Lev work-stealing deque, following "Correct and Efficient
+ * Work-Stealing for Weak Memory Models" (Le et al., PPoPP'13).
+ *
+ * The owner thread pushes and pops at the bottom without taking any lock;
+ * other threads steal from the top with a single CAS. The ring buffer grows on
+ * demand; retired buffers are kept alive until the deque is destroyed because
+ * a concurrent thief may still be reading from them.
+ *
+ * \param T A trivially copyable element type, typically a pointer.
+ */
+template <typename T>
+class WorkStealingDeque {
+ public:
+  explicit WorkStealingDeque(int64_t capacity = 256)
+      : top_(0), bottom_(0), array_(new Array(capacity)) {}
+
+  ~WorkStealingDeque() {
+    delete array_.load(std::memory_order_relaxed);
+    for (auto array : garbage_) delete array;
+  }
+
+  WorkStealingDeque(const WorkStealingDeque &) = delete;
+  WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+  /// Owner only.
+  void Push(T item) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    Array *a = array_.load(std::memory_order_relaxed);
+    if (b - t > a->capacity - 1) {
+      Array *bigger = a->grow(t, b);
+      garbage_.push_back(a);
+      a = bigger;
+      array_.store(a, std::memory_order_release);
+    }
+    a->put(b, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+
+  /// Owner only. Takes the most recently pushed item.
+  bool Pop(T &item) {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    Array *a = array_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+    item = a->get(b);
+    if (t == b) {
+      // Last item: race against thieves for it.
+      bool won = top_.compare_exchange_strong(
+          t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+
+  /// Any thread. Takes the oldest item; fails spuriously under contention.
+  bool Steal(T &item) {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) return false;
+    Array *a = array_.load(std::memory_order_acquire);
+    T x = a->get(t);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return false;
+    }
+    item = x;
+    return true;
+  }
+
+  bool Empty() const {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    return b <= t;
+  }
+
+ private:
+  struct Array {
+    explicit Array(int64_t capacity)
+        : capacity(capacity),
+          mask(capacity - 1),
+          buffer(new std::atomic<T>[capacity]) {}
+    ~Array() { delete[] buffer; }
+
+    T get(int64_t i) {
+      return buffer[i & mask].load(std::memory_order_relaxed);
+    }
+    void put(int64_t i, T x) {
+      buffer[i & mask].store(x, std::memory_order_relaxed);
+    }
+
+    Array *grow(int64_t top, int64_t bottom) {
+      Array *bigger = new Array(capacity * 2);
+      for (int64_t i = top; i < bottom; i++) bigger->put(i, get(i));
+      return bigger;
+    }
+
+    int64_t capacity;  // Always a power of two.
+    int64_t mask;
+    std::atomic<T> *buffer;
+  };
+
+  alignas(64) std::atomic<int64_t> top_;
+  alignas(64) std::atomic<int64_t> bottom_;
+  std::atomic<Array *> array_;
+  std::vector<Array *> garbage_;
+};
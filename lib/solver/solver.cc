@@ -9,7 +9,10 @@ constraint IterSet::CreateEquality(std::map<std::string, int> coeffs,
   constraint ret = constraint::equality(spc);
   for (auto it : coeffs) {
     value coeff(domain_.ctx(), it.second);
-    ret.set_coefficient(space::variable, nestings[it.first], coeff);
+    if (params.find(it.first) != params.end())
+      ret.set_coefficient(space::parameter, params[it.first], coeff);
+    else
+      ret.set_coefficient(space::variable, nestings[it.first], coeff);
   }
   ret.set_constant(constant);
   return ret;
@@ -20,7 +23,10 @@ constraint IterSet::CreateInequality(std::map<std::string, int> coeffs,
   constraint ret = constraint::inequality(spc);
   for (auto it : coeffs) {
     value coeff(domain_.ctx(), it.second);
-    ret.set_coefficient(space::variable, nestings[it.first], coeff);
+    if (params.find(it.first) != params.end())
+      ret.set_coefficient(space::parameter, params[it.first], coeff);
+    else
+      ret.set_coefficient(space::variable, nestings[it.first], coeff);
   }
   ret.set_constant(constant);
   return ret;
@@ -82,6 +88,8 @@ constraint AccessMap::CreateEquality(std::map<std::string, int> coeffs,
     value coeff(array_domain_.ctx(), it.second);
     if (iters.find(it.first) != iters.end())
       ret.set_coefficient(space::input, iters[it.first], coeff);
+    else if (params.find(it.first) != params.end())
+      ret.set_coefficient(space::parameter, params[it.first], coeff);
     else
       ret.set_coefficient(space::output, indices[it.first], coeff);
   }
@@ -96,6 +104,8 @@ constraint AccessMap::CreateInequality(std::map<std::string, int> coeffs,
     value coeff(array_domain_.ctx(), it.second);
     if (iters.find(it.first) != iters.end())
       ret.set_coefficient(space::input, iters[it.first], coeff);
+    else if (params.find(it.first) != params.end())
+      ret.set_coefficient(space::parameter, params[it.first], coeff);
     else
       ret.set_coefficient(space::output, indices[it.first], coeff);
   }
@@ -25,8 +25,8 @@ using namespace polly::isl;
 // TODO: transform iteration-domain to schedule map.
 class IterSet {
   IterSet(basic_set &s, space &sp, std::map<std::string, int> nestings,
-          std::string name)
-      : domain_(s), spc(sp), nestings(nestings), name(name) {
+          std::map<std::string, int> params, std::string name)
+      : domain_(s), spc(sp), nestings(nestings), params(params), name(name) {
     domain_.set_name(name);
   }
 
@@ -36,17 +36,27 @@ class IterSet {
     spc = other.spc.copy();
     name = other.name;
     nestings = other.nestings;
+    params = other.params;
   }
 
   // name: point set identifier.
   // dim_names: name of each dimensions.
+  // param_names: symbolic constants the constraints may refer to.
   IterSet(const context &ctx, const std::string &name,
-          std::vector<std::string> dim_names)
+          std::vector<std::string> dim_names,
+          std::vector<std::string> param_names = {})
       : name(name) {
     for (int i = 0; i < dim_names.size(); i++) {
       nestings[dim_names[i]] = i;
     }
-    spc = space(ctx, set_tuple(dim_names));
+    for (int i = 0; i < param_names.size(); i++) {
+      params[param_names[i]] = i;
+    }
+    if (param_names.empty()) {
+      spc = space(ctx, set_tuple(dim_names));
+    } else {
+      spc = space(ctx, parameter_tuple(param_names), set_tuple(dim_names));
+    }
     spc.set_name(space::dimension_type::variable, name);
     domain_ = basic_set::universe(spc);
   }
@@ -75,7 +85,7 @@ class IterSet {
         nest[i.first] = i.second;
       }
     }
-    return IterSet(b, spc, nest, name);
+    return IterSet(b, spc, nest, params, name);
   }
   constraint_list GetBounds(std::string loop);
 
@@ -105,6 +115,7 @@ class IterSet {
   space spc;
   std::string name;
   std::map<std::string, int> nestings;
+  std::map<std::string, int> params;
 };
 
 /// Modeling the array accesses.
@@ -112,9 +123,15 @@ class AccessMap {
  public:
   AccessMap(context ctx, std::string statement_name,
             std::vector<std::string> iter_name, std::string array_name,
-            std::vector<std::string> indices_name)
+            std::vector<std::string> indices_name,
+            std::vector<std::string> param_names = {})
       : array_name_(array_name), statement_name_(statement_name) {
-    spc = space(ctx, input_tuple(iter_name), output_tuple(indices_name));
+    if (param_names.empty()) {
+      spc = space(ctx, input_tuple(iter_name), output_tuple(indices_name));
+    } else {
+      spc = space(ctx, parameter_tuple(param_names), input_tuple(iter_name),
+                  output_tuple(indices_name));
+    }
     spc.set_name(space::dimension_type::output, array_name_);
     spc.set_name(space::dimension_type::input, statement_name);
     array_domain_ = basic_map::universe(spc);
@@ -124,6 +141,9 @@ class AccessMap {
     for (int i = 0; i < indices_name.size(); i++) {
       indices[indices_name[i]] = i;
     }
+    for (int i = 0; i < param_names.size(); i++) {
+      params[param_names[i]] = i;
+    }
   }
 
   void add_constraint(constraint c) { array_domain_.add_constraint(c); }
@@ -140,6 +160,7 @@ class AccessMap {
   basic_map array_domain_;
   std::map<std::string, int> iters;
   std::map<std::string, int> indices;
+  std::map<std::string, int> params;
 };
 
 /// Maps an statement iteration instance to the logical time space.
@@ -8,10 +8,14 @@
 #include "pass/analysis/data_dependency_model.h"
 #include "pass/analysis/transform_analysis_pass.h"
 #include "pass/analysis/parallelization_analysis_pass.h"
+#include "pass/analysis/memory_planner.h"
+#include "pass/analysis/alignment_analysis.h"
+#include "pass/analysis/streaming_store_analysis.h"
 
 #include "pass/transform/fussion.h"
 #include "pass/transform/fission.h"
 #include "pass/transform/reorder.h"
+#include "pass/transform/vectorization.h"
 
 using namespace polly;
 
@@ -400,4 +404,156 @@ TEST(PARALLEL_ANALYSIS, PARALLEL_ANALYSIS) {
 
     EXPECT_EQ(PassRet::as<ParallelizationAnalysisPass::Ret>(ret)->legal, false);
   }
-}
\ No newline at end of file
+}
+TEST(MEMORY_PLANNER, LIVENESS_PACKING) {
+  {
+    Program prog;
+    Tensor A({1024}), T1({1024}), T2({1024}), T3({1024}), B({1024});
+    {
+      Variable i(0, 1024, 1);
+      T1(i) = A(i) * 2;
+    }
+    {
+      Variable i(0, 1024, 1);
+      T2(i) = T1(i) + 1;
+    }
+    {
+      Variable i(0, 1024, 1);
+      T3(i) = T2(i) * 3;
+    }
+    {
+      Variable i(0, 1024, 1);
+      B(i) = T3(i) + 1;
+    }
+    auto ret = MemoryPlanner::runPass(MemoryPlanner::Arg::create(
+        prog.module_.GetRoot(), prog.module_.GetTensors(), {A.id, B.id}));
+    MemoryPlan plan = PassRet::as<MemoryPlanner::Ret>(ret)->plan;
+
+    EXPECT_EQ(plan.allocations.size(), 3);
+    EXPECT_EQ(plan.Find(A.id), nullptr);
+    EXPECT_EQ(plan.Find(B.id), nullptr);
+    EXPECT_EQ(plan.Find(T1.id)->first_stage, 0);
+    EXPECT_EQ(plan.Find(T1.id)->last_stage, 1);
+    EXPECT_EQ(plan.Find(T3.id)->first_stage, 2);
+    // T1 and T3 are never live at the same time, T2 overlaps both.
+    EXPECT_EQ(plan.Find(T1.id)->offset, plan.Find(T3.id)->offset);
+    EXPECT_NE(plan.Find(T1.id)->offset, plan.Find(T2.id)->offset);
+    EXPECT_EQ(plan.unplanned_size, 3 * 1024);
+    EXPECT_EQ(plan.slab_size, 2 * 1024);
+  }
+}
+
+TEST(ALIGNMENT_ANALYSIS, ALIGNED_ACCESSES) {
+  {
+    Program prog;
+    Tensor A({16, 64}), B({16, 72}), C({8, 12});
+    IRNodeKey J, L;
+    {
+      Variable i(0, 16, 1);
+      {
+        Variable j(0, 64, 1);
+        J = j.id;
+        A(i, j) = A(i, j) + B(i, j + 1);
+      }
+    }
+    {
+      Variable k(0, 8, 1);
+      {
+        // Rows of 12 floats only start on every other 32-byte boundary.
+        Variable l(0, 8, 1);
+        L = l.id;
+        C(k, l) = C(k, l) * 2;
+      }
+    }
+    auto root = prog.module_.GetRoot();
+    LoopVectorization::runPass(
+        LoopVectorization::Arg::create(root, prog.module_.GetLoop(J), 8));
+    LoopVectorization::runPass(
+        LoopVectorization::Arg::create(root, prog.module_.GetLoop(L), 8));
+
+    // Vectors of 32 bytes cannot be aligned within 16-byte aligned tensors.
+    auto ret =
+        AlignmentAnalysis::runPass(AlignmentAnalysis::Arg::create(root, 16));
+    EXPECT_EQ(PassRet::as<AlignmentAnalysis::Ret>(ret)->aligned, 0);
+
+    ret = AlignmentAnalysis::runPass(AlignmentAnalysis::Arg::create(root));
+    EXPECT_EQ(PassRet::as<AlignmentAnalysis::Ret>(ret)->aligned, 2);
+    for (auto &stmt : prog.module_.GetLoop(J).as<ForNode>()->body) {
+      if (stmt.Type() == IRNodeType::VEC_STORE) {
+        EXPECT_TRUE(stmt.as<VecStoreNode>()->aligned);
+      } else if (stmt.Type() == IRNodeType::VEC_LOAD) {
+        auto load = stmt.as<VecLoadNode>();
+        auto tensor = load->data.as<AccessNode>()->tensor.as<TensorNode>();
+        EXPECT_EQ(load->aligned, tensor->id == A.id);
+      }
+    }
+  }
+  {
+    // The lower bound of a split loop joins the tile start and a constant.
+    auto i = VarNode::make("i", IntNode::make(0), IntNode::make(64),
+                           IntNode::make(16));
+    auto j = VarNode::make("j", MaxNode::make(i, IntNode::make(8)),
+                           AddNode::make(i, IntNode::make(16)),
+                           IntNode::make(1));
+    auto c = AlignmentAnalysis::ComputeCongruence(MulNode::make(i, j));
+    EXPECT_EQ(c.modulus, 1);
+    c = AlignmentAnalysis::ComputeCongruence(
+        AddNode::make(MulNode::make(IntNode::make(2), i), IntNode::make(3)));
+    EXPECT_EQ(c.modulus, 32);
+    EXPECT_EQ(c.residue, 3);
+    j.as<VarNode>()->increment = IntNode::make(4);
+    c = AlignmentAnalysis::ComputeCongruence(j);
+    EXPECT_EQ(c.modulus, 4);
+    EXPECT_EQ(c.residue, 0);
+  }
+}
+
+TEST(STREAMING_STORE_ANALYSIS, WRITE_ONCE_OUTPUTS) {
+  Program prog;
+  Tensor A({16, 64}), B({16, 64}), C({16, 64}), D({64});
+  IRNodeKey I, J, K, L;
+  {
+    Variable i(0, 16, 1);
+    I = i.id;
+    {
+      Variable j(0, 64, 1);
+      J = j.id;
+      A(i, j) = B(i, j) * 2;
+      C(i, j) = C(i, j) + B(i, j);
+    }
+  }
+  {
+    Variable k(0, 16, 1);
+    {
+      // Every row of B is written to the same D.
+      Variable l(0, 64, 1);
+      L = l.id;
+      D(l) = B(k, l);
+    }
+  }
+  auto root = prog.module_.GetRoot();
+  LoopVectorization::runPass(
+      LoopVectorization::Arg::create(root, prog.module_.GetLoop(J), 8));
+  LoopVectorization::runPass(
+      LoopVectorization::Arg::create(root, prog.module_.GetLoop(L), 8));
+
+  // Nothing is aligned yet.
+  auto ret = StreamingStoreAnalysis::runPass(
+      StreamingStoreAnalysis::Arg::create(root, 0));
+  EXPECT_EQ(PassRet::as<StreamingStoreAnalysis::Ret>(ret)->streamed, 0);
+  AlignmentAnalysis::runPass(AlignmentAnalysis::Arg::create(root));
+  // A is small enough to stay in the cache.
+  ret = StreamingStoreAnalysis::runPass(
+      StreamingStoreAnalysis::Arg::create(root));
+  EXPECT_EQ(PassRet::as<StreamingStoreAnalysis::Ret>(ret)->streamed, 0);
+
+  ret = StreamingStoreAnalysis::runPass(
+      StreamingStoreAnalysis::Arg::create(root, 0));
+  EXPECT_EQ(PassRet::as<StreamingStoreAnalysis::Ret>(ret)->streamed, 1);
+  for (auto &stmt : prog.module_.GetLoop(J).as<ForNode>()->body) {
+    if (stmt.Type() != IRNodeType::VEC_STORE) continue;
+    auto store = stmt.as<VecStoreNode>();
+    auto tensor = store->data.as<AccessNode>()->tensor.as<TensorNode>();
+    EXPECT_EQ(store->nontemporal, tensor->id == A.id);
+  }
+}
@@ -4,6 +4,7 @@
 #include "lang/expr.h"
 #include "pass/check/affine_check.h"
 #include "pass/check/constant_boundary_check.h"
+#include "pass/check/constant_extent_check.h"
 
 using namespace polly;
 
@@ -169,4 +170,33 @@ TEST(IRCheckPass, IRDivisibleBoundaryCheckVisitor) {
     EXPECT_EQ(prog.IsBoundaryDivisible(K, 0), false);
     EXPECT_EQ(prog.IsBoundaryDivisible(K, -10), false);
   }
-}
\ No newline at end of file
+}
+
+static void constantExtentCheck(IRHandle root,
+                                std::map<std::string, int64_t> values,
+                                bool expected) {
+  auto ret = ConstantExtentCheck::runPass(
+      ConstantExtentCheck::Arg::create(root, values));
+  EXPECT_EQ(PassRet::as<ConstantExtentCheck::Ret>(ret)->violation.empty(),
+            expected);
+}
+
+TEST(IRCheckPass, ConstantExtentCheck) {
+  Program prog;
+  Tensor A({1024}), B({64, 16});
+  Constant N("N");
+  {
+    Variable i(0, N, 1);
+    {
+      Variable j(0, 16, 1);
+      B(i, j) = A(i * 16 + j);
+    }
+  }
+  IRHandle root = prog.module_.GetRoot();
+  constantExtentCheck(root, {{"N", 64}}, true);
+  constantExtentCheck(root, {{"N", 0}}, true);
+  // B(64, j) and A(1024 + j) are out of bounds.
+  constantExtentCheck(root, {{"N", 65}}, false);
+  // Unbound constants are not checked.
+  constantExtentCheck(root, {}, true);
+}
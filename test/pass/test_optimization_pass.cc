@@ -4,6 +4,10 @@
 #include "lang/expr.h"
 
 #include "pass/optimization/constant_folding.h"
+#include "pass/optimization/fma_fusion.h"
+#include "pass/optimization/scalar_replacement.h"
+#include "pass/optimization/software_prefetch.h"
+#include "pass/transform/vectorization.h"
 
 using namespace polly;
 
@@ -77,4 +81,216 @@ TEST(DEAD_CODE_ELIMINATION, DEAD_CODE_ELIMINATION) {
                   ->body.size(),
               1);
   }
-}
\ No newline at end of file
+}
+
+TEST(FMA_FUSION, FMA_FUSION) {
+  {
+    Program prog;
+    Tensor A({64}), B({64}), C({64});
+    IRNodeKey I, J;
+    {
+      Variable i(0, 64, 1);
+      I = i.id;
+      A(i) = B(i) * C(i) + A(i) * 2;
+    }
+    {
+      Variable j(0, 64, 1);
+      J = j.id;
+      B(j) = A(j) * C(j);
+    }
+    auto root = prog.module_.GetRoot();
+    LoopVectorization::runPass(
+        LoopVectorization::Arg::create(root, prog.module_.GetLoop(I), 8));
+    LoopVectorization::runPass(
+        LoopVectorization::Arg::create(root, prog.module_.GetLoop(J), 8));
+
+    auto ret = FMAFusion::runPass(FMAFusion::Arg::create(root));
+    // Only one of the two products of the first loop can be fused, the
+    // second loop has no addition.
+    EXPECT_EQ(PassRet::as<FMAFusion::Ret>(ret)->fused, 1);
+
+    auto count = [](IRHandle loop, IRNodeType type) {
+      int n = 0;
+      for (auto &stmt : loop.as<ForNode>()->body) n += stmt.Type() == type;
+      return n;
+    };
+    auto i_loop = prog.module_.GetLoop(I);
+    EXPECT_EQ(count(i_loop, IRNodeType::VEC_FMA), 1);
+    EXPECT_EQ(count(i_loop, IRNodeType::VEC_MUL), 1);
+    EXPECT_EQ(count(i_loop, IRNodeType::VEC_ADD), 0);
+    EXPECT_EQ(count(prog.module_.GetLoop(J), IRNodeType::VEC_MUL), 1);
+  }
+}
+
+TEST(SCALAR_REPLACEMENT, SCALAR_REPLACEMENT) {
+  auto types = [](IRHandle loop) {
+    std::vector<IRNodeType> ret;
+    for (auto &stmt : loop.as<ForNode>()->body) ret.push_back(stmt.Type());
+    return ret;
+  };
+  {
+    Program prog;
+    Tensor A({16, 8}), B({8, 16}), C({16, 16}), D({16});
+    IRNodeKey J, K;
+    {
+      Variable i(0, 16, 1);
+      {
+        Variable j(0, 16, 1);
+        J = j.id;
+        {
+          Variable k(0, 8, 1);
+          K = k.id;
+          C(i, j) = C(i, j) + A(i, k) * B(k, j);
+        }
+      }
+    }
+    {
+      Variable i(0, 16, 1);
+      {
+        // D(k) may be the element accumulated in.
+        Variable k(0, 16, 1);
+        D(i) = D(i) + D(k);
+      }
+    }
+    auto ret = ScalarReplacement::runPass(
+        ScalarReplacement::Arg::create(prog.module_.GetRoot()));
+    EXPECT_EQ(PassRet::as<ScalarReplacement::Ret>(ret)->promoted, 1);
+    EXPECT_EQ(types(prog.module_.GetLoop(J)),
+              std::vector<IRNodeType>({IRNodeType::DECLARATION,
+                                       IRNodeType::ASSIGN, IRNodeType::FOR,
+                                       IRNodeType::ASSIGN}));
+    auto assign = prog.module_.GetLoop(K).as<ForNode>()->body[0];
+    EXPECT_EQ(assign.as<AssignmentNode>()->lhs.Type(), IRNodeType::VALUE);
+  }
+  {
+    Program prog;
+    Tensor A({16, 8}), B({8, 16}), C({16, 16});
+    IRNodeKey JO, JI;
+    {
+      Variable i(0, 16, 1);
+      {
+        Variable jo(0, 2, 1);
+        JO = jo.id;
+        {
+          Variable k(0, 8, 1);
+          {
+            Variable ji(0, 8, 1);
+            JI = ji.id;
+            C(i, jo * 8 + ji) = C(i, jo * 8 + ji) + A(i, k) * B(k, jo * 8 + ji);
+          }
+        }
+      }
+    }
+    auto root = prog.module_.GetRoot();
+    LoopVectorization::runPass(
+        LoopVectorization::Arg::create(root, prog.module_.GetLoop(JI), 8));
+    FMAFusion::runPass(FMAFusion::Arg::create(root));
+    auto ret =
+        ScalarReplacement::runPass(ScalarReplacement::Arg::create(root));
+    EXPECT_EQ(PassRet::as<ScalarReplacement::Ret>(ret)->promoted, 1);
+    EXPECT_EQ(types(prog.module_.GetLoop(JO)),
+              std::vector<IRNodeType>({IRNodeType::VEC_LOAD, IRNodeType::FOR,
+                                       IRNodeType::VEC_STORE}));
+    // Only the loads of A and B and the multiply-add are left.
+    EXPECT_EQ(types(prog.module_.GetLoop(JI)),
+              std::vector<IRNodeType>({IRNodeType::VEC_BROADCAST_LOAD,
+                                       IRNodeType::VEC_LOAD,
+                                       IRNodeType::VEC_FMA}));
+  }
+}
+
+TEST(SOFTWARE_PREFETCH, SOFTWARE_PREFETCH) {
+  Program prog;
+  Tensor A({16, 8}), B({8, 16}), C({16, 16});
+  IRNodeKey J, K;
+  {
+    Variable i(0, 16, 1);
+    {
+      Variable j(0, 16, 1);
+      J = j.id;
+      {
+        Variable k(0, 8, 1);
+        K = k.id;
+        C(i, j) = C(i, j) + A(i, k) * B(k, j);
+      }
+    }
+  }
+  auto loop = prog.module_.GetLoop(K).as<ForNode>();
+  auto assign = loop->body[0].as<AssignmentNode>();
+  auto mul = assign->rhs.as<AddNode>()->rhs.as<MulNode>();
+  EXPECT_EQ(SoftwarePrefetch::ElementStride(mul->lhs, K), 1);
+  EXPECT_EQ(SoftwarePrefetch::ElementStride(mul->rhs, K), 16);
+  EXPECT_EQ(SoftwarePrefetch::ElementStride(assign->lhs, K), 0);
+  EXPECT_EQ(SoftwarePrefetch::ElementStride(assign->lhs, J), 1);
+
+  auto ret = SoftwarePrefetch::runPass(
+      SoftwarePrefetch::Arg::create(prog.module_.GetRoot(), 4));
+  // Only B walks across cache lines, and only in `k`.
+  EXPECT_EQ(PassRet::as<SoftwarePrefetch::Ret>(ret)->inserted, 1);
+  ASSERT_EQ(loop->body.size(), 2);
+  ASSERT_EQ(loop->body[0].Type(), IRNodeType::PREFETCH);
+  auto data = loop->body[0].as<PrefetchNode>()->data.as<AccessNode>();
+  EXPECT_EQ(data->tensor.as<TensorNode>()->id, B.id);
+  EXPECT_EQ(data->indices[0].Type(), IRNodeType::ADD);
+  EXPECT_EQ(prog.module_.GetLoop(J).as<ForNode>()->body.size(), 1);
+}
+
+TEST(SOFTWARE_PREFETCH, CONTIGUOUS_VECTORS) {
+  // A 16-wide load moves by a cache line every iteration, yet its stream is
+  // contiguous.
+  {
+    Program prog;
+    Tensor A({16, 64}), B({16, 64});
+    IRNodeKey JI;
+    {
+      Variable i(0, 16, 1);
+      {
+        Variable jo(0, 4, 1);
+        {
+          Variable ji(0, 16, 1);
+          JI = ji.id;
+          B(i, jo * 16 + ji) = A(i, jo * 16 + ji) * 2;
+        }
+      }
+    }
+    auto root = prog.module_.GetRoot();
+    LoopVectorization::runPass(
+        LoopVectorization::Arg::create(root, prog.module_.GetLoop(JI), 16));
+    auto ret =
+        SoftwarePrefetch::runPass(SoftwarePrefetch::Arg::create(root, 4));
+    EXPECT_EQ(PassRet::as<SoftwarePrefetch::Ret>(ret)->inserted, 0);
+  }
+  // Only B walks down its columns in the `k` loop of a 16-wide GEMM.
+  {
+    Program prog;
+    Tensor A({16, 8}), B({8, 64}), C({16, 64});
+    IRNodeKey JI;
+    {
+      Variable i(0, 16, 1);
+      {
+        Variable jo(0, 4, 1);
+        {
+          Variable k(0, 8, 1);
+          {
+            Variable ji(0, 16, 1);
+            JI = ji.id;
+            C(i, jo * 16 + ji) =
+                C(i, jo * 16 + ji) + A(i, k) * B(k, jo * 16 + ji);
+          }
+        }
+      }
+    }
+    auto root = prog.module_.GetRoot();
+    LoopVectorization::runPass(
+        LoopVectorization::Arg::create(root, prog.module_.GetLoop(JI), 16));
+    auto ret =
+        SoftwarePrefetch::runPass(SoftwarePrefetch::Arg::create(root, 4));
+    EXPECT_EQ(PassRet::as<SoftwarePrefetch::Ret>(ret)->inserted, 1);
+    // The vectorized `ji` loop runs once, it is part of the body of `k`.
+    auto loop = prog.module_.GetLoop(JI).as<ForNode>();
+    ASSERT_EQ(loop->body[0].Type(), IRNodeType::PREFETCH);
+    auto data = loop->body[0].as<PrefetchNode>()->data.as<AccessNode>();
+    EXPECT_EQ(data->tensor.as<TensorNode>()->id, B.id);
+    EXPECT_EQ(data->indices[0].Type(), IRNodeType::ADD);
+  }
+}
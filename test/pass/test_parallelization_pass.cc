@@ -4,6 +4,7 @@
 #include "lang/expr.h"
 
 #include "pass/parallelization/parallel_utils.h"
+#include "pass/parallelization/loop_scheduling.h"
 #include "pass/parallelization/sync_parallel.h"
 
 using namespace polly;
@@ -66,4 +67,61 @@ TEST(SYNC_PARALLEL, SYNC_PARALLEL) {
                   ->id,
               s3);
   }
-}
\ No newline at end of file
+}
+
+TEST(PARALLEL_SCHEDULE, COLLAPSE_AND_SCHEDULE) {
+  {
+    Program prog;
+    Tensor A({4, 64}), B({64, 64}), C({256, 4});
+    IRNodeKey I, J, K, L, M, N;
+    {
+      // Too few outer iterations for 8 workers.
+      Variable i(0, 4, 1);
+      I = i.id;
+      {
+        Variable j(0, 64, 1);
+        J = j.id;
+        A(i, j) = A(i, j) + 1;
+      }
+    }
+    {
+      // Triangular.
+      Variable k(0, 64, 1);
+      K = k.id;
+      {
+        Variable l(k, 64, 1);
+        L = l.id;
+        B(k, l) = B(k, l) + 1;
+      }
+    }
+    {
+      Variable m(0, 256, 1);
+      M = m.id;
+      {
+        Variable n(0, 4, 1);
+        N = n.id;
+        C(m, n) = C(m, n) + 1;
+      }
+    }
+    for (auto key : {I, J, K, L, M, N}) {
+      prog.module_.GetLoop(key).as<ForNode>()->annotation.parallelization =
+          true;
+    }
+    EXPECT_EQ(LoopScheduling::CollapsibleDepth(prog.module_.GetLoop(I)), 2);
+    EXPECT_EQ(LoopScheduling::CollapsibleDepth(prog.module_.GetLoop(K)), 1);
+    EXPECT_EQ(LoopScheduling::TripCount(prog.module_.GetLoop(M)), 256);
+    EXPECT_EQ(LoopScheduling::TripCount(prog.module_.GetLoop(L)), -1);
+
+    LoopScheduling::runPass(
+        LoopScheduling::Arg::create(prog.module_.GetRoot(), 8));
+    auto annotation = [&](IRNodeKey key) {
+      return prog.module_.GetLoop(key).as<ForNode>()->annotation;
+    };
+    EXPECT_EQ(annotation(I).collapse, 2);
+    EXPECT_EQ(annotation(I).schedule, LoopAnnotation::Schedule::STATIC);
+    EXPECT_EQ(annotation(K).collapse, 1);
+    EXPECT_EQ(annotation(K).schedule, LoopAnnotation::Schedule::DYNAMIC);
+    EXPECT_EQ(annotation(M).collapse, 1);
+    EXPECT_EQ(annotation(M).schedule, LoopAnnotation::Schedule::STATIC);
+  }
+}
@@ -10,6 +10,7 @@
 #include "pass/transform/split.h"
 #include "pass/transform/unroll.h"
 #include "pass/transform/vectorization.h"
+#include "auto_scheduler/mutator/mutator.h"
 
 using namespace polly;
 
@@ -219,3 +220,99 @@ TEST(TRANSFORM_PASS, VECTORIZATION) {
         LoopVectorization::Arg::create(prog.module_.GetRoot(), i_loop, 4));
   }
 }
+
+TEST(TRANSFORM_PASS, VECTORIZATION_LEGALITY) {
+  {
+    Program prog;
+    Tensor A({64}), B({64}), C({65}), D({64, 64});
+    IRNodeKey I, J, K, L, M;
+    {
+      Variable i(0, 64, 1);
+      I = i.id;
+      A(i) = B(i) * 2 + A(i);
+    }
+    {
+      Variable j(0, 40, 1);
+      J = j.id;
+      B(j) = A(j);
+    }
+    {
+      // Lanes would read elements stored by the previous lanes.
+      Variable k(0, 64, 1);
+      K = k.id;
+      C(k + 1) = C(k) + 1;
+    }
+    {
+      // The looping variable as a value.
+      Variable l(0, 64, 1);
+      L = l.id;
+      A(l) = l;
+    }
+    {
+      // Strided access.
+      Variable m(0, 64, 1);
+      M = m.id;
+      D(m, 0) = A(m);
+    }
+    auto root = prog.module_.GetRoot();
+    EXPECT_FALSE(Mutator::Vectorize(root, prog.module_.GetLoop(J), 16));
+    EXPECT_FALSE(Mutator::Vectorize(root, prog.module_.GetLoop(K), 4));
+    EXPECT_FALSE(Mutator::Vectorize(root, prog.module_.GetLoop(L), 4));
+    EXPECT_FALSE(Mutator::Vectorize(root, prog.module_.GetLoop(M), 4));
+    EXPECT_FALSE(Mutator::Vectorize(root, prog.module_.GetLoop(I), 12));
+    EXPECT_TRUE(Mutator::Vectorize(root, prog.module_.GetLoop(J), 8));
+    EXPECT_TRUE(Mutator::Vectorize(root, prog.module_.GetLoop(I), 16));
+    EXPECT_TRUE(prog.module_.GetLoop(I)
+                    .as<ForNode>()
+                    ->looping_var_.as<VarNode>()
+                    ->increment.equals(IntNode::make(16)));
+  }
+  {
+    Program prog;
+    Tensor A({64}), B({64}), S({1}), T({1});
+    IRNodeKey I, J;
+    {
+      Variable i(0, 64, 1);
+      I = i.id;
+      S(0) = S(0) + A(i) * B(i);
+    }
+    {
+      // The partial sums would be read before they are combined.
+      Variable j(0, 64, 1);
+      J = j.id;
+      T(0) = T(0) + A(j);
+      B(j) = T(0);
+    }
+    auto root = prog.module_.GetRoot();
+    EXPECT_FALSE(Mutator::Vectorize(root, prog.module_.GetLoop(J), 8));
+    EXPECT_TRUE(Mutator::Vectorize(root, prog.module_.GetLoop(I), 8));
+    // The accumulator is set up ahead of the loop, and reduced after it.
+    auto &body = root.as<FuncNode>()->body;
+    ASSERT_EQ(body.size(), 4);
+    EXPECT_EQ(body[0].Type(), IRNodeType::VEC_SCALAR);
+    EXPECT_EQ(body[2].Type(), IRNodeType::VEC_REDUCE);
+  }
+  {
+    Program prog;
+    Tensor A({16, 64}), B({64, 16}), C({16, 16});
+    IRNodeKey K;
+    {
+      Variable i(0, 16, 1);
+      Variable j(0, 16, 1);
+      Variable k(0, 64, 1);
+      K = k.id;
+      C(i, j) = C(i, j) + A(i, k) * B(k, j);
+    }
+    auto root = prog.module_.GetRoot();
+    auto loop = prog.module_.GetLoop(K);
+    EXPECT_TRUE(Mutator::Vectorize(root, loop, 8));
+    // The lanes of B(k, j) lie a row apart.
+    int gathers = 0;
+    for (auto &stmt : loop.as<ForNode>()->body) {
+      if (stmt.Type() != IRNodeType::VEC_GATHER) continue;
+      EXPECT_EQ(stmt.as<VecGatherNode>()->stride, 16);
+      gathers++;
+    }
+    EXPECT_EQ(gathers, 1);
+  }
+}
@@ -4,6 +4,9 @@
 #include "lang/expr.h"
 #include "pass/check/affine_check.h"
 #include "pass/check/constant_boundary_check.h"
+#include "codegen/codegen.h"
+#include "pass/transform/vectorization.h"
+#include "pass/optimization/fma_fusion.h"
 
 using namespace polly;
 
@@ -25,6 +28,62 @@ TEST(CODEGEN, CODEGEN_C) {
   }
 }
 
+TEST(CODEGEN, CODEGEN_C_PARALLEL) {
+  {
+    Program prog;
+    Tensor A({64, 64}), B({64});
+    IRNodeKey I, J;
+    {
+      Variable i(0, 64, 1);
+      I = i.id;
+      {
+        Variable j(0, 64, 1);
+        J = j.id;
+        B(j) = B(j) + A(i, j);
+      }
+    }
+    prog.module_.GetLoop(J).as<ForNode>()->annotation.parallelization = true;
+    CodeGenC codegen;
+    std::string code = codegen.genCode(prog.module_.GetRoot(),
+                                       prog.module_.GetTensors(), "kernel");
+    EXPECT_EQ(code.find("omp"), std::string::npos);
+    EXPECT_NE(code.find("polly_parallel_launch(kernel_parallel_0_lambda"),
+              std::string::npos);
+    // The enclosing loop variable is passed to the worker function.
+    EXPECT_NE(code.find("int " + I + ", int worker_size, int wid"),
+              std::string::npos);
+  }
+}
+
+TEST(CODEGEN, CODEGEN_C_FLAT_ACCESS) {
+  {
+    Program prog;
+    Tensor A({16, 8}), B({8, 12}), C({16, 12});
+    IRNodeKey K;
+    {
+      Variable i(0, 16, 1);
+      {
+        Variable j(0, 12, 1);
+        {
+          Variable k(0, 8, 1);
+          K = k.id;
+          C(i, j) = C(i, j) + A(i, k) * B(k, j);
+        }
+      }
+    }
+    CodeGenC codegen;
+    std::string code = codegen.genCode(prog.module_.GetRoot(),
+                                       prog.module_.GetTensors(), "kernel");
+    EXPECT_NE(code.find("float *__restrict__ " + A.id), std::string::npos);
+    EXPECT_EQ(code.find("]["), std::string::npos);
+    // The row of B is hoisted into the k loop, the others out of it.
+    auto k_loop = code.find("for (int " + K);
+    EXPECT_LT(code.find(A.id + "_row"), k_loop);
+    EXPECT_LT(code.find(C.id + "_row"), k_loop);
+    EXPECT_GT(code.find(B.id + "_row"), k_loop);
+  }
+}
+
 TEST(CODEGEN, CODEGEN_CUDA) {
   {
     Program prog;
@@ -41,4 +100,42 @@ TEST(CODEGEN, CODEGEN_CUDA) {
     }
     prog.GenerateCuda();
   }
-}
\ No newline at end of file
+}
+TEST(CODEGEN, CODEGEN_C_DISPATCH) {
+  Program prog;
+  Tensor A({16, 64}), B({16, 64});
+  IRNodeKey J;
+  {
+    Variable i(0, 16, 1);
+    {
+      Variable j(0, 64, 1);
+      J = j.id;
+      A(i, j) = A(i, j) + B(i, j) * 2;
+    }
+  }
+  std::vector<KernelVariant> variants;
+  for (auto isa : {TargetISA::SSE, TargetISA::AVX2, TargetISA::AVX512}) {
+    auto variant = prog.module_.CreateSubSpace();
+    LoopVectorization::runPass(LoopVectorization::Arg::create(
+        variant.GetRoot(), variant.GetLoop(J), MaxVectorLength(isa)));
+    FMAFusion::runPass(FMAFusion::Arg::create(variant.GetRoot()));
+    variants.push_back({isa, variant.GetRoot()});
+  }
+  CodeGenC codegen;
+  std::string code =
+      codegen.genDispatch(variants, prog.module_.GetTensors(), "kernel");
+  // The widest ISA is tried first, SSE multiplies and adds separately.
+  auto avx512 = code.find("__builtin_cpu_supports(\"avx512f\")");
+  auto avx2 = code.find("__builtin_cpu_supports(\"avx2\")");
+  EXPECT_LT(avx512, avx2);
+  EXPECT_NE(code.find("#pragma GCC target(\"avx2,fma\")"), std::string::npos);
+  EXPECT_NE(code.find("void kernel_sse("), std::string::npos);
+  EXPECT_NE(code.find("_mm256_fmadd_ps("), std::string::npos);
+  EXPECT_EQ(code.find("_mm_fmadd_ps("), std::string::npos);
+  EXPECT_NE(code.find("void kernel("), std::string::npos);
+
+  // An SSE variant cannot hold 8-wide vectors.
+  std::vector<KernelVariant> wrong = {{TargetISA::SSE, variants[1].program}};
+  EXPECT_THROW(codegen.genDispatch(wrong, prog.module_.GetTensors(), "k"),
+               std::runtime_error);
+}
@@ -0,0 +1,1068 @@
+#include "gtest/gtest.h"
+
+#include "lang/program.h"
+#include "lang/expr.h"
+#include "jit/jit_module.h"
+#include "jit/native_module.h"
+#include "jit/aot_module.h"
+#include "runtime/c_runtime_api.h"
+#include "pass/transform/vectorization.h"
+#include "pass/optimization/fma_fusion.h"
+#include "pass/optimization/scalar_replacement.h"
+#include "pass/optimization/software_prefetch.h"
+#include "pass/analysis/alignment_analysis.h"
+#include "pass/analysis/streaming_store_analysis.h"
+#include "codegen/codegen.h"
+
+using namespace polly;
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <unistd.h>
+
+TEST(JIT, GEMM) {
+  {
+    Program prog;
+    Tensor A({16, 8}), B({8, 12}), C({16, 12});
+    {
+      Variable i(0, 16, 1);
+      {
+        Variable k(0, 8, 1);
+        A(i, k) = i + k;
+      }
+    }
+    {
+      Variable k(0, 8, 1);
+      {
+        Variable j(0, 12, 1);
+        B(k, j) = k - j * 2;
+      }
+    }
+    {
+      Variable i(0, 16, 1);
+      {
+        Variable j(0, 12, 1);
+        {
+          Variable k(0, 8, 1);
+          C(i, j) = C(i, j) + A(i, k) * B(k, j);
+        }
+      }
+    }
+    JitModule jit(prog.module_);
+    jit.execute();
+    float *c = jit.GetTensor(C.id);
+    for (int i = 0; i < 16; i++) {
+      for (int j = 0; j < 12; j++) {
+        float expected = 0;
+        for (int k = 0; k < 8; k++) expected += (i + k) * (k - j * 2);
+        EXPECT_FLOAT_EQ(c[i * 12 + j], expected);
+      }
+    }
+  }
+}
+
+TEST(JIT, TRIANGULAR_BOUNDS) {
+  {
+    Program prog;
+    Tensor A({32, 32});
+    {
+      Variable i(0, 32, 1);
+      {
+        Variable j(i, Min(i + 4, 32), 2);
+        A(i, j) = A(i, j) + 1;
+      }
+    }
+    JitModule jit(prog.module_);
+    jit.execute();
+    jit.execute();
+    float *a = jit.GetTensor(A.id);
+    for (int i = 0; i < 32; i++) {
+      for (int j = 0; j < 32; j++) {
+        bool touched = j >= i && j < std::min(i + 4, 32) && (j - i) % 2 == 0;
+        EXPECT_FLOAT_EQ(a[i * 32 + j], touched ? 2.0 : 0.0);
+      }
+    }
+  }
+}
+
+TEST(JIT, NATIVE_MODULE) {
+  {
+    Program prog;
+    Tensor A({64}), B({8, 8});
+    {
+      Variable i(0, 8, 1);
+      {
+        Variable j(0, 8, 1);
+        B(i, j) = B(i, j) + A(i * 8 + j) * 2;
+      }
+    }
+    NativeModule native(prog.module_, "scale");
+    EXPECT_EQ(native.GetTensorOrder().size(), 2);
+
+    std::vector<float> a(64), b(64, 1.0);
+    for (int i = 0; i < 64; i++) a[i] = i;
+    native.execute({a.data(), b.data()});
+    native.GetFunction()(std::vector<float *>{a.data(), b.data()}.data(),
+                         nullptr);
+    for (int i = 0; i < 64; i++) EXPECT_FLOAT_EQ(b[i], 1 + 4 * i);
+
+    // A kernel that fails to compile leaves no working directory behind.
+    auto workdirs = []() {
+      int count = 0;
+      DIR *tmp = opendir("/tmp");
+      while (dirent *entry = readdir(tmp)) {
+        count += std::string(entry->d_name).rfind("polly_native_", 0) == 0;
+      }
+      closedir(tmp);
+      return count;
+    };
+    int before = workdirs();
+    EXPECT_THROW(NativeModule(prog.module_, "scale", "-fno-such-flag"),
+                 std::runtime_error);
+    EXPECT_EQ(workdirs(), before);
+  }
+  {
+    // A 0-d output is written through its buffer.
+    Program prog;
+    Tensor A({64}), S(std::vector<int64_t>{});
+    {
+      Variable i(0, 64, 1);
+      S() = S() + A(i) * A(i);
+    }
+    NativeModule native(prog.module_, "dot");
+    std::vector<float> a(64, 2.0f);
+    float s = 1;
+    native.execute({a.data(), &s});
+    EXPECT_FLOAT_EQ(s, 1 + 64 * 4);
+  }
+}
+
+TEST(JIT, NATIVE_PARALLEL_LOOP) {
+  {
+    Program prog;
+    Tensor A({64, 16}), B({64, 16});
+    IRNodeKey I, J;
+    {
+      Variable i(0, 64, 1);
+      I = i.id;
+      {
+        Variable j(0, 16, 1);
+        J = j.id;
+        B(i, j) = A(i, j) * 2 + i;
+      }
+    }
+    prog.module_.GetLoop(I).as<ForNode>()->annotation.parallelization = true;
+    prog.module_.GetLoop(J).as<ForNode>()->annotation.parallelization = true;
+
+    NativeModule native(prog.module_, "parallel_scale");
+    auto buffers = native.AllocateTensors();
+    for (int i = 0; i < 64 * 16; i++) buffers[0].data[i] = i;
+    native.execute(buffers);
+    for (int i = 0; i < 64 * 16; i++) {
+      EXPECT_FLOAT_EQ(buffers[1].data[i], 2 * i + i / 16);
+    }
+  }
+}
+
+TEST(JIT, BIND_TENSOR) {
+  {
+    Program prog;
+    Tensor A({4, 8}), B({4, 8}), C({4});
+    {
+      Variable i(0, 4, 1);
+      {
+        Variable j(0, 8, 1);
+        B(i, j) = A(i, j) * 3;
+        C(i) = C(i) + B(i, j);
+      }
+    }
+    std::vector<float> a(32), b(32, -1);
+    for (int i = 0; i < 32; i++) a[i] = i;
+    Buffer<float> buffer;
+    buffer.size = b.size();
+    buffer.data = b.data();
+
+    JitModule jit(prog.module_);
+    jit.BindTensor(A.id, a.data());
+    jit.BindTensor(B.id, buffer);
+    jit.execute();
+
+    EXPECT_EQ(jit.GetTensor(A.id), a.data());
+    EXPECT_EQ(jit.GetTensor(B.id), b.data());
+    for (int i = 0; i < 32; i++) {
+      EXPECT_FLOAT_EQ(a[i], i);
+      EXPECT_FLOAT_EQ(b[i], 3 * i);
+    }
+    float *c = jit.GetTensor(C.id);
+    for (int i = 0; i < 4; i++) {
+      EXPECT_FLOAT_EQ(c[i], 3 * (64 * i + 28));
+    }
+  }
+}
+
+TEST(JIT, PARALLEL_LOOP) {
+  {
+    Program prog;
+    Tensor A({64, 32}), B({64, 32});
+    IRNodeKey I, J;
+    {
+      Variable i(0, 64, 1);
+      I = i.id;
+      {
+        Variable j(0, 32, 1);
+        J = j.id;
+        A(i, j) = i * 32 + j;
+        B(i, j) = A(i, j) + 1;
+      }
+    }
+    prog.module_.GetLoop(I).as<ForNode>()->annotation.parallelization = true;
+    prog.module_.GetLoop(J).as<ForNode>()->annotation.parallelization = true;
+
+    JitModule jit(prog.module_, 4);
+    jit.PinWorkers(TopologyLevel::Core);
+    jit.execute();
+    float *a = jit.GetTensor(A.id);
+    float *b = jit.GetTensor(B.id);
+    for (int i = 0; i < 64 * 32; i++) {
+      EXPECT_FLOAT_EQ(a[i], i);
+      EXPECT_FLOAT_EQ(b[i], i + 1);
+    }
+  }
+}
+
+TEST(JIT, MEMORY_PLAN) {
+  {
+    Program prog;
+    Tensor A({16, 16}), T1({16, 16}), T2({16, 16}), T3({16, 16}), B({16});
+    {
+      Variable i(0, 16, 1);
+      {
+        Variable j(0, 16, 1);
+        A(i, j) = i + j;
+        T1(i, j) = A(i, j) * 2;
+      }
+    }
+    {
+      Variable i(0, 16, 1);
+      {
+        Variable j(0, 16, 1);
+        T2(i, j) = T1(i, j) + 1;
+      }
+    }
+    {
+      Variable i(0, 16, 1);
+      {
+        Variable j(0, 16, 1);
+        // T3 accumulates, so it must start from zero although it shares
+        // memory with T1.
+        T3(i, 0) = T3(i, 0) + T2(i, j);
+      }
+    }
+    {
+      Variable i(0, 16, 1);
+      B(i) = T3(i, 0);
+    }
+
+    JitModule jit(prog.module_, 2);
+    jit.PlanMemory({B.id});
+    jit.execute();
+    const MemoryPlan &plan = jit.GetMemoryPlan();
+    EXPECT_EQ(plan.unplanned_size, 4 * 256);
+    EXPECT_EQ(plan.slab_size, 2 * 256);
+    EXPECT_EQ(plan.Find(B.id), nullptr);
+
+    float *b = jit.GetTensor(B.id);
+    for (int i = 0; i < 16; i++) {
+      // sum_j 2 * (i + j) + 1
+      EXPECT_FLOAT_EQ(b[i], 32 * i + 240 + 16);
+    }
+    // Running again starts from zeroed intermediates.
+    jit.execute();
+    EXPECT_FLOAT_EQ(b[3], 32 * 3 + 240 + 16);
+    EXPECT_THROW(jit.PlanMemory({B.id}), std::runtime_error);
+
+    // The tensors of a module executed without a plan are allocated already.
+    JitModule unplanned(prog.module_, 2);
+    unplanned.execute();
+    EXPECT_THROW(unplanned.PlanMemory({B.id}), std::runtime_error);
+  }
+}
+
+TEST(JIT, VECTORIZED_LOOP) {
+  for (int vecLen : {4, 8, 16}) {
+    Program prog;
+    Tensor A({256}), B({256}), C({256});
+    IRNodeKey I;
+    {
+      Variable i(0, 256, 1);
+      I = i.id;
+      A(i) = B(i) * C(i) + B(i) / 2;
+    }
+    LoopVectorization::runPass(LoopVectorization::Arg::create(
+        prog.module_.GetRoot(), prog.module_.GetLoop(I), vecLen));
+
+    std::vector<float> a(256), b(256), c(256);
+    for (int i = 0; i < 256; i++) {
+      b[i] = i;
+      c[i] = 256 - i;
+    }
+    JitModule jit(prog.module_);
+    jit.BindTensor(A.id, a.data());
+    jit.BindTensor(B.id, b.data());
+    jit.BindTensor(C.id, c.data());
+    jit.execute();
+    for (int i = 0; i < 256; i++) {
+      EXPECT_FLOAT_EQ(a[i], b[i] * c[i] + b[i] / 2);
+    }
+  }
+}
+
+TEST(JIT, VECTORIZED_SELECT) {
+  for (int vecLen : {0, 4, 8, 16}) {
+    Program prog;
+    Tensor A({64}), B({64}), C({64}), D({64});
+    IRNodeKey I;
+    {
+      Variable i(0, 64, 1);
+      I = i.id;
+      B(i) = Max(A(i), 0);
+      C(i) = Min(Max(A(i), -2.5f), 2.5f);
+      D(i) = Select(A(i) > 0, A(i), A(i) * 0.1f);
+    }
+    if (vecLen != 0) {
+      LoopVectorization::runPass(LoopVectorization::Arg::create(
+          prog.module_.GetRoot(), prog.module_.GetLoop(I), vecLen));
+    }
+
+    std::vector<float> a(64), b(64), c(64), d(64);
+    for (int i = 0; i < 64; i++) a[i] = (i - 32) / 4.0f;
+    JitModule jit(prog.module_);
+    jit.BindTensor(A.id, a.data());
+    jit.BindTensor(B.id, b.data());
+    jit.BindTensor(C.id, c.data());
+    jit.BindTensor(D.id, d.data());
+    jit.execute();
+    for (int i = 0; i < 64; i++) {
+      EXPECT_FLOAT_EQ(b[i], std::max(a[i], 0.0f));
+      EXPECT_FLOAT_EQ(c[i], std::min(std::max(a[i], -2.5f), 2.5f));
+      EXPECT_FLOAT_EQ(d[i], a[i] > 0 ? a[i] : a[i] * 0.1f);
+    }
+
+    if (vecLen == 16 && !__builtin_cpu_supports("avx512f")) continue;
+    NativeModule native(prog.module_, "select");
+    auto buffers = native.AllocateTensors();
+    for (int i = 0; i < 64; i++) buffers[0].data[i] = a[i];
+    native.execute(buffers);
+    for (int i = 0; i < 64; i++) {
+      EXPECT_FLOAT_EQ(buffers[1].data[i], b[i]);
+      EXPECT_FLOAT_EQ(buffers[2].data[i], c[i]);
+      EXPECT_FLOAT_EQ(buffers[3].data[i], d[i]);
+    }
+  }
+}
+
+TEST(JIT, VECTORIZED_REDUCTION) {
+  for (int vecLen : {4, 8, 16}) {
+    Program prog;
+    Tensor A({16, 64}), B({64, 16}), C({16, 16}), N({16}), M({16});
+    IRNodeKey K, L;
+    {
+      // B(k, j) is strided along k, its lanes are gathered.
+      Variable i(0, 16, 1);
+      Variable j(0, 16, 1);
+      Variable k(0, 64, 1);
+      K = k.id;
+      C(i, j) = C(i, j) + A(i, k) * B(k, j);
+    }
+    {
+      Variable i(0, 16, 1);
+      Variable l(0, 64, 1);
+      L = l.id;
+      N(i) = N(i) + A(i, l) * A(i, l);
+      M(i) = Max(M(i), A(i, l));
+    }
+    auto root = prog.module_.GetRoot();
+    LoopVectorization::runPass(LoopVectorization::Arg::create(
+        root, prog.module_.GetLoop(K), vecLen));
+    LoopVectorization::runPass(LoopVectorization::Arg::create(
+        root, prog.module_.GetLoop(L), vecLen));
+    FMAFusion::runPass(FMAFusion::Arg::create(root));
+
+    std::vector<float> a(16 * 64), b(16 * 64);
+    for (int i = 0; i < 16 * 64; i++) {
+      a[i] = (i % 7) - 3;
+      b[i] = (i % 5) * 0.5f;
+    }
+    std::vector<float> c(16 * 16, 1), n(16), m(16, -100);
+    std::vector<float> c_ref(c), n_ref(n), m_ref(m);
+    for (int i = 0; i < 16; i++) {
+      for (int j = 0; j < 16; j++) {
+        for (int k = 0; k < 64; k++) {
+          c_ref[i * 16 + j] += a[i * 64 + k] * b[k * 16 + j];
+        }
+      }
+      for (int l = 0; l < 64; l++) {
+        n_ref[i] += a[i * 64 + l] * a[i * 64 + l];
+        m_ref[i] = std::max(m_ref[i], a[i * 64 + l]);
+      }
+    }
+
+    JitModule jit(prog.module_);
+    jit.BindTensor(A.id, a.data());
+    jit.BindTensor(B.id, b.data());
+    jit.BindTensor(C.id, c.data());
+    jit.BindTensor(N.id, n.data());
+    jit.BindTensor(M.id, m.data());
+    jit.execute();
+    // Small integers and halves, every order of the sums is exact.
+    EXPECT_EQ(c, c_ref);
+    EXPECT_EQ(n, n_ref);
+    EXPECT_EQ(m, m_ref);
+
+    if (vecLen == 16 && !__builtin_cpu_supports("avx512f")) continue;
+    NativeModule native(prog.module_, "reduction");
+    auto buffers = native.AllocateTensors();
+    std::copy(a.begin(), a.end(), buffers[0].data);
+    std::copy(b.begin(), b.end(), buffers[1].data);
+    std::fill(buffers[2].data, buffers[2].data + 16 * 16, 1);
+    std::fill(buffers[4].data, buffers[4].data + 16, -100);
+    native.execute(buffers);
+    for (int i = 0; i < 16 * 16; i++) EXPECT_EQ(buffers[2].data[i], c_ref[i]);
+    for (int i = 0; i < 16; i++) {
+      EXPECT_EQ(buffers[3].data[i], n_ref[i]);
+      EXPECT_EQ(buffers[4].data[i], m_ref[i]);
+    }
+  }
+}
+
+TEST(JIT, NATIVE_AVX512_LOOP) {
+  if (!__builtin_cpu_supports("avx512f")) return;
+  Program prog;
+  Tensor A({256}), B({256}), C({256});
+  IRNodeKey I;
+  {
+    Variable i(0, 256, 1);
+    I = i.id;
+    A(i) = B(i) * C(i) + B(i) / 2;
+  }
+  LoopVectorization::runPass(LoopVectorization::Arg::create(
+      prog.module_.GetRoot(), prog.module_.GetLoop(I), 16));
+
+  NativeModule native(prog.module_, "avx512");
+  auto buffers = native.AllocateTensors();
+  for (int i = 0; i < 256; i++) {
+    buffers[1].data[i] = i;
+    buffers[2].data[i] = 256 - i;
+  }
+  native.execute(buffers);
+  for (int i = 0; i < 256; i++) {
+    EXPECT_FLOAT_EQ(buffers[0].data[i], i * (256 - i) + i / 2.0);
+  }
+}
+
+TEST(JIT, FMA_GEMM) {
+  for (int vecLen : {4, 8, 16}) {
+    Program prog;
+    Tensor A({16, 8}), B({8, 16}), C({16, 16});
+    IRNodeKey J;
+    {
+      Variable i(0, 16, 1);
+      {
+        Variable k(0, 8, 1);
+        {
+          Variable j(0, 16, 1);
+          J = j.id;
+          C(i, j) = C(i, j) + A(i, k) * B(k, j);
+        }
+      }
+    }
+    LoopVectorization::runPass(LoopVectorization::Arg::create(
+        prog.module_.GetRoot(), prog.module_.GetLoop(J), vecLen));
+    auto ret = FMAFusion::runPass(
+        FMAFusion::Arg::create(prog.module_.GetRoot()));
+    EXPECT_EQ(PassRet::as<FMAFusion::Ret>(ret)->fused, 1);
+
+    std::vector<float> a(16 * 8), b(8 * 16), c(16 * 16, 1);
+    for (int i = 0; i < 16 * 8; i++) {
+      a[i] = i % 7;
+      b[i] = i % 5 - 2;
+    }
+    JitModule jit(prog.module_);
+    jit.BindTensor(A.id, a.data());
+    jit.BindTensor(B.id, b.data());
+    jit.BindTensor(C.id, c.data());
+    jit.execute();
+    for (int i = 0; i < 16; i++) {
+      for (int j = 0; j < 16; j++) {
+        float expected = 1;
+        for (int k = 0; k < 8; k++) expected += a[i * 8 + k] * b[k * 16 + j];
+        EXPECT_FLOAT_EQ(c[i * 16 + j], expected);
+      }
+    }
+
+    if (vecLen != 4) continue;
+    NativeModule native(prog.module_, "fma_gemm");
+    auto buffers = native.AllocateTensors();
+    std::copy(a.begin(), a.end(), buffers[0].data);
+    std::copy(b.begin(), b.end(), buffers[1].data);
+    native.execute(buffers);
+    for (int i = 0; i < 16; i++) {
+      for (int j = 0; j < 16; j++) {
+        float expected = 0;
+        for (int k = 0; k < 8; k++) expected += a[i * 8 + k] * b[k * 16 + j];
+        EXPECT_FLOAT_EQ(buffers[2].data[i * 16 + j], expected);
+      }
+    }
+  }
+}
+
+TEST(JIT, NATIVE_ALIGNED_LOOP) {
+  for (int vecLen : {4, 8}) {
+    Program prog;
+    Tensor A({8, 64}), B({8, 72});
+    IRNodeKey J;
+    {
+      Variable i(0, 8, 1);
+      {
+        Variable j(0, 64, 1);
+        J = j.id;
+        A(i, j) = B(i, j) * 2 + B(i, j + 1);
+      }
+    }
+    LoopVectorization::runPass(LoopVectorization::Arg::create(
+        prog.module_.GetRoot(), prog.module_.GetLoop(J), vecLen));
+    auto ret = AlignmentAnalysis::runPass(
+        AlignmentAnalysis::Arg::create(prog.module_.GetRoot()));
+    // A(i, j) and B(i, j), but not B(i, j + 1).
+    EXPECT_EQ(PassRet::as<AlignmentAnalysis::Ret>(ret)->aligned, 2);
+
+    NativeModule native(prog.module_, "aligned");
+    EXPECT_EQ(native.GetAlignment(), vecLen * 4);
+    auto buffers = native.AllocateTensors();
+    for (int i = 0; i < 8 * 72; i++) buffers[1].data[i] = i;
+    native.execute(buffers);
+    for (int i = 0; i < 8; i++) {
+      for (int j = 0; j < 64; j++) {
+        EXPECT_FLOAT_EQ(buffers[0].data[i * 64 + j],
+                        (i * 72 + j) * 2 + i * 72 + j + 1);
+      }
+    }
+    EXPECT_THROW(native.execute({buffers[0].data + 1, buffers[1].data}),
+                 std::runtime_error);
+  }
+}
+
+TEST(JIT, RUNTIME_SHAPE) {
+  {
+    Program prog;
+    Tensor A({64, 16}), B({64, 16});
+    Constant N("N");
+    IRNodeKey I;
+    {
+      Variable i(0, N, 1);
+      I = i.id;
+      {
+        Variable j(0, 16, 1);
+        B(i, j) = A(i, j) * 2 + i;
+      }
+    }
+    prog.module_.GetLoop(I).as<ForNode>()->annotation.parallelization = true;
+
+    auto check = [](float *b, int n) {
+      for (int i = 0; i < 64 * 16; i++) {
+        EXPECT_FLOAT_EQ(b[i], i / 16 < n ? 2 * i + i / 16 : 0);
+      }
+    };
+
+    JitModule jit(prog.module_, 4);
+    EXPECT_THROW(jit.execute(), std::runtime_error);
+    EXPECT_THROW(jit.SetConstant("M", 8), std::runtime_error);
+    std::vector<float> data(64 * 16);
+    for (int i = 0; i < 64 * 16; i++) data[i] = i;
+    jit.BindTensor(A.id, data.data());
+    jit.SetConstant("N", 5);
+    jit.execute();
+    check(jit.GetTensor(B.id), 5);
+    jit.SetConstant("N", 37);
+    jit.execute();
+    check(jit.GetTensor(B.id), 37);
+
+    NativeModule native(prog.module_, "runtime_shape");
+    EXPECT_EQ(native.GetConstantOrder(), std::vector<std::string>{"N"});
+    native.Specialize({{"N", 64}});
+    for (int n : {7, 64}) {
+      auto buffers = native.AllocateTensors();
+      for (int i = 0; i < 64 * 16; i++) buffers[0].data[i] = i;
+      native.SetConstant("N", n);
+      native.execute(buffers);
+      check(buffers[1].data, n);
+    }
+
+    // The tensor shapes are the capacity of N.
+    jit.SetConstant("N", 65);
+    EXPECT_THROW(jit.execute(), std::runtime_error);
+    auto buffers = native.AllocateTensors();
+    native.SetConstant("N", 2048);
+    EXPECT_THROW(native.execute(buffers), std::runtime_error);
+    native.SetConstant("N", 64);
+    native.execute(buffers);
+  }
+}
+
+TEST(JIT, WIDE_CONSTANT) {
+  {
+    Program prog;
+    Tensor A({8});
+    Constant N("N");
+    IRNodeKey I;
+    {
+      Variable i(0, N / 1073741824, 1);
+      I = i.id;
+      A(i) = A(i) + 1;
+    }
+    prog.module_.GetLoop(I).as<ForNode>()->annotation.parallelization = true;
+
+    // 2^33 passes the extent check, narrowed to an int it would be 0.
+    NativeModule native(prog.module_, "wide_constant");
+    std::vector<float> a(8, 0);
+    native.SetConstant("N", int64_t(1) << 33);
+    native.execute({a.data()});
+    for (int i = 0; i < 8; i++) EXPECT_FLOAT_EQ(a[i], 1);
+
+    char dir_template[] = "/tmp/polly_aot_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    AotModule aot(prog.module_, "wide_constant");
+    std::string library = aot.ExportSharedLibrary(dir_template);
+    void *handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    ASSERT_NE(handle, nullptr);
+    typedef int (*Entry)(float *, int64_t, void *, const void *);
+    auto entry = reinterpret_cast<Entry>(dlsym(handle, "wide_constant"));
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry(a.data(), int64_t(1) << 33, nullptr, nullptr), 0);
+    for (int i = 0; i < 8; i++) EXPECT_FLOAT_EQ(a[i], 2);
+    dlclose(handle);
+    unlink(library.c_str());
+    unlink((std::string(dir_template) + "/wide_constant.h").c_str());
+    rmdir(dir_template);
+  }
+}
+
+TEST(JIT, PARALLEL_SCHEDULE) {
+  {
+    Program prog;
+    Tensor A({4, 64}), B({64, 64});
+    IRNodeKey I, J, K;
+    {
+      Variable i(0, 4, 1);
+      I = i.id;
+      {
+        Variable j(0, 64, 1);
+        J = j.id;
+        A(i, j) = A(i, j) + i * 64 + j;
+      }
+    }
+    {
+      Variable k(0, 64, 1);
+      K = k.id;
+      {
+        Variable l(k, 64, 1);
+        B(k, l) = B(k, l) + k * 64 + l;
+      }
+    }
+    auto check = [](float *a, float *b) {
+      for (int i = 0; i < 4 * 64; i++) EXPECT_FLOAT_EQ(a[i], i);
+      for (int k = 0; k < 64; k++) {
+        for (int l = 0; l < 64; l++) {
+          EXPECT_FLOAT_EQ(b[k * 64 + l], l >= k ? k * 64 + l : 0);
+        }
+      }
+    };
+
+    struct Config {
+      int collapse;
+      LoopAnnotation::Schedule schedule;
+      int chunk;
+    };
+    for (auto config : {Config{2, LoopAnnotation::Schedule::STATIC, 0},
+                        Config{1, LoopAnnotation::Schedule::STATIC, 3},
+                        Config{2, LoopAnnotation::Schedule::DYNAMIC, 0},
+                        Config{1, LoopAnnotation::Schedule::GUIDED, 2}}) {
+      for (auto key : {I, J, K}) {
+        auto &annotation = prog.module_.GetLoop(key).as<ForNode>()->annotation;
+        annotation.parallelization = true;
+        annotation.collapse = config.collapse;
+        annotation.schedule = config.schedule;
+        annotation.chunk = config.chunk;
+      }
+      JitModule jit(prog.module_, 4);
+      jit.execute();
+      check(jit.GetTensor(A.id), jit.GetTensor(B.id));
+
+      NativeModule native(prog.module_, "parallel_schedule");
+      auto buffers = native.AllocateTensors();
+      native.execute(buffers);
+      check(buffers[0].data, buffers[1].data);
+    }
+  }
+}
+
+TEST(JIT, SCALAR_REPLACEMENT) {
+  // vecLen 0 is the scalar GEMM, reducing over the inner-most `k`.
+  for (int vecLen : {0, 4, 8}) {
+    Program prog;
+    Tensor A({16, 8}), B({8, 16}), C({16, 16});
+    IRNodeKey J;
+    if (vecLen == 0) {
+      Variable i(0, 16, 1);
+      {
+        Variable j(0, 16, 1);
+        {
+          Variable k(0, 8, 1);
+          C(i, j) = C(i, j) + A(i, k) * B(k, j);
+        }
+      }
+    } else {
+      Variable i(0, 16, 1);
+      {
+        Variable jo(0, 16 / vecLen, 1);
+        {
+          Variable k(0, 8, 1);
+          {
+            Variable ji(0, vecLen, 1);
+            J = ji.id;
+            C(i, jo * vecLen + ji) =
+                C(i, jo * vecLen + ji) + A(i, k) * B(k, jo * vecLen + ji);
+          }
+        }
+      }
+    }
+    auto root = prog.module_.GetRoot();
+    if (vecLen != 0) {
+      LoopVectorization::runPass(LoopVectorization::Arg::create(
+          root, prog.module_.GetLoop(J), vecLen));
+      FMAFusion::runPass(FMAFusion::Arg::create(root));
+    }
+    auto ret =
+        ScalarReplacement::runPass(ScalarReplacement::Arg::create(root));
+    // The accumulator of C is kept across `k`.
+    EXPECT_EQ(PassRet::as<ScalarReplacement::Ret>(ret)->promoted, 1);
+
+    std::vector<float> a(16 * 8), b(8 * 16), c(16 * 16, 1);
+    for (int i = 0; i < 16 * 8; i++) {
+      a[i] = i % 7;
+      b[i] = i % 5 - 2;
+    }
+    JitModule jit(prog.module_);
+    jit.BindTensor(A.id, a.data());
+    jit.BindTensor(B.id, b.data());
+    jit.BindTensor(C.id, c.data());
+    jit.execute();
+    for (int i = 0; i < 16; i++) {
+      for (int j = 0; j < 16; j++) {
+        float expected = 1;
+        for (int k = 0; k < 8; k++) expected += a[i * 8 + k] * b[k * 16 + j];
+        EXPECT_FLOAT_EQ(c[i * 16 + j], expected);
+      }
+    }
+
+    if (vecLen == 8) continue;
+    NativeModule native(prog.module_, "scalar_replacement");
+    auto buffers = native.AllocateTensors();
+    std::copy(a.begin(), a.end(), buffers[0].data);
+    std::copy(b.begin(), b.end(), buffers[1].data);
+    native.execute(buffers);
+    for (int i = 0; i < 16; i++) {
+      for (int j = 0; j < 16; j++) {
+        float expected = 0;
+        for (int k = 0; k < 8; k++) expected += a[i * 8 + k] * b[k * 16 + j];
+        EXPECT_FLOAT_EQ(buffers[2].data[i * 16 + j], expected);
+      }
+    }
+  }
+}
+
+TEST(JIT, SOFTWARE_PREFETCH) {
+  // Prefetches run past the end of B, which must not fault.
+  for (int vecLen : {0, 4}) {
+    Program prog;
+    Tensor A({16, 8}), B({8, 16}), C({16, 16});
+    IRNodeKey J;
+    if (vecLen == 0) {
+      Variable i(0, 16, 1);
+      {
+        Variable j(0, 16, 1);
+        {
+          Variable k(0, 8, 1);
+          C(i, j) = C(i, j) + A(i, k) * B(k, j);
+        }
+      }
+    } else {
+      Variable i(0, 16, 1);
+      {
+        Variable jo(0, 16 / vecLen, 1);
+        {
+          Variable k(0, 8, 1);
+          {
+            Variable ji(0, vecLen, 1);
+            J = ji.id;
+            C(i, jo * vecLen + ji) =
+                C(i, jo * vecLen + ji) + A(i, k) * B(k, jo * vecLen + ji);
+          }
+        }
+      }
+    }
+    auto root = prog.module_.GetRoot();
+    if (vecLen != 0) {
+      LoopVectorization::runPass(LoopVectorization::Arg::create(
+          root, prog.module_.GetLoop(J), vecLen));
+      FMAFusion::runPass(FMAFusion::Arg::create(root));
+    }
+    ScalarReplacement::runPass(ScalarReplacement::Arg::create(root));
+    auto ret =
+        SoftwarePrefetch::runPass(SoftwarePrefetch::Arg::create(root, 4));
+    EXPECT_EQ(PassRet::as<SoftwarePrefetch::Ret>(ret)->inserted, 1);
+
+    std::vector<float> a(16 * 8), b(8 * 16), c(16 * 16, 0);
+    for (int i = 0; i < 16 * 8; i++) {
+      a[i] = i % 7;
+      b[i] = i % 5 - 2;
+    }
+    JitModule jit(prog.module_);
+    jit.BindTensor(A.id, a.data());
+    jit.BindTensor(B.id, b.data());
+    jit.BindTensor(C.id, c.data());
+    jit.execute();
+
+    NativeModule native(prog.module_, "software_prefetch");
+    auto buffers = native.AllocateTensors();
+    std::copy(a.begin(), a.end(), buffers[0].data);
+    std::copy(b.begin(), b.end(), buffers[1].data);
+    native.execute(buffers);
+    for (int i = 0; i < 16; i++) {
+      for (int j = 0; j < 16; j++) {
+        float expected = 0;
+        for (int k = 0; k < 8; k++) expected += a[i * 8 + k] * b[k * 16 + j];
+        EXPECT_FLOAT_EQ(c[i * 16 + j], expected);
+        EXPECT_FLOAT_EQ(buffers[2].data[i * 16 + j], expected);
+      }
+    }
+  }
+}
+
+TEST(JIT, NATIVE_STREAMING_STORE) {
+  for (bool parallel : {false, true}) {
+    Program prog;
+    Tensor A({64, 64}), B({64, 64});
+    IRNodeKey I, J;
+    {
+      Variable i(0, 64, 1);
+      I = i.id;
+      {
+        Variable j(0, 64, 1);
+        J = j.id;
+        A(i, j) = B(i, j) * 2;
+      }
+    }
+    prog.module_.GetLoop(I).as<ForNode>()->annotation.parallelization =
+        parallel;
+    auto root = prog.module_.GetRoot();
+    LoopVectorization::runPass(
+        LoopVectorization::Arg::create(root, prog.module_.GetLoop(J), 8));
+    AlignmentAnalysis::runPass(AlignmentAnalysis::Arg::create(root));
+    auto ret = StreamingStoreAnalysis::runPass(
+        StreamingStoreAnalysis::Arg::create(root, 0));
+    EXPECT_EQ(PassRet::as<StreamingStoreAnalysis::Ret>(ret)->streamed, 1);
+
+    // The stores are fenced by the kernel, or by the workers.
+    CodeGenC codegen;
+    std::string code = codegen.genCode(root, prog.module_.GetTensors(), "k");
+    EXPECT_NE(code.find("_mm256_stream_ps("), std::string::npos);
+    auto fence = code.find("_mm_sfence();");
+    ASSERT_NE(fence, std::string::npos);
+    EXPECT_EQ(code.find("_mm_sfence();", fence + 1), std::string::npos);
+    EXPECT_EQ(fence < code.find("void k("), parallel);
+
+    NativeModule native(prog.module_, "streaming_store");
+    auto buffers = native.AllocateTensors();
+    for (int i = 0; i < 64 * 64; i++) buffers[1].data[i] = i;
+    native.execute(buffers);
+    for (int i = 0; i < 64 * 64; i++) {
+      EXPECT_FLOAT_EQ(buffers[0].data[i], i * 2);
+    }
+
+    JitModule jit(prog.module_);
+    std::vector<float> a(64 * 64), b(64 * 64);
+    for (int i = 0; i < 64 * 64; i++) b[i] = i;
+    jit.BindTensor(A.id, a.data());
+    jit.BindTensor(B.id, b.data());
+    jit.execute();
+    for (int i = 0; i < 64 * 64; i++) EXPECT_FLOAT_EQ(a[i], i * 2);
+  }
+}
+
+TEST(JIT, NATIVE_DISPATCH) {
+  Program prog;
+  Tensor A({16, 64}), B({16, 64});
+  IRNodeKey J;
+  {
+    Variable i(0, 16, 1);
+    {
+      Variable j(0, 64, 1);
+      J = j.id;
+      A(i, j) = A(i, j) + B(i, j) * 2;
+    }
+  }
+  std::vector<KernelVariant> variants;
+  for (auto isa : {TargetISA::SSE, TargetISA::AVX2, TargetISA::AVX512}) {
+    auto variant = prog.module_.CreateSubSpace();
+    LoopVectorization::runPass(LoopVectorization::Arg::create(
+        variant.GetRoot(), variant.GetLoop(J), MaxVectorLength(isa)));
+    FMAFusion::runPass(FMAFusion::Arg::create(variant.GetRoot()));
+    AlignmentAnalysis::runPass(
+        AlignmentAnalysis::Arg::create(variant.GetRoot()));
+    variants.push_back({isa, variant.GetRoot()});
+  }
+  // Whatever the host, one of the variants runs.
+  for (int n = variants.size(); n > 0; n--) {
+    std::vector<KernelVariant> subset(variants.begin(), variants.begin() + n);
+    NativeModule native(prog.module_, subset, "dispatch");
+    auto buffers = native.AllocateTensors();
+    for (int i = 0; i < 16 * 64; i++) {
+      buffers[0].data[i] = 1;
+      buffers[1].data[i] = i;
+    }
+    native.execute(buffers);
+    for (int i = 0; i < 16 * 64; i++) {
+      EXPECT_FLOAT_EQ(buffers[0].data[i], 1 + i * 2);
+    }
+  }
+}
+
+namespace {
+// The thread pool handle of the exported ABI, see AotModule.
+struct ThreadPoolHandle {
+  void *context;
+  void (*launch)(void *context, PollyParallelLambda lambda, void *cdata);
+};
+void LaunchOnRuntimePool(void *context, PollyParallelLambda lambda,
+                         void *cdata) {
+  *static_cast<int *>(context) += 1;
+  polly_backend_parallel_launch(lambda, cdata);
+}
+}  // namespace
+
+TEST(JIT, AOT_EXPORT) {
+  char dir_template[] = "/tmp/polly_aot_XXXXXX";
+  ASSERT_NE(mkdtemp(dir_template), nullptr);
+  std::string dir = dir_template;
+
+  Program prog;
+  Tensor A({64, 64}), T({64, 64}), B({64, 64});
+  IRNodeKey I;
+  {
+    Variable i(0, 64, 1);
+    I = i.id;
+    {
+      Variable j(0, 64, 1);
+      T(i, j) = A(i, j) * 2;
+    }
+  }
+  {
+    Variable i(0, 64, 1);
+    {
+      Variable j(0, 64, 1);
+      B(i, j) = T(i, j) + 1;
+    }
+  }
+  prog.module_.GetLoop(I).as<ForNode>()->annotation.parallelization = true;
+  AotModule aot(prog.module_, "aot_kernel");
+  aot.PlanMemory({A.id, B.id});
+  // T lives in the workspace.
+  EXPECT_EQ(aot.GetTensorOrder(), std::vector<IRNodeKey>({A.id, B.id}));
+  EXPECT_NE(aot.GenerateHeader().find("#define AOT_KERNEL_WORKSPACE_BYTES " +
+                                      std::to_string(64 * 64 * 4)),
+            std::string::npos);
+
+  std::vector<float> a(64 * 64), b(64 * 64);
+  for (int i = 0; i < 64 * 64; i++) a[i] = i;
+  {
+    std::string library = aot.ExportSharedLibrary(dir);
+    void *handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    ASSERT_NE(handle, nullptr);
+    // Only the entry point is exported.
+    EXPECT_EQ(dlsym(handle, "aot_kernel_kernel"), nullptr);
+    typedef int (*Entry)(float *, float *, void *, const ThreadPoolHandle *);
+    auto entry = reinterpret_cast<Entry>(dlsym(handle, "aot_kernel"));
+    ASSERT_NE(entry, nullptr);
+
+    EXPECT_EQ(entry(a.data(), b.data(), nullptr, nullptr), 0);
+    for (int i = 0; i < 64 * 64; i++) EXPECT_FLOAT_EQ(b[i], i * 2 + 1);
+
+    int launches = 0;
+    ThreadPoolHandle pool = {&launches, LaunchOnRuntimePool};
+    Buffer<float> workspace(64 * 64);
+    std::fill(b.begin(), b.end(), 0);
+    EXPECT_EQ(entry(a.data(), b.data(), workspace.data, &pool), 0);
+    EXPECT_EQ(launches, 1);
+    for (int i = 0; i < 64 * 64; i++) EXPECT_FLOAT_EQ(b[i], i * 2 + 1);
+    EXPECT_EQ(entry(a.data(), b.data(), workspace.data + 1, &pool), 1);
+    dlclose(handle);
+    unlink(library.c_str());
+  }
+  {
+    // A C program links the static library.
+    std::string library = aot.ExportStaticLibrary(dir);
+    std::ofstream f(dir + "/main.c");
+    f << "#include <stdio.h>\n";
+    f << "#include <stdlib.h>\n";
+    f << "#include \"aot_kernel.h\"\n";
+    f << "int main() {\n";
+    f << "  float *a = aligned_alloc(64, 64 * 64 * 4);\n";
+    f << "  float *b = aligned_alloc(64, 64 * 64 * 4);\n";
+    f << "  for (int i = 0; i < 64 * 64; i++) a[i] = i;\n";
+    f << "  if (aot_kernel(a, b, NULL, NULL) != 0) return 1;\n";
+    f << "  for (int i = 0; i < 64 * 64; i++)\n";
+    f << "    if (b[i] != i * 2 + 1) return 2;\n";
+    f << "  return 0;\n";
+    f << "}\n";
+    f.close();
+    std::string cmd = "cd " + dir + " && gcc -std=c11 -o main main.c " +
+                      library + " -lstdc++ -pthread && ./main";
+    EXPECT_EQ(system(cmd.c_str()), 0);
+    for (auto name : {"main.c", "main", "aot_kernel.h", "libaot_kernel.a"}) {
+      unlink((dir + "/" + name).c_str());
+    }
+  }
+  rmdir(dir.c_str());
+}
+
+TEST(JIT, AOT_SCALAR_OUTPUT) {
+  char dir_template[] = "/tmp/polly_aot_XXXXXX";
+  ASSERT_NE(mkdtemp(dir_template), nullptr);
+
+  Program prog;
+  Tensor A({64}), S(std::vector<int64_t>{});
+  {
+    Variable i(0, 64, 1);
+    S() = S() + A(i) * A(i);
+  }
+  AotModule aot(prog.module_, "aot_dot");
+  // The header documents the 0-d tensor as a buffer too.
+  EXPECT_NE(aot.GenerateHeader().find("float *" + S.id + ", "),
+            std::string::npos);
+  std::string library = aot.ExportSharedLibrary(dir_template);
+  void *handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+  ASSERT_NE(handle, nullptr);
+  typedef int (*Entry)(float *, float *, void *, const ThreadPoolHandle *);
+  auto entry = reinterpret_cast<Entry>(dlsym(handle, "aot_dot"));
+  ASSERT_NE(entry, nullptr);
+
+  std::vector<float> a(64, 2.0f);
+  float s = 1;
+  EXPECT_EQ(entry(a.data(), &s, nullptr, nullptr), 0);
+  EXPECT_FLOAT_EQ(s, 1 + 64 * 4);
+  dlclose(handle);
+  unlink(library.c_str());
+  unlink((std::string(dir_template) + "/aot_dot.h").c_str());
+  rmdir(dir_template);
+}
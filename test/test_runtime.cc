@@ -0,0 +1,321 @@
+#include "gtest/gtest.h"
+
+#include <sched.h>
+
+#include "runtime/buffer.h"
+#include "runtime/multi_threading.h"
+
+TEST(RUNTIME, DEQUE_OWNER_LIFO_THIEF_FIFO) {
+  WorkStealingDeque<int *> deque(2);
+  int items[5];
+  for (int i = 0; i < 5; i++) deque.Push(&items[i]);
+
+  int *item;
+  EXPECT_TRUE(deque.Steal(item));
+  EXPECT_EQ(item, &items[0]);
+  EXPECT_TRUE(deque.Pop(item));
+  EXPECT_EQ(item, &items[4]);
+  for (int i = 3; i >= 1; i--) {
+    EXPECT_TRUE(deque.Pop(item));
+    EXPECT_EQ(item, &items[i]);
+  }
+  EXPECT_FALSE(deque.Pop(item));
+  EXPECT_FALSE(deque.Steal(item));
+  EXPECT_TRUE(deque.Empty());
+}
+
+TEST(RUNTIME, DEQUE_CONCURRENT_STEAL) {
+  const int N = 100000, Thieves = 3;
+  std::vector<int> items(N);
+  std::vector<std::atomic<int>> taken(N);
+  for (auto &t : taken) t = 0;
+
+  WorkStealingDeque<int *> deque;
+  std::atomic<bool> done(false);
+  std::vector<std::thread> thieves;
+  for (int t = 0; t < Thieves; t++) {
+    thieves.emplace_back([&]() {
+      int *item;
+      while (!done || !deque.Empty()) {
+        if (deque.Steal(item)) taken[item - items.data()]++;
+      }
+    });
+  }
+  int *item;
+  for (int i = 0; i < N; i++) {
+    deque.Push(&items[i]);
+    if (i % 3 == 0 && deque.Pop(item)) taken[item - items.data()]++;
+  }
+  while (deque.Pop(item)) taken[item - items.data()]++;
+  done = true;
+  for (auto &t : thieves) t.join();
+
+  for (int i = 0; i < N; i++) EXPECT_EQ(taken[i], 1) << "item " << i;
+}
+
+TEST(RUNTIME, MANY_SMALL_TASKS) {
+  MultiThreading pool(4);
+  std::atomic<int64_t> sum(0);
+  std::vector<std::future<void>> futures;
+  for (int i = 0; i < 10000; i++) {
+    futures.push_back(pool.submit([&sum, i]() { sum += i; }));
+  }
+  for (auto &f : futures) f.get();
+  EXPECT_EQ(sum, int64_t(10000) * 9999 / 2);
+}
+
+TEST(RUNTIME, NESTED_SUBMIT) {
+  MultiThreading pool(3);
+  std::atomic<int> count(0);
+  std::vector<std::future<std::vector<std::future<void>>>> outer;
+  for (int i = 0; i < 16; i++) {
+    outer.push_back(pool.submit([&]() {
+      std::vector<std::future<void>> inner;
+      for (int j = 0; j < 64; j++) {
+        inner.push_back(pool.submit([&count]() { count++; }));
+      }
+      return inner;
+    }));
+  }
+  for (auto &o : outer) {
+    for (auto &f : o.get()) f.get();
+  }
+  EXPECT_EQ(count, 16 * 64);
+}
+
+TEST(RUNTIME, RETURN_VALUE_AND_EXCEPTION) {
+  MultiThreading pool(2);
+  auto value = pool.submit([](int a, int b) { return a * b; }, 6, 7);
+  EXPECT_EQ(value.get(), 42);
+  auto error = pool.submit([]() { throw std::runtime_error("boom"); });
+  EXPECT_THROW(error.get(), std::runtime_error);
+}
+
+TEST(RUNTIME, PARALLEL_FOR_SCHEDULES) {
+  MultiThreading pool(3);
+  const int64_t N = 1003;
+  for (auto policy : {ParallelSchedule::Static, ParallelSchedule::Dynamic,
+                      ParallelSchedule::Guided}) {
+    for (int64_t chunk : {0, 1, 7, 2000}) {
+      std::vector<std::atomic<int>> hits(N);
+      for (auto &h : hits) h = 0;
+      pool.parallel_for(5, N, chunk, policy, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++) hits[i]++;
+      });
+      for (int64_t i = 0; i < N; i++) {
+        EXPECT_EQ(hits[i], i < 5 ? 0 : 1)
+            << "policy " << int(policy) << " chunk " << chunk << " i " << i;
+      }
+    }
+  }
+}
+
+TEST(RUNTIME, PARALLEL_FOR_EXCEPTION) {
+  MultiThreading pool(2);
+  auto body = [](int64_t first, int64_t last) {
+    if (first <= 50 && 50 < last) throw std::runtime_error("boom");
+  };
+  EXPECT_THROW(pool.parallel_for(0, 100, 1, ParallelSchedule::Dynamic, body),
+               std::runtime_error);
+  // The pool is still usable afterwards.
+  std::atomic<int> count(0);
+  pool.parallel_for(0, 100, 0, ParallelSchedule::Static,
+                    [&](int64_t first, int64_t last) {
+                      count += last - first;
+                    });
+  EXPECT_EQ(count, 100);
+}
+
+TEST(RUNTIME, NESTED_PARALLEL_FOR) {
+  MultiThreading pool(3);
+  std::atomic<int> count(0);
+  pool.parallel_for(0, 8, 1, ParallelSchedule::Dynamic,
+                    [&](int64_t first, int64_t last) {
+                      pool.parallel_for(0, 100, 10, ParallelSchedule::Dynamic,
+                                        [&](int64_t f, int64_t l) {
+                                          count += l - f;
+                                        });
+                    });
+  EXPECT_EQ(count, 800);
+}
+
+TEST(RUNTIME, PARALLEL_REGION_BARRIER) {
+  MultiThreading pool(3);
+  const int Phases = 50;
+  Barrier barrier(pool.thread_num + 1);
+  std::vector<int> slots(pool.thread_num + 1, 0);
+  std::atomic<int> errors(0);
+  pool.parallel_region([&](int wid, int worker_size) {
+    for (int phase = 0; phase < Phases; phase++) {
+      slots[wid] = phase;
+      barrier.Wait();
+      // Everyone has published this phase before anyone starts the next.
+      for (int w = 0; w < worker_size; w++) {
+        if (slots[w] != phase) errors++;
+      }
+      barrier.Wait();
+    }
+  });
+  EXPECT_EQ(errors, 0);
+}
+
+TEST(RUNTIME, PARALLEL_REGION_FIXED_WIDS) {
+  MultiThreading pool(3);
+  std::vector<std::thread::id> owner(pool.thread_num + 1);
+  std::atomic<int> errors(0);
+  for (int i = 0; i < 1000; i++) {
+    pool.parallel_region([&](int wid, int worker_size) {
+      auto self = std::this_thread::get_id();
+      if (i == 0) owner[wid] = self;
+      if (owner[wid] != self) errors++;
+    });
+    if (owner[0] != std::this_thread::get_id()) errors++;
+  }
+  EXPECT_EQ(errors, 0);
+  for (int wid = 1; wid <= pool.thread_num; wid++) {
+    EXPECT_NE(owner[wid], owner[0]);
+  }
+
+  // Nested regions run on the worker alone.
+  pool.parallel_region([&](int wid, int worker_size) {
+    pool.parallel_region([&](int inner_wid, int inner_size) {
+      if (inner_wid != 0 || inner_size != 1) errors++;
+    });
+  });
+  EXPECT_EQ(errors, 0);
+}
+
+TEST(RUNTIME, CONCURRENT_PARALLEL_REGIONS) {
+  MultiThreading pool(3);
+  // Each participant must get a thread of its own, or the barriers of two
+  // regions forked at the same time would deadlock.
+  auto forker = [&] {
+    Barrier barrier(pool.thread_num + 1);
+    for (int i = 0; i < 200; i++) {
+      pool.parallel_region([&](int wid, int worker_size) { barrier.Wait(); });
+    }
+  };
+  std::thread first(forker), second(forker);
+  first.join();
+  second.join();
+}
+
+TEST(RUNTIME, SPIN_THEN_PARK) {
+  WaitPolicy no_spin;
+  no_spin.spin_count = 0;
+  no_spin.yield_count = 0;
+  MultiThreading pool(2, no_spin);
+  // Let the workers fall asleep.
+  while (pool.GetWaitStats().parks < 2) std::this_thread::yield();
+  pool.submit([]() {}).get();
+  WaitStats stats = pool.GetWaitStats();
+  EXPECT_GE(stats.wakes, 1);
+
+  pool.SetHot(true);
+  EXPECT_TRUE(pool.IsHot());
+  pool.ResetWaitStats();
+  std::atomic<int> count(0);
+  for (int i = 0; i < 100; i++) {
+    pool.parallel_region([&](int wid, int worker_size) { count++; });
+  }
+  EXPECT_EQ(count, 300);
+  // Hot workers never park between forks.
+  EXPECT_EQ(pool.GetWaitStats().parks, 0);
+  pool.SetHot(false);
+}
+
+TEST(RUNTIME, TOPOLOGY) {
+  const CpuTopology &topology = CpuTopology::Get();
+  ASSERT_FALSE(topology.cpus.empty());
+  // Every level partitions the same set of CPUs, coarser levels into fewer
+  // units.
+  int previous = 0;
+  for (auto level : {TopologyLevel::Node, TopologyLevel::Socket,
+                     TopologyLevel::Core, TopologyLevel::SMT}) {
+    auto units = topology.Units(level);
+    size_t cpus = 0;
+    for (auto &unit : units) cpus += unit.size();
+    EXPECT_EQ(cpus, topology.cpus.size());
+    EXPECT_GE(units.size(), previous);
+    previous = units.size();
+  }
+  EXPECT_EQ(topology.NumUnits(TopologyLevel::SMT), topology.cpus.size());
+}
+
+TEST(RUNTIME, PIN_AND_FIRST_TOUCH) {
+  MultiThreading pool(2);
+  EXPECT_TRUE(pool.PinWorkers(TopologyLevel::Core));
+
+  std::vector<float> data(1000, 1.0f);
+  FirstTouch(pool, data.data(), data.size());
+  for (float x : data) EXPECT_EQ(x, 0.0f);
+
+  // The thread that first-touches the slice of a wid computes on it later.
+  std::vector<std::thread::id> toucher(pool.thread_num + 1);
+  pool.parallel_region([&](int wid, int worker_size) {
+    toucher[wid] = std::this_thread::get_id();
+  });
+  std::atomic<int> moved(0);
+  pool.parallel_region([&](int wid, int worker_size) {
+    if (toucher[wid] != std::this_thread::get_id()) moved++;
+  });
+  EXPECT_EQ(moved, 0);
+
+  InitializeMultiThreading({2, 2},
+                           {TopologyLevel::Socket, TopologyLevel::Core});
+  MultiThreading *level = ThreadPool::GetThreadingLevel(1);
+  EXPECT_EQ(level->thread_num, 2);
+  EXPECT_EQ(level->submit([]() { return 3; }).get(), 3);
+
+  // The workers of level 1 run inside the socket of their parent.
+  auto affinity = [](MultiThreading *pool) {
+    std::vector<cpu_set_t> sets(pool->thread_num + 1);
+    pool->parallel_region([&](int wid, int worker_size) {
+      sched_getaffinity(0, sizeof(cpu_set_t), &sets[wid]);
+    });
+    return sets;
+  };
+  auto parents = affinity(ThreadPool::GetThreadingLevel(0));
+  auto children = affinity(level);
+  for (int w = 0; w < level->thread_num; w++) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &children[w + 1])) {
+        EXPECT_TRUE(CPU_ISSET(cpu, &parents[1])) << "worker " << w;
+      }
+    }
+  }
+}
+
+TEST(RUNTIME, BUFFER_POOL) {
+  using polly::Buffer;
+  using polly::BufferAllocator;
+  BufferAllocator allocator;
+  float *first;
+  {
+    Buffer<float> a(100, Buffer<float>::CPU_MEM, allocator);
+    EXPECT_TRUE(a.Owned());
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(a.data) % 64, 0);
+    EXPECT_EQ(a.alignment, 64);
+    a.Fill(1);
+    first = a.data;
+  }
+  // A buffer of the same size class reuses the freed block.
+  Buffer<float> b(120, Buffer<float>::CPU_MEM, allocator);
+  EXPECT_EQ(b.data, first);
+  EXPECT_EQ(allocator.GetStats().reused, 1);
+
+  Buffer<float> large(BufferAllocator::HugePageSize, Buffer<float>::CPU_MEM,
+                      allocator);
+  EXPECT_EQ(large.alignment, BufferAllocator::HugePageSize);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(large.data) %
+                BufferAllocator::HugePageSize,
+            0);
+
+  Buffer<float> moved(std::move(large));
+  EXPECT_EQ(large.data, nullptr);
+  EXPECT_TRUE(moved.Owned());
+
+  allocator.SetCacheLimit(0);
+  { Buffer<float> c(10, Buffer<float>::CPU_MEM, allocator); }
+  EXPECT_EQ(allocator.GetStats().cached_bytes, 0);
+}